@@ -1,5 +1,6 @@
 #include "BuildCache.hpp"
 
+#include <algorithm>
 #include <set>
 
 #include "Settings.hpp"
@@ -16,10 +17,31 @@ static inline std::string ParseToHex(hash_t hash);
 
 static inline ErrorReport load_file_record_table(
     BuildCache::file_record_table &records,
-    const FieldDataReader &data);
+    const FieldDataReader &data,
+    std::string_view root_directory);
 
 static inline ErrorReport load_file_record(BuildCache::FileRecord &record,
-                                           const FieldDataReader &data);
+                                           const FieldDataReader &data,
+                                           std::string_view root_directory);
+
+static inline void load_toolchain_records(
+    BuildCache::toolchain_record_table &records,
+    const FieldVar::Dict &data);
+
+static inline void load_scan_records(BuildCache::scan_record_table &records,
+                                     const FieldVar::Dict &data);
+
+// drops what's compared by hash, keeping the output paths (so old objects are still cleaned)
+static inline void drop_hashes(BuildCache &cache);
+
+static inline FilePath load_path(const BuildCacheFile &file,
+                                 BuildCacheFile::StringRef ref,
+                                 std::string_view root_directory);
+
+static inline FieldVar::Int get_dict_int(const FieldVar::Dict &dict,
+                                         const char *name);
+static inline FieldVar::String get_dict_string(const FieldVar::Dict &dict,
+                                               const char *name);
 
 void BuildCache::fix_file_records() {}
 
@@ -54,9 +76,12 @@ bool BuildCache::is_compatible_with(const BuildCache &older_cache) const {
          this->config_hash == older_cache.config_hash;
 }
 
-BuildCache BuildCache::load(const FieldDataReader &data, ErrorReport &error) {
+BuildCache BuildCache::load(const FieldDataReader &data,
+                            std::string_view root_directory,
+                            ErrorReport &error) {
 
   BuildCache cache;
+  cache.root_directory = root_directory;
 
   const hash_pointer_info hash_ptrs[] = {
     CTOR_HASH_PTR_DEF(build_hash),
@@ -90,14 +115,189 @@ BuildCache BuildCache::load(const FieldDataReader &data, ErrorReport &error) {
   }
 
   error = load_file_record_table(cache.file_records,
-                                 data.branch_reader("file_records"));
+                                 data.branch_reader("file_records"),
+                                 root_directory);
+
+  // optional, caches written by older versions don't have them
+  const auto path_hash_iter = data.get_data().find("toolchain_path_hash");
+  const auto toolchain_iter = data.get_data().find("toolchain");
+  if (path_hash_iter != data.get_data().end() &&
+      toolchain_iter != data.get_data().end() &&
+      path_hash_iter->second.get_type() == FieldVarType::Integer &&
+      toolchain_iter->second.get_type() == FieldVarType::Dict)
+  {
+    cache.toolchain_path_hash = path_hash_iter->second.get_int();
+    load_toolchain_records(cache.toolchain_records,
+                           toolchain_iter->second.get_dict());
+  }
+
+  const auto scan_iter = data.get_data().find("scan_records");
+  const auto scan_macros_iter = data.get_data().find("scan_macros_hash");
+  if (scan_iter != data.get_data().end() &&
+      scan_iter->second.get_type() == FieldVarType::Dict &&
+      scan_macros_iter != data.get_data().end() &&
+      scan_macros_iter->second.get_type() == FieldVarType::Integer)
+  {
+    cache.scan_macros_hash = scan_macros_iter->second.get_int();
+    load_scan_records(cache.scan_records, scan_iter->second.get_dict());
+  }
+
+  // caches written before the algorithm was stored were hashed with the cipher table
+  const auto algorithm_iter = data.get_data().find("hash_algorithm");
+  cache.hash_algorithm =
+      algorithm_iter != data.get_data().end() &&
+              algorithm_iter->second.get_type() == FieldVarType::Integer
+          ? algorithm_iter->second.get_int()
+          : 1;
+
+  if (cache.hash_algorithm != HashTools::Algorithm)
+  {
+    Logger::verbose("the build cache was hashed with another algorithm (%lld), "
+                    "ignoring it's hashes",
+                    (long long)cache.hash_algorithm);
+    drop_hashes(cache);
+  }
+
+  return cache;
+}
+
+BuildCache BuildCache::load(const BuildCacheFile &file,
+                            std::string_view root_directory,
+                            ErrorReport &error) {
+  BuildCache cache;
+  cache.root_directory = root_directory;
+  const BuildCacheFile::Header &header = file.get_header();
+
+  cache.hash_algorithm = header.hash_algorithm;
+  cache.build_hash = header.build_hash;
+  cache.config_hash = header.config_hash;
+  cache.build_time = header.build_time;
+  cache.toolchain_path_hash = header.toolchain_path_hash;
+  cache.scan_macros_hash = header.scan_macros_hash;
+
+  // the records are sorted, each one is inserted at the end
+  for (const BuildCacheFile::FileRecordEntry &entry : file.get_file_records())
+  {
+    cache.file_records.emplace_hint(cache.file_records.end(),
+                                    load_path(file, entry.path, root_directory),
+                                    load_file_record(file, entry, root_directory));
+  }
+
+  for (const BuildCacheFile::ToolchainEntry &entry : file.get_toolchain_records())
+  {
+    ToolchainRecord record{};
+    record.path = load_path(file, entry.path, {});
+    record.size = entry.size;
+    record.write_time = entry.write_time;
+    record.version = file.get_string(entry.version);
+    record.fingerprint = entry.fingerprint;
+
+    cache.toolchain_records.insert_or_assign(string(file.get_string(entry.name)), record);
+  }
+
+  for (const BuildCacheFile::MacroEntry &entry : file.get_scan_macros())
+  {
+    MacroRecord record{};
+    record.defined = entry.defined != 0;
+    record.value = file.get_string(entry.value);
+
+    cache.scan_macros.insert_or_assign(string(file.get_string(entry.name)), record);
+  }
+
+  const Blob<const BuildCacheFile::StringRef> includes = file.get_scan_includes();
+  for (const BuildCacheFile::ScanEntry &entry : file.get_scan_records())
+  {
+    // a broken record only means the file is scanned again
+    if (uint64_t(entry.includes_offset) + entry.includes_count > includes.size() ||
+        uint64_t(entry.redefined_offset) + entry.redefined_count > includes.size())
+    {
+      continue;
+    }
 
+    ScanRecord record{};
+    record.signature.size = entry.size;
+    record.signature.write_time_ns = entry.write_time_ns;
+    record.signature.change_time_ns = entry.change_time_ns;
+    record.signature.inode = entry.inode;
+    record.content_hash = entry.content_hash;
+
+    record.includes.reserve(entry.includes_count);
+    for (uint32_t i = 0; i < entry.includes_count; i++)
+    {
+      record.includes.emplace_back(file.get_string(includes[entry.includes_offset + i]));
+    }
+
+    record.redefined_macros.reserve(entry.redefined_count);
+    for (uint32_t i = 0; i < entry.redefined_count; i++)
+    {
+      record.redefined_macros.emplace_back(
+          file.get_string(includes[entry.redefined_offset + i]));
+    }
+
+    cache.scan_records.insert_or_assign(load_path(file, entry.path, root_directory),
+                                        std::move(record));
+  }
+
+  if (cache.hash_algorithm != HashTools::Algorithm)
+  {
+    Logger::verbose("the build cache was hashed with another algorithm (%lld), "
+                    "ignoring it's hashes",
+                    (long long)cache.hash_algorithm);
+    drop_hashes(cache);
+  }
+
+  error = {};
   return cache;
 }
 
+BuildCache::FileRecord BuildCache::load_file_record(const BuildCacheFile &file,
+                                                    const BuildCacheFile::FileRecordEntry &entry,
+                                                    std::string_view root_directory) {
+  FileRecord record{};
+  record.output_path = load_path(file, entry.output_path, root_directory);
+  record.hash = entry.hash;
+  record.obj_hash = entry.obj_hash;
+  record.obj_signature.size = entry.obj_size;
+  record.obj_signature.write_time_ns = entry.obj_write_time_ns;
+  record.obj_signature.change_time_ns = entry.obj_change_time_ns;
+  record.obj_signature.inode = entry.obj_inode;
+  record.source_write_time = entry.source_write_time;
+  record.build_wall_time = entry.build_wall_time;
+  record.build_user_time = entry.build_user_time;
+  record.build_system_time = entry.build_system_time;
+  record.build_failed = (entry.flags & BuildCacheFile::RecordFlag_BuildFailed) != 0;
+  return record;
+}
+
+std::string_view BuildCache::get_stored_path(std::string_view root_directory,
+                                             std::string_view path) {
+  if (root_directory.empty() || path.size() <= root_directory.size() ||
+      !path.starts_with(root_directory))
+  {
+    return path;
+  }
+
+  return path.substr(root_directory.size());
+}
+
+FilePath BuildCache::resolve_stored_path(std::string_view root_directory,
+                                         std::string_view stored_path) {
+  // terminated, the stored strings aren't
+  FilePath path{ string(stored_path) };
+  if (root_directory.empty() || path.empty() || path.is_absolute())
+  {
+    return path;
+  }
+
+  string full_path{ root_directory };
+  full_path.append(stored_path);
+  return FilePath(full_path);
+}
+
 FieldVar::Dict BuildCache::write() const {
   FieldVar::Dict dict{};
 
+  dict["hash_algorithm"] = FieldVar::Int(HashTools::Algorithm);
   dict["build_hash"] = FieldVar::Int(this->build_hash);
   dict["config_hash"] = FieldVar::Int(this->config_hash);
   dict["build_time"] = FieldVar::Int(this->build_time);
@@ -105,24 +305,94 @@ FieldVar::Dict BuildCache::write() const {
   FieldVar::Dict records{};
 
   for (const auto &[path, record] : this->file_records)
+  {
+    records.insert_or_assign(path.c_str(), FieldVar(write_file_record(record)));
+  }
+
+  dict["file_records"] = FieldVar{ records };
+
+  FieldVar::Dict toolchain{};
+
+  for (const auto &[name, record] : this->toolchain_records)
   {
     FieldVar::Dict record_dict{};
 
-    record_dict.emplace("output_path", record.output_path);
-    record_dict.emplace("source_write_time",
-                        FieldVar::Int(record.source_write_time));
-    record_dict.emplace("hash", FieldVar::Int(record.hash));
-    record_dict.emplace("obj_hash", FieldVar::Int(record.obj_hash));
-    record_dict.emplace("obj_size", FieldVar::Int(record.obj_size));
+    record_dict.emplace("path", record.path);
+    record_dict.emplace("size", FieldVar::Int(record.size));
+    record_dict.emplace("write_time", FieldVar::Int(record.write_time));
+    record_dict.emplace("version", record.version);
+    record_dict.emplace("fingerprint", FieldVar::Int(record.fingerprint));
 
-    records.insert_or_assign(path.c_str(), FieldVar(record_dict));
+    toolchain.insert_or_assign(name, FieldVar(record_dict));
   }
 
-  dict["file_records"] = FieldVar{ records };
+  dict["toolchain_path_hash"] = FieldVar::Int(this->toolchain_path_hash);
+  dict["toolchain"] = FieldVar{ toolchain };
+
+  FieldVar::Dict scan_records{};
+
+  for (const auto &[path, record] : this->scan_records)
+  {
+    FieldVar::Dict record_dict{};
+
+    record_dict.emplace("size", FieldVar::Int(record.signature.size));
+    record_dict.emplace("write_time_ns",
+                        FieldVar::Int(record.signature.write_time_ns));
+    record_dict.emplace("change_time_ns",
+                        FieldVar::Int(record.signature.change_time_ns));
+    record_dict.emplace("inode", FieldVar::Int(record.signature.inode));
+    record_dict.emplace("content_hash", FieldVar::Int(record.content_hash));
+
+    FieldVar::Array includes{};
+    includes.reserve(record.includes.size());
+    for (const string &include : record.includes)
+    {
+      includes.emplace_back(include);
+    }
+    record_dict.emplace("includes", FieldVar(includes));
+
+    FieldVar::Array redefined_macros{};
+    redefined_macros.reserve(record.redefined_macros.size());
+    for (const string &name : record.redefined_macros)
+    {
+      redefined_macros.emplace_back(name);
+    }
+    record_dict.emplace("redefined_macros", FieldVar(redefined_macros));
+
+    scan_records.insert_or_assign(path.c_str(), FieldVar(record_dict));
+  }
+
+  dict["scan_macros_hash"] = FieldVar::Int(this->scan_macros_hash);
+  dict["scan_records"] = FieldVar{ scan_records };
 
   return dict;
 }
 
+FieldVar::Dict BuildCache::write_file_record(const FileRecord &record) {
+  FieldVar::Dict record_dict{};
+
+  record_dict.emplace("output_path", record.output_path);
+  record_dict.emplace("source_write_time",
+                      FieldVar::Int(record.source_write_time));
+  record_dict.emplace("hash", FieldVar::Int(record.hash));
+  record_dict.emplace("obj_hash", FieldVar::Int(record.obj_hash));
+  record_dict.emplace("obj_size", FieldVar::Int(record.obj_signature.size));
+  record_dict.emplace("obj_write_time_ns",
+                      FieldVar::Int(record.obj_signature.write_time_ns));
+  record_dict.emplace("obj_change_time_ns",
+                      FieldVar::Int(record.obj_signature.change_time_ns));
+  record_dict.emplace("obj_inode", FieldVar::Int(record.obj_signature.inode));
+  record_dict.emplace("build_wall_time",
+                      FieldVar::Int(record.build_wall_time));
+  record_dict.emplace("build_user_time",
+                      FieldVar::Int(record.build_user_time));
+  record_dict.emplace("build_system_time",
+                      FieldVar::Int(record.build_system_time));
+  record_dict.emplace("build_failed", FieldVar::Bool(record.build_failed));
+
+  return record_dict;
+}
+
 inline std::string ParseToHex(hash_t hash) {
   char buffer[32] = { 0 };
   snprintf(buffer, std::size(buffer), "%lX", hash);
@@ -131,7 +401,8 @@ inline std::string ParseToHex(hash_t hash) {
 
 inline ErrorReport load_file_record_table(
     BuildCache::file_record_table &records,
-    const FieldDataReader &data) {
+    const FieldDataReader &data,
+    std::string_view root_directory) {
 
   for (const auto &[key, value] : data.get_data())
   {
@@ -148,7 +419,7 @@ inline ErrorReport load_file_record_table(
     }
 
     BuildCache::FileRecord record;
-    ErrorReport report = load_file_record(record, data.branch_reader(key));
+    ErrorReport report = load_file_record(record, data.branch_reader(key), root_directory);
     if (report.code != Error::Ok)
     {
       report.message =
@@ -156,14 +427,15 @@ inline ErrorReport load_file_record_table(
       return report;
     }
 
-    records.insert_or_assign(key, record);
+    records.insert_or_assign(BuildCache::resolve_stored_path(root_directory, key), record);
   }
 
   return ErrorReport();
 }
 
 inline ErrorReport load_file_record(BuildCache::FileRecord &record,
-                                    const FieldDataReader &data) {
+                                    const FieldDataReader &data,
+                                    std::string_view root_directory) {
   const FieldVar &output_path =
       data.try_get_value<FieldVarType::String>("output_path");
 
@@ -176,10 +448,14 @@ inline ErrorReport load_file_record(BuildCache::FileRecord &record,
     return report;
   }
 
-  record.output_path = output_path.get_string();
+  record.output_path =
+      BuildCache::resolve_stored_path(root_directory, output_path.get_string());
 
   const int64_pointer_info i64_ptr_info[]{
     CTOR_INT64_PTR_DEF_RECORD(source_write_time),
+    CTOR_INT64_PTR_DEF_RECORD(build_wall_time),
+    CTOR_INT64_PTR_DEF_RECORD(build_user_time),
+    CTOR_INT64_PTR_DEF_RECORD(build_system_time),
   };
 
   for (size_t i = 0; i < std::size(i64_ptr_info); i++)
@@ -195,13 +471,143 @@ inline ErrorReport load_file_record(BuildCache::FileRecord &record,
       data.try_get_value<FieldVarType::Integer>("hash", FieldVar::Int())
           .get_int();
 
-  record.obj_size =
-      data.try_get_value<FieldVarType::Integer>("obj_size", FieldVar::Int())
-          .get_int();
+  // missing from older caches, the object is hashed once more then
+  const FieldVar::Dict &dict = data.get_data();
+  record.obj_signature.size = get_dict_int(dict, "obj_size");
+  record.obj_signature.write_time_ns = get_dict_int(dict, "obj_write_time_ns");
+  record.obj_signature.change_time_ns = get_dict_int(dict, "obj_change_time_ns");
+  record.obj_signature.inode = get_dict_int(dict, "obj_inode");
 
   record.obj_hash =
       data.try_get_value<FieldVarType::Integer>("obj_hash", FieldVar::Int())
           .get_int();
 
+  record.build_failed =
+      data.try_get_value<FieldVarType::Boolean>("build_failed",
+                                                FieldVar::Bool(false))
+          .get_bool();
+
   return ErrorReport();
-}
\ No newline at end of file
+}
+
+inline void load_toolchain_records(BuildCache::toolchain_record_table &records,
+                                   const FieldVar::Dict &data) {
+  for (const auto &[name, value] : data)
+  {
+    // a broken record only means the compiler is fingerprinted again
+    if (value.get_type() != FieldVarType::Dict)
+    {
+      continue;
+    }
+
+    const FieldVar::Dict &dict = value.get_dict();
+
+    BuildCache::ToolchainRecord record{};
+    record.path = get_dict_string(dict, "path");
+    record.size = get_dict_int(dict, "size");
+    record.write_time = get_dict_int(dict, "write_time");
+    record.version = get_dict_string(dict, "version");
+    record.fingerprint = get_dict_int(dict, "fingerprint");
+
+    records.insert_or_assign(name, record);
+  }
+}
+
+inline void load_scan_records(BuildCache::scan_record_table &records,
+                              const FieldVar::Dict &data) {
+  for (const auto &[path, value] : data)
+  {
+    // a broken record only means the file is scanned again
+    if (value.get_type() != FieldVarType::Dict)
+    {
+      continue;
+    }
+
+    const FieldVar::Dict &dict = value.get_dict();
+
+    BuildCache::ScanRecord record{};
+    record.signature.size = get_dict_int(dict, "size");
+    record.signature.write_time_ns = get_dict_int(dict, "write_time_ns");
+    record.signature.change_time_ns = get_dict_int(dict, "change_time_ns");
+    record.signature.inode = get_dict_int(dict, "inode");
+    record.content_hash = get_dict_int(dict, "content_hash");
+
+    const auto includes_iter = dict.find("includes");
+    if (includes_iter == dict.end() ||
+        includes_iter->second.get_type() != FieldVarType::Array)
+    {
+      continue;
+    }
+
+    for (const FieldVar &include : includes_iter->second.get_array())
+    {
+      if (include.get_type() == FieldVarType::String)
+      {
+        record.includes.push_back(include.get_string());
+      }
+    }
+
+    // the records from before the redefined macros were tracked are scanned again
+    const auto redefined_iter = dict.find("redefined_macros");
+    if (redefined_iter == dict.end() ||
+        redefined_iter->second.get_type() != FieldVarType::Array)
+    {
+      continue;
+    }
+
+    for (const FieldVar &name : redefined_iter->second.get_array())
+    {
+      if (name.get_type() == FieldVarType::String)
+      {
+        record.redefined_macros.push_back(name.get_string());
+      }
+    }
+
+    records.insert_or_assign(path, record);
+  }
+}
+
+inline void drop_hashes(BuildCache &cache) {
+  cache.hash_algorithm = HashTools::Algorithm;
+  cache.build_hash = 0;
+  cache.config_hash = 0;
+
+  for (auto &[_, record] : cache.file_records)
+  {
+    record.hash = 0;
+    record.obj_hash = 0;
+    record.obj_signature = {};
+  }
+
+  cache.toolchain_path_hash = 0;
+  cache.toolchain_records = {};
+  cache.scan_macros = {};
+  cache.scan_macros_hash = 0;
+  cache.scan_records = {};
+}
+
+inline FilePath load_path(const BuildCacheFile &file,
+                          BuildCacheFile::StringRef ref,
+                          std::string_view root_directory) {
+  return BuildCache::resolve_stored_path(root_directory, file.get_string(ref));
+}
+
+inline FieldVar::Int get_dict_int(const FieldVar::Dict &dict,
+                                  const char *name) {
+  const auto iter = dict.find(name);
+  if (iter == dict.end() || iter->second.get_type() != FieldVarType::Integer)
+  {
+    return 0;
+  }
+  return iter->second.get_int();
+}
+
+inline FieldVar::String get_dict_string(const FieldVar::Dict &dict,
+                                        const char *name) {
+  const auto iter = dict.find(name);
+  if (iter == dict.end() || iter->second.get_type() != FieldVarType::String)
+  {
+    return {};
+  }
+  return iter->second.get_string();
+}
@@ -1,12 +1,14 @@
 #pragma once
 #include <set>
 
+#include "BuildCacheFile.hpp"
 #include "FieldDataReader.hpp"
 #include "FilePath.hpp"
 #include "HashTools.hpp"
 #include "base.hpp"
 #include "misc/Time.hpp"
 #include "misc/hash128.hpp"
+#include "utility/FileStats.hpp"
 
 struct BuildCache
 {
@@ -17,13 +19,55 @@ struct BuildCache
   {
     FilePath output_path = {};
     hash_t hash = 0;
-    int64_t obj_size = 0;
     hash_t obj_hash = 0;
-    
+    // the object's signature when `obj_hash` was taken, an object still matching it isn't
+    // hashed again
+    FileSignature obj_signature = {};
+
     t::microsecond_t source_write_time = 0;
+
+    // how long the last compilation of this source took, zero if unknown
+    t::microsecond_t build_wall_time = 0;
+    t::microsecond_t build_user_time = 0;
+    t::microsecond_t build_system_time = 0;
+    // the last compilation of this source failed
+    bool build_failed = false;
   };
   typedef std::map<FilePath, FileRecord> file_record_table;
 
+  // a compiler resolved from $PATH, see `Toolchain`
+  struct ToolchainRecord
+  {
+    FilePath path = {};
+    int64_t size = 0;
+    t::microsecond_t write_time = 0;
+    // the first line of `<compiler> --version`
+    string version = {};
+    hash_t fingerprint = 0;
+  };
+  typedef std::map<string, ToolchainRecord> toolchain_record_table;
+
+  // what the source processor extracted from a file, reused while the file's
+  // signature is unchanged
+  struct ScanRecord
+  {
+    FileSignature signature = {};
+    hash_t content_hash = 0;
+    vector<string> includes = {};
+    // the known macros the file #defines or #undefs, see `CPreprocessor::Macro::redefined`
+    vector<string> redefined_macros = {};
+  };
+  typedef std::map<FilePath, ScanRecord> scan_record_table;
+
+  // a macro the compilers predefine (or a compiler owned one they don't), see
+  // `CPreprocessor::Macro`
+  struct MacroRecord
+  {
+    bool defined = false;
+    string value = {};
+  };
+  typedef std::map<string, MacroRecord> macro_record_table;
+
   // removes old duplicates (records with the same source path)
   void fix_file_records();
 
@@ -36,13 +80,52 @@ struct BuildCache
 
   bool is_compatible_with(const BuildCache &older_cache) const;
 
-  static BuildCache load(const FieldDataReader &data, ErrorReport &error);
+  // the text caches written by older versions, the stored paths are resolved against
+  // `root_directory` (see `resolve_stored_path`)
+  static BuildCache load(const FieldDataReader &data,
+                         std::string_view root_directory,
+                         ErrorReport &error);
+  static BuildCache load(const BuildCacheFile &file,
+                         std::string_view root_directory,
+                         ErrorReport &error);
+  static FileRecord load_file_record(const BuildCacheFile &file,
+                                     const BuildCacheFile::FileRecordEntry &entry,
+                                     std::string_view root_directory);
+
+  // `path` relative to `root_directory` if it's under it, as is otherwise
+  static std::string_view get_stored_path(std::string_view root_directory, std::string_view path);
+  // a relative `stored_path` joined to `root_directory`, an absolute one as is
+  static FilePath resolve_stored_path(std::string_view root_directory,
+                                      std::string_view stored_path);
+
+  // the cache as text, for debugging (`bgnu cache dump`)
   FieldVar::Dict write() const;
+  static FieldVar::Dict write_file_record(const FileRecord &record);
+
+  // the project's directory (ending with a separator), the paths under it are stored relative
+  // to it, so the cache stays valid when the project is moved or restored somewhere else, it's
+  // not stored itself
+  string root_directory = {};
 
   t::microsecond_t build_time;
+  // the `HashTools::Algorithm` the cache's hashes were made with
+  int64_t hash_algorithm = HashTools::Algorithm;
   hash_t build_hash = 0;
   hash_t config_hash = 0;
 
   // source file (key), a record (value)
   file_record_table file_records;
+
+  // the $PATH the toolchain records were resolved with
+  hash_t toolchain_path_hash = 0;
+  // compiler name (key), the resolved compiler (value)
+  toolchain_record_table toolchain_records;
+
+  // the compilers' predefined macros for the configuration, queried again only when the
+  // configuration's hash (which covers the compilers) changes
+  macro_record_table scan_macros;
+  // the hash of the macros the includes were scanned with
+  hash_t scan_macros_hash = 0;
+  // source/header file (key), the file's last scan (value)
+  scan_record_table scan_records;
 };
@@ -0,0 +1,289 @@
+#include "BuildCacheFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+#include "BuildCache.hpp"
+#include "HashTools.hpp"
+#include "Logger.hpp"
+#include "utility/AtomicFile.hpp"
+
+static_assert(std::is_trivially_copyable_v<BuildCacheFile::Header>);
+static_assert(sizeof(BuildCacheFile::FileRecordEntry) % 8 == 0);
+static_assert(sizeof(BuildCacheFile::ToolchainEntry) % 8 == 0);
+static_assert(sizeof(BuildCacheFile::ScanEntry) % 8 == 0);
+static_assert(sizeof(BuildCacheFile::MacroEntry) % 8 == 0);
+
+// builds a cache file in memory, tables are appended (8 bytes aligned) after the header
+class CacheFileBuilder
+{
+public:
+  inline CacheFileBuilder() { m_buffer.resize(sizeof(BuildCacheFile::Header)); }
+
+  BuildCacheFile::StringRef intern(std::string_view str);
+
+  template <typename T>
+  BuildCacheFile::Section append_table(const vector<T> &entries);
+
+  // appends the string pool & returns the whole file
+  string finish(BuildCacheFile::Header &header);
+
+private:
+  string m_buffer = {};
+  string m_strings = {};
+  std::unordered_map<string, BuildCacheFile::StringRef> m_string_index = {};
+};
+
+// `stored_path` is the source's path as stored, see `BuildCache::get_stored_path`
+static BuildCacheFile::FileRecordEntry MakeFileRecordEntry(CacheFileBuilder &builder,
+                                                           std::string_view stored_path,
+                                                           const BuildCache::FileRecord &record,
+                                                           std::string_view root_directory);
+
+Error BuildCacheFile::open(const FilePath &path) {
+  close();
+
+  if (!m_file.open(path))
+  {
+    return Error::FileNotFound;
+  }
+
+  if (!IsBinary(m_file.get_content()))
+  {
+    close();
+    return Error::InvalidType;
+  }
+
+  const auto fail = [this, &path](const char *reason) {
+    Logger::verbose("ignoring the build cache at '%s': %s", path.c_str(), reason);
+    close();
+    return Error::Failure;
+  };
+
+  if (m_file.size() < sizeof(Header))
+  {
+    return fail("truncated");
+  }
+
+  const Header &header = get_header();
+  if (header.version != Version || header.byte_order != ByteOrderMark)
+  {
+    return fail("written by another version or machine");
+  }
+
+  if (header.file_size != m_file.size())
+  {
+    return fail("truncated");
+  }
+
+  if (!is_table_valid<FileRecordEntry>(header.file_records) ||
+      !is_table_valid<ToolchainEntry>(header.toolchain_records) ||
+      !is_table_valid<ScanEntry>(header.scan_records) ||
+      !is_table_valid<StringRef>(header.scan_includes) ||
+      !is_table_valid<MacroEntry>(header.scan_macros) || !is_table_valid<char>(header.strings))
+  {
+    return fail("a table is out of the file");
+  }
+
+  return Error::Ok;
+}
+
+bool BuildCacheFile::IsBinary(const StrBlob &content) {
+  return content.size() >= sizeof(Magic) && memcmp(content.data, Magic, sizeof(Magic)) == 0;
+}
+
+std::string_view BuildCacheFile::get_string(StringRef ref) const noexcept {
+  const Section &strings = get_header().strings;
+  if (uint64_t(ref.offset) + ref.size > strings.count)
+  {
+    return {};
+  }
+
+  return { m_file.data() + strings.offset + ref.offset, ref.size };
+}
+
+const BuildCacheFile::FileRecordEntry *
+BuildCacheFile::find_file_record(std::string_view path) const {
+  const Blob<const FileRecordEntry> records = get_file_records();
+
+  const FileRecordEntry *entry = std::lower_bound(
+      records.begin(), records.end(), path, [this](const FileRecordEntry &entry, std::string_view key) {
+        return get_string(entry.path) < key;
+      });
+
+  if (entry == records.end() || get_string(entry->path) != path)
+  {
+    return nullptr;
+  }
+
+  return entry;
+}
+
+bool BuildCacheFile::Write(const BuildCache &cache, const FilePath &path) {
+  CacheFileBuilder builder{};
+  Header header{};
+
+  memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.byte_order = ByteOrderMark;
+  header.hash_algorithm = HashTools::Algorithm;
+  header.build_hash = cache.build_hash;
+  header.config_hash = cache.config_hash;
+  header.build_time = cache.build_time;
+  header.toolchain_path_hash = cache.toolchain_path_hash;
+  header.scan_macros_hash = cache.scan_macros_hash;
+
+  // the paths under the project's directory are stored relative to it
+  const std::string_view root_directory = cache.root_directory;
+
+  // sorted by the stored source path's bytes, the order `find_file_record` searches in
+  vector<pair<std::string_view, const BuildCache::FileRecord *>> sorted_records{};
+  sorted_records.reserve(cache.file_records.size());
+  for (const auto &[source_path, record] : cache.file_records)
+  {
+    sorted_records.emplace_back(BuildCache::get_stored_path(root_directory, source_path.c_str()),
+                                &record);
+  }
+
+  std::sort(sorted_records.begin(), sorted_records.end(), [](const auto &left, const auto &right) {
+    return left.first < right.first;
+  });
+
+  vector<FileRecordEntry> records{};
+  records.reserve(sorted_records.size());
+  for (const auto &[source_path, record] : sorted_records)
+  {
+    records.push_back(MakeFileRecordEntry(builder, source_path, *record, root_directory));
+  }
+  header.file_records = builder.append_table(records);
+
+  vector<ToolchainEntry> toolchains{};
+  toolchains.reserve(cache.toolchain_records.size());
+  for (const auto &[name, record] : cache.toolchain_records)
+  {
+    toolchains.push_back(ToolchainEntry{ builder.intern(name),
+                                         builder.intern(record.path.c_str()),
+                                         builder.intern(record.version),
+                                         record.size,
+                                         record.write_time,
+                                         record.fingerprint });
+  }
+  header.toolchain_records = builder.append_table(toolchains);
+
+  vector<ScanEntry> scans{};
+  vector<StringRef> includes{};
+  scans.reserve(cache.scan_records.size());
+  for (const auto &[scan_path, record] : cache.scan_records)
+  {
+    const StringRef stored_path =
+        builder.intern(BuildCache::get_stored_path(root_directory, scan_path.c_str()));
+    scans.push_back(ScanEntry{ stored_path,
+                               uint32_t(includes.size()),
+                               uint32_t(record.includes.size()),
+                               uint32_t(includes.size() + record.includes.size()),
+                               uint32_t(record.redefined_macros.size()),
+                               record.signature.size,
+                               record.signature.write_time_ns,
+                               record.signature.change_time_ns,
+                               record.signature.inode,
+                               record.content_hash });
+
+    for (const string &include : record.includes)
+    {
+      includes.push_back(builder.intern(include));
+    }
+
+    for (const string &name : record.redefined_macros)
+    {
+      includes.push_back(builder.intern(name));
+    }
+  }
+  header.scan_records = builder.append_table(scans);
+  header.scan_includes = builder.append_table(includes);
+
+  vector<MacroEntry> macros{};
+  macros.reserve(cache.scan_macros.size());
+  for (const auto &[name, record] : cache.scan_macros)
+  {
+    macros.push_back(MacroEntry{
+        builder.intern(name), builder.intern(record.value), uint32_t(record.defined), 0 });
+  }
+  header.scan_macros = builder.append_table(macros);
+
+  const string content = builder.finish(header);
+
+  // renamed into place, an interrupted write (or a concurrent reader) never sees a partial cache
+  if (!AtomicFile::Write(path, StrBlob{ content.data(), content.size() }))
+  {
+    Logger::error("can't write the build cache to '%s'", path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+template <typename T>
+bool BuildCacheFile::is_table_valid(const Section &section) const noexcept {
+  if (section.offset % alignof(T) != 0 || section.offset > m_file.size())
+  {
+    return false;
+  }
+
+  return section.count <= (m_file.size() - section.offset) / sizeof(T);
+}
+
+BuildCacheFile::StringRef CacheFileBuilder::intern(std::string_view str) {
+  const auto [iter, inserted] =
+      m_string_index.try_emplace(string(str),
+                                 BuildCacheFile::StringRef{ uint32_t(m_strings.size()),
+                                                            uint32_t(str.size()) });
+  if (inserted)
+  {
+    m_strings.append(str);
+  }
+
+  return iter->second;
+}
+
+template <typename T>
+BuildCacheFile::Section CacheFileBuilder::append_table(const vector<T> &entries) {
+  // every table starts aligned, it's entries are read in place
+  m_buffer.resize((m_buffer.size() + 7) & ~size_t(7));
+
+  const BuildCacheFile::Section section{ m_buffer.size(), entries.size() };
+  m_buffer.append(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(T));
+  return section;
+}
+
+string CacheFileBuilder::finish(BuildCacheFile::Header &header) {
+  header.strings = { m_buffer.size(), m_strings.size() };
+  m_buffer.append(m_strings);
+
+  header.file_size = m_buffer.size();
+  memcpy(m_buffer.data(), &header, sizeof(header));
+  return std::move(m_buffer);
+}
+
+inline BuildCacheFile::FileRecordEntry MakeFileRecordEntry(CacheFileBuilder &builder,
+                                                           std::string_view stored_path,
+                                                           const BuildCache::FileRecord &record,
+                                                           std::string_view root_directory) {
+  BuildCacheFile::FileRecordEntry entry{};
+  entry.path = builder.intern(stored_path);
+  entry.output_path =
+      builder.intern(BuildCache::get_stored_path(root_directory, record.output_path.c_str()));
+  entry.hash = record.hash;
+  entry.obj_hash = record.obj_hash;
+  entry.obj_size = record.obj_signature.size;
+  entry.obj_write_time_ns = record.obj_signature.write_time_ns;
+  entry.obj_change_time_ns = record.obj_signature.change_time_ns;
+  entry.obj_inode = record.obj_signature.inode;
+  entry.source_write_time = record.source_write_time;
+  entry.build_wall_time = record.build_wall_time;
+  entry.build_user_time = record.build_user_time;
+  entry.build_system_time = record.build_system_time;
+  entry.flags = record.build_failed ? BuildCacheFile::RecordFlag_BuildFailed : 0;
+  return entry;
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <string_view>
+
+#include "FilePath.hpp"
+#include "base.hpp"
+#include "misc/Blob.hpp"
+#include "misc/Error.hpp"
+#include "misc/hash128.hpp"
+#include "utility/MappedFile.hpp"
+
+struct BuildCache;
+
+// the binary build cache, read in place from a mapping
+//
+// the file is a header, fixed width tables (the file records sorted by their source path,
+// the toolchain records, the scan records & the compilers' macros) & a pool of the interned
+// strings they point into, so a record is looked up by a binary search over the mapping
+// without parsing anything, the tables are in the writer's byte order (checked by the header)
+class BuildCacheFile
+{
+public:
+  static constexpr char Magic[8] = { 'B', 'G', 'N', 'U', 'C', 'A', 'C', 'H' };
+  // bumped whenever an entry's layout changes, a cache of another version is rebuilt
+  static constexpr uint32_t Version = 3;
+  static constexpr uint32_t ByteOrderMark = 0x01020304;
+
+  // a string in the pool
+  struct StringRef
+  {
+    uint32_t offset = 0;
+    uint32_t size = 0;
+  };
+
+  // a table's position in the file, `count` is in entries (bytes for the string pool)
+  struct Section
+  {
+    uint64_t offset = 0;
+    uint64_t count = 0;
+  };
+
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+
+    int64_t hash_algorithm;
+    hash_t build_hash;
+    hash_t config_hash;
+    int64_t build_time;
+    hash_t toolchain_path_hash;
+    hash_t scan_macros_hash;
+
+    Section file_records;
+    Section toolchain_records;
+    Section scan_records;
+    // the includes of the scan records (`StringRef`s)
+    Section scan_includes;
+    Section scan_macros;
+    Section strings;
+  };
+
+  enum RecordFlags : uint32_t {
+    RecordFlag_BuildFailed = 0x01,
+  };
+
+  struct FileRecordEntry
+  {
+    StringRef path;
+    StringRef output_path;
+    hash_t hash;
+    hash_t obj_hash;
+    int64_t obj_size;
+    int64_t obj_write_time_ns;
+    int64_t obj_change_time_ns;
+    uint64_t obj_inode;
+    int64_t source_write_time;
+    int64_t build_wall_time;
+    int64_t build_user_time;
+    int64_t build_system_time;
+    uint32_t flags;
+    uint32_t reserved;
+  };
+
+  struct ToolchainEntry
+  {
+    StringRef name;
+    StringRef path;
+    StringRef version;
+    int64_t size;
+    int64_t write_time;
+    hash_t fingerprint;
+  };
+
+  struct MacroEntry
+  {
+    StringRef name;
+    StringRef value;
+    uint32_t defined;
+    uint32_t reserved;
+  };
+
+  struct ScanEntry
+  {
+    StringRef path;
+    // the entry's includes are `scan_includes[includes_offset, includes_offset + includes_count)`
+    uint32_t includes_offset;
+    uint32_t includes_count;
+    // in the same table as the includes
+    uint32_t redefined_offset;
+    uint32_t redefined_count;
+    int64_t size;
+    int64_t write_time_ns;
+    int64_t change_time_ns;
+    uint64_t inode;
+    hash_t content_hash;
+  };
+
+  inline BuildCacheFile() = default;
+
+  // the file stays closed on an error: `FileNotFound` if it can't be read, `InvalidType` if
+  // it's not a binary cache (a text cache of an older version) & `Failure` if it's of another
+  // version or broken
+  Error open(const FilePath &path);
+  inline void close() noexcept { m_file.close(); }
+
+  inline bool is_open() const noexcept { return m_file.is_open(); }
+
+  // true if `content` starts like a binary cache (of any version)
+  static bool IsBinary(const StrBlob &content);
+
+  inline const Header &get_header() const noexcept {
+    return *reinterpret_cast<const Header *>(m_file.data());
+  }
+
+  inline Blob<const FileRecordEntry> get_file_records() const {
+    return get_table<FileRecordEntry>(get_header().file_records);
+  }
+  inline Blob<const ToolchainEntry> get_toolchain_records() const {
+    return get_table<ToolchainEntry>(get_header().toolchain_records);
+  }
+  inline Blob<const ScanEntry> get_scan_records() const {
+    return get_table<ScanEntry>(get_header().scan_records);
+  }
+  inline Blob<const StringRef> get_scan_includes() const {
+    return get_table<StringRef>(get_header().scan_includes);
+  }
+  inline Blob<const MacroEntry> get_scan_macros() const {
+    return get_table<MacroEntry>(get_header().scan_macros);
+  }
+
+  // empty if `ref` is out of the pool
+  std::string_view get_string(StringRef ref) const noexcept;
+
+  // binary searches the file records, null if `path` has no record
+  const FileRecordEntry *find_file_record(std::string_view path) const;
+
+  // writes `cache` to `path`, returns false if it can't be written
+  static bool Write(const BuildCache &cache, const FilePath &path);
+
+private:
+  template <typename T>
+  inline Blob<const T> get_table(const Section &section) const {
+    return { reinterpret_cast<const T *>(m_file.data() + section.offset), section.count };
+  }
+
+  template <typename T>
+  bool is_table_valid(const Section &section) const noexcept;
+
+private:
+  MappedFile m_file;
+};
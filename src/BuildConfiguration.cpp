@@ -11,6 +11,7 @@
 #include "Result.hpp"
 #include "Settings.hpp"
 #include "StringTools.hpp"
+#include "Toolchain.hpp"
 #include "base.hpp"
 #include "code/SourceTools.hpp"
 #include "io/FieldWriter.hpp"
@@ -124,39 +125,41 @@ struct BuildConfigurationReader
   ErrorReport &result;
 };
 
-void BuildConfiguration::_put_compiler(vector<string> &output,
+void BuildConfiguration::_put_compiler(ArgumentList &output,
                                        SourceFileType source_type) const {
   const std::string compiler_name =
       BuildConfiguration::get_compiler_name(this->compiler_type.field(),
                                             source_type);
 
-  output.emplace_back(compiler_name);
+  // the compiler is resolved once per run, and spawned from it's absolute path
+  const Toolchain::Record *compiler = Toolchain::Get(compiler_name);
+  if (compiler == nullptr)
+  {
+    output.push_back(compiler_name);
+    return;
+  }
 
-  FilePath compiler_abs_path = FilePath::FindExecutableInPATHEnv(compiler_name);
+  output.push_back(compiler->path.c_str());
 
-  if (!compiler_abs_path.empty())
+  const FilePath compiler_dir = compiler->path.parent();
+  if (!compiler_dir.is_absolute())
   {
-    compiler_abs_path = compiler_abs_path.parent();
-    if (!compiler_abs_path.is_absolute())
-    {
-      Logger::error("Compiler '%s' didn't resolve to an absolute path: '%s'",
-                    compiler_name.c_str(),
-                    compiler_abs_path.c_str());
-    }
-
-    std::string arg = "-B";
-    arg.append(compiler_abs_path);
-    output.emplace_back(arg);
+    Logger::error("Compiler '%s' didn't resolve to an absolute path: '%s'",
+                  compiler_name.c_str(),
+                  compiler_dir.c_str());
   }
+
+  output.push_back("-B");
+  output.append_back(compiler_dir.c_str());
 }
 
-void BuildConfiguration::_put_predefines(vector<string> &output) const {
+void BuildConfiguration::_put_predefines(ArgumentList &output) const {
   for (const auto &[name, value] : predefines.field())
   {
     if (value.is_null())
     {
-      output.emplace_back("-D");
-      output.back().append(name);
+      output.push_back("-D");
+      output.append_back(name);
       continue;
     }
 
@@ -175,89 +178,90 @@ void BuildConfiguration::_put_predefines(vector<string> &output) const {
 
     if (value.get_type() != FieldVarType::String)
     {
-      output.emplace_back("-D");
-      output.back().append(name);
-      output.back().append("=\"");
+      output.push_back("-D");
+      output.append_back(name);
+      output.append_back("=\"");
 
       // FIXME: escape the value before appending
-      output.back().append(value.copy_stringified().get_string());
+      output.append_back(value.copy_stringified().get_string());
 
-      output.back().append("\"");
+      output.append_back("\"");
     }
   }
 }
 
-void BuildConfiguration::_put_flags(vector<string> &output) const {
+void BuildConfiguration::_put_flags(ArgumentList &output) const {
   if (this->exit_on_errors.field())
   {
-    output.emplace_back("-Wfatal-errors");
+    output.push_back("-Wfatal-errors");
   }
 
   if (this->static_stdlib.field())
   {
-    output.emplace_back("-static-libgcc");
-    output.emplace_back("-static-libstdc++");
+    output.push_back("-static-libgcc");
+    output.push_back("-static-libstdc++");
   }
 
   if (Settings::Get("color_output", true))
   {
-    output.emplace_back("-fdiagnostics-color=always");
+    output.push_back("-fdiagnostics-color=always");
   }
 
   if (sanitize_addresses.field())
   {
-    output.emplace_back("-fsanitize=address");
+    output.push_back("-fsanitize=address");
   }
 
   if (sanitize_leaks.field())
   {
-    output.emplace_back("-fsanitize=leak");
+    output.push_back("-fsanitize=leak");
   }
 
   if (sanitize_undefined.field())
   {
-    output.emplace_back("-fsanitize=undefined");
+    output.push_back("-fsanitize=undefined");
   }
 
   if (sanitize_thread.field())
   {
-    output.emplace_back("-fsanitize=thread");
+    output.push_back("-fsanitize=thread");
   }
 }
 
-void BuildConfiguration::_put_standards(vector<string> &output,
+void BuildConfiguration::_put_standards(ArgumentList &output,
                                         SourceFileType type) const {
   StandardType standard_type =
       build_tools::FitStandardToFileType(standard.field(), type);
 
-  output.emplace_back("-std=");
-  output.back().append(get_enum_name(standard_type));
+  output.push_back("-std=");
+  output.append_back(get_enum_name(standard_type));
 }
 
-void BuildConfiguration::_put_optimization(vector<string> &output) const {
+void BuildConfiguration::_put_optimization(ArgumentList &output) const {
 
   switch (optimization->type.field())
   {
   case OptimizationType::None:
-    output.emplace_back("-O0");
+    output.push_back("-O0");
     return;
 
   case OptimizationType::Release:
-    output.emplace_back("-O");
-    output.back().append(1,
-                         '0' + static_cast<char>(optimization->degree.field()));
+    output.push_back("-O");
+    output.append_back(
+        string(1, '0' + static_cast<char>(optimization->degree.field())));
     return;
 
   case OptimizationType::Debug: {
     if (optimization->debug_optimizing.field())
     {
-      output.emplace_back("-Og");
+      output.push_back("-Og");
     }
 
-    output.emplace_back("-g");
+    output.push_back("-g");
     if (optimization->degree.field() != OptimizationDegree::None)
     {
-      output.back().append(1, '0' + (int)optimization->degree.field());
+      output.append_back(
+          string(1, '0' + static_cast<char>(optimization->degree.field())));
     }
 
     return;
@@ -266,16 +270,16 @@ void BuildConfiguration::_put_optimization(vector<string> &output) const {
   case OptimizationType::Size: {
     if ((int)optimization->degree.field() >= (int)OptimizationDegree::High)
     {
-      output.emplace_back("-Oz");
+      output.push_back("-Oz");
       return;
     }
 
-    output.emplace_back("-Os");
+    output.push_back("-Os");
     return;
   }
 
   case OptimizationType::SpeedUnreliable: {
-    output.emplace_back("-Ofast");
+    output.push_back("-Ofast");
     return;
   }
 
@@ -284,135 +288,157 @@ void BuildConfiguration::_put_optimization(vector<string> &output) const {
   }
 }
 
-void BuildConfiguration::_put_warnings(vector<string> &output) const {
+void BuildConfiguration::_put_warnings(ArgumentList &output) const {
   switch (warnings->level.field())
   {
   case WarningLevel::None: {
     break;
   }
   case WarningLevel::All: {
-    output.emplace_back("-Wall");
+    output.push_back("-Wall");
     break;
   }
   case WarningLevel::Extra: {
-    output.emplace_back("-Wextra");
+    output.push_back("-Wextra");
     break;
   }
   }
 
   if (warnings->pedantic.field())
   {
-    output.emplace_back("-Wpedantic");
+    output.push_back("-Wpedantic");
   }
 }
 
-void BuildConfiguration::_put_misc(vector<string> &output) const {
+void BuildConfiguration::_put_misc(ArgumentList &output) const {
   if (simd_type.field() != SIMDType::None)
   {
-    output.emplace_back("-m");
-    output.back().append(
+    output.push_back("-m");
+    output.append_back(
         string_tools::to_lower(get_enum_name(simd_type.field())));
   }
 
   if (Logger::is_verbose() &&
       Settings::Get("allow_verbose_gcc", false).get_bool())
   {
-    output.emplace_back("-v");
+    output.push_back("-v");
   }
 }
 
-void BuildConfiguration::_put_includes(vector<string> &output) const {
+void BuildConfiguration::_put_includes(ArgumentList &output) const {
   for (const auto &include_dir : include_directories.field())
   {
-    output.emplace_back("-I");
-
-    output.emplace_back();
-    output.back().append("\"");
-    output.back().append(include_dir);
-    output.back().append("\"");
+    output.push_back("-I");
+    output.push_back(include_dir.c_str());
   }
 }
 
-void BuildConfiguration::_put_libraries(vector<string> &output) const {
+void BuildConfiguration::_put_libraries(ArgumentList &output) const {
   for (const auto &lib_dir : library_directories.field())
   {
-    output.emplace_back("-L");
-
-    output.emplace_back();
-    output.back().append("\"");
-    output.back().append(lib_dir);
-    output.back().append("\"");
+    output.push_back("-L");
+    output.push_back(lib_dir.c_str());
   }
 
   for (const auto &lib_dir : library_names.field())
   {
-    output.emplace_back("-l");
-
-    output.emplace_back();
-    output.back().append("\"");
-    output.back().append(lib_dir);
-    output.back().append("\"");
+    output.push_back("-l");
+    output.push_back(lib_dir);
   }
 }
 
-void BuildConfiguration::_put_sub_args(vector<string> &output) const {
+void BuildConfiguration::_put_sub_args(ArgumentList &output) const {
   for (const auto &arg : extra_args.field())
   {
-    output.emplace_back(arg);
+    output.push_back(arg);
   }
 
   for (const auto &arg : preprocessor_args.field())
   {
-    output.emplace_back("-Xpreprocessor");
-    output.emplace_back(arg);
+    output.push_back("-Xpreprocessor");
+    output.push_back(arg);
   }
 
   for (const auto &arg : assembler_args.field())
   {
-    output.emplace_back("-Xassembler");
-    output.emplace_back(arg);
+    output.push_back("-Xassembler");
+    output.push_back(arg);
   }
 
   for (const auto &arg : linker_args.field())
   {
-    output.emplace_back("-Xlinker");
-    output.emplace_back(arg);
+    output.push_back("-Xlinker");
+    output.push_back(arg);
   }
 }
 
-void BuildConfiguration::build_arguments(vector<string> &output,
-                                         const StrBlob &input_file,
-                                         const StrBlob &output_file,
-                                         SourceFileType type) const {
+ArgumentTemplate BuildConfiguration::build_argument_template(
+    SourceFileType type) const {
+  ArgumentList args{};
+
+  _put_compiler(args, type);
+
+  _put_predefines(args);
+
+  _put_optimization(args);
+  _put_standards(args, type);
+  _put_warnings(args);
+  _put_flags(args);
+  _put_misc(args);
+  _put_sub_args(args);
+
+  _put_includes(args);
+
+  args.push_back("-c");
+
+  ArgumentTemplate result{};
+  result.extend_back(args);
+  result.push_slot(ArgumentTemplate::Slot::Input);
+
+  result.push_back("-o");
+  result.push_slot(ArgumentTemplate::Slot::Output);
+
+  args.clear();
+  _put_libraries(args);
+  result.extend_back(args);
+
+  return result;
+}
+
+void BuildConfiguration::build_macro_query_arguments(ArgumentList &output,
+                                                     SourceFileType type) const {
   _put_compiler(output, type);
 
   _put_predefines(output);
 
   _put_optimization(output);
   _put_standards(output, type);
-  _put_warnings(output);
   _put_flags(output);
   _put_misc(output);
-  _put_sub_args(output);
 
-  _put_includes(output);
+  output.push_back("-dM");
+  output.push_back("-E");
+  output.push_back("-x");
+  output.push_back(type == SourceFileType::C ? "c" : "c++");
 
-  output.emplace_back("-c");
-
-  output.emplace_back("\"");
-  output.back().append(input_file.begin(), input_file.size());
-  output.back().append("\"");
-
-  output.emplace_back("-o");
-
-  output.emplace_back("\"");
-  output.back().append(output_file.begin(), output_file.size());
-  output.back().append("\"");
+#ifdef _WIN32
+  output.push_back("NUL");
+#else
+  output.push_back("/dev/null");
+#endif
+}
 
-  _put_libraries(output);
+void BuildConfiguration::build_arguments(ArgumentList &output,
+                                         const StrBlob &input_file,
+                                         const StrBlob &output_file,
+                                         SourceFileType type) const {
+  build_argument_template(type).instantiate(
+      output,
+      { input_file.begin(), input_file.size() },
+      { output_file.begin(), output_file.size() });
 }
 
-void BuildConfiguration::build_link_arguments(vector<string> &output,
+void BuildConfiguration::build_link_arguments(ArgumentList &output,
                                               const Blob<const StrBlob> &files,
                                               const StrBlob &ouput_file,
                                               SourceFileType type) const {
@@ -431,21 +457,17 @@ void BuildConfiguration::build_link_arguments(vector<string> &output,
 
   for (const StrBlob &blob : files)
   {
-    output.emplace_back(1, '"');
-    output.back().append(blob.begin(), blob.size());
-    output.back().append(1, '"');
+    output.push_back({ blob.begin(), blob.size() });
   }
 
-  output.emplace_back("-o");
+  output.push_back("-o");
 
-  output.emplace_back(1, '"');
-  output.back().append(ouput_file.begin(), ouput_file.size());
-  output.back().append(1, '"');
+  output.push_back({ ouput_file.begin(), ouput_file.size() });
 
   _put_libraries(output);
 }
 
-void BuildConfiguration::build_clangd_contents(vector<string> &output) const {
+void BuildConfiguration::build_clangd_contents(ArgumentList &output) const {
   _put_predefines(output);
   _put_standards(output, SourceFileType::CPP);
   _put_warnings(output);
@@ -10,6 +10,8 @@
 #include "base.hpp"
 #include "code/SourceTools.hpp"  // for SourceFileType
 #include "misc/Error.hpp"
+#include "utility/ArgumentList.hpp"
+#include "utility/ArgumentTemplate.hpp"
 #include "utility/NField.hpp"
 
 enum class CompilerType {
@@ -102,33 +104,41 @@ struct BuildConfiguration
 {
   inline BuildConfiguration() {}
 
-  void _put_compiler(vector<string> &output, SourceFileType source_type) const;
+  void _put_compiler(ArgumentList &output, SourceFileType source_type) const;
 
-  void _put_predefines(vector<string> &output) const;
-  void _put_flags(vector<string> &output) const;
+  void _put_predefines(ArgumentList &output) const;
+  void _put_flags(ArgumentList &output) const;
 
-  void _put_standards(vector<string> &output, SourceFileType type) const;
-  void _put_optimization(vector<string> &output) const;
-  void _put_warnings(vector<string> &output) const;
+  void _put_standards(ArgumentList &output, SourceFileType type) const;
+  void _put_optimization(ArgumentList &output) const;
+  void _put_warnings(ArgumentList &output) const;
 
-  void _put_misc(vector<string> &output) const;
+  void _put_misc(ArgumentList &output) const;
 
-  void _put_includes(vector<string> &output) const;
-  void _put_libraries(vector<string> &output) const;
+  void _put_includes(ArgumentList &output) const;
+  void _put_libraries(ArgumentList &output) const;
 
-  void _put_sub_args(vector<string> &output) const;
+  void _put_sub_args(ArgumentList &output) const;
 
-  void build_arguments(vector<string> &output,
+  // the compile arguments with slots for the input & output paths, the same for
+  // every source of `type`, so it can be built once and instantiated per source
+  ArgumentTemplate build_argument_template(SourceFileType type) const;
+
+  // the arguments making the compiler dump the macros it predefines for sources of `type`
+  // (it's builtins & the configuration's predefines) instead of compiling
+  void build_macro_query_arguments(ArgumentList &output, SourceFileType type) const;
+
+  void build_arguments(ArgumentList &output,
                        const StrBlob &input_file,
                        const StrBlob &output_file,
                        SourceFileType type) const;
 
-  void build_link_arguments(vector<string> &output,
+  void build_link_arguments(ArgumentList &output,
                             const Blob<const StrBlob> &files,
                             const StrBlob &ouput_file,
                             SourceFileType type) const;
 
-  void build_clangd_contents(vector<string> &output) const;
+  void build_clangd_contents(ArgumentList &output) const;
 
   hash_t hash() const;
 
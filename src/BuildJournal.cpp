@@ -0,0 +1,353 @@
+#include "BuildJournal.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <type_traits>
+
+#include "BuildCacheFile.hpp"
+#include "HashTools.hpp"
+#include "Logger.hpp"
+#include "utility/MappedFile.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <Windows.h>
+#endif
+
+struct JournalHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  int64_t hash_algorithm;
+  hash_t build_hash;
+  hash_t config_hash;
+};
+
+// precedes every record, the checksum covers the record's fields & paths
+struct JournalRecordHeader
+{
+  uint32_t size;
+  uint32_t reserved;
+  hash_t checksum;
+};
+
+// followed by the source & the output paths
+struct JournalRecordFields
+{
+  hash_t hash;
+  hash_t obj_hash;
+  int64_t obj_size;
+  int64_t obj_write_time_ns;
+  int64_t obj_change_time_ns;
+  uint64_t obj_inode;
+  int64_t source_write_time;
+  int64_t build_wall_time;
+  int64_t build_user_time;
+  int64_t build_system_time;
+  uint32_t source_path_size;
+  uint32_t output_path_size;
+};
+
+static_assert(std::is_trivially_copyable_v<JournalRecordFields>);
+
+static JournalHeader MakeHeader(const BuildCache &cache);
+static inline bool IsHeaderCompatible(const JournalHeader &left, const JournalHeader &right) {
+  return memcmp(&left, &right, sizeof(JournalHeader)) == 0;
+}
+
+// calls `callback` with every intact record's fields & paths, returns the size of the intact
+// part of the journal (zero if it's header is broken)
+template <typename Func>
+static size_t ReadRecords(const StrBlob &content, JournalHeader &header, Func &&callback);
+
+static bool WriteAll(BuildJournal::file_handle file, const char *data, size_t size);
+
+bool BuildJournal::open(const FilePath &path, const BuildCache &cache) {
+  close();
+
+  const JournalHeader header = MakeHeader(cache);
+
+  // the intact part of the last journal is kept if it was made by the same kind of build
+  size_t kept_size = 0;
+  {
+    const MappedFile old_file{ path };
+    JournalHeader old_header{};
+    if (old_file.is_open())
+    {
+      kept_size = ReadRecords(old_file.get_content(), old_header, [](auto &&...) {});
+      if (!IsHeaderCompatible(old_header, header))
+      {
+        kept_size = 0;
+      }
+    }
+  }
+
+  // a first build (or a rebuild, which removed the configuration's cache) opens it before
+  // anything else is written in it's directory
+  path.parent().create_directory();
+
+#ifdef __linux__
+  m_file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (m_file < 0 || ftruncate(m_file, off_t(kept_size)) != 0 ||
+      lseek(m_file, off_t(kept_size), SEEK_SET) < 0)
+#else
+  m_file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+  LARGE_INTEGER position{};
+  position.QuadPart = LONGLONG(kept_size);
+  if (m_file == INVALID_HANDLE_VALUE ||
+      !SetFilePointerEx(m_file, position, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file))
+#endif
+  {
+    Logger::warning("can't open the build journal at '%s', an interrupted build loses it's "
+                    "finished work",
+                    path.c_str());
+#ifndef __linux__
+    m_file = m_file == INVALID_HANDLE_VALUE ? InvalidFile : m_file;
+#endif
+    close();
+    return false;
+  }
+
+  if (kept_size == 0 && !WriteAll(m_file, reinterpret_cast<const char *>(&header), sizeof(header)))
+  {
+    close();
+    return false;
+  }
+
+  m_unsynced_count = 0;
+  m_root_directory = cache.root_directory;
+  return true;
+}
+
+void BuildJournal::close() noexcept {
+  if (!is_open())
+  {
+    return;
+  }
+
+  _sync();
+#ifdef __linux__
+  ::close(m_file);
+#else
+  CloseHandle(m_file);
+#endif
+  m_file = InvalidFile;
+}
+
+void BuildJournal::append(const FilePath &source_path, const BuildCache::FileRecord &record) {
+  const std::string_view source =
+      BuildCache::get_stored_path(m_root_directory, source_path.c_str());
+  const std::string_view output =
+      BuildCache::get_stored_path(m_root_directory, record.output_path.c_str());
+
+  JournalRecordFields fields{};
+  fields.hash = record.hash;
+  fields.obj_hash = record.obj_hash;
+  fields.obj_size = record.obj_signature.size;
+  fields.obj_write_time_ns = record.obj_signature.write_time_ns;
+  fields.obj_change_time_ns = record.obj_signature.change_time_ns;
+  fields.obj_inode = record.obj_signature.inode;
+  fields.source_write_time = record.source_write_time;
+  fields.build_wall_time = record.build_wall_time;
+  fields.build_user_time = record.build_user_time;
+  fields.build_system_time = record.build_system_time;
+  fields.source_path_size = uint32_t(source.size());
+  fields.output_path_size = uint32_t(output.size());
+
+  // a record is written with one call, a torn write only ever breaks the last one
+  string buffer{};
+  buffer.resize(sizeof(JournalRecordHeader));
+  buffer.append(reinterpret_cast<const char *>(&fields), sizeof(fields));
+  buffer.append(source).append(output);
+
+  JournalRecordHeader record_header{};
+  record_header.size = uint32_t(buffer.size() - sizeof(JournalRecordHeader));
+  record_header.checksum = HashTools::hash(
+      StrBlob{ buffer.data() + sizeof(JournalRecordHeader), record_header.size });
+  memcpy(buffer.data(), &record_header, sizeof(record_header));
+
+  std::scoped_lock<std::mutex> lock{ m_mutex };
+  if (!is_open())
+  {
+    return;
+  }
+
+  if (!WriteAll(m_file, buffer.data(), buffer.size()))
+  {
+    Logger::warning("can't append to the build journal, the rest of the build isn't journaled");
+#ifdef __linux__
+    ::close(m_file);
+#else
+    CloseHandle(m_file);
+#endif
+    m_file = InvalidFile;
+    return;
+  }
+
+  if (++m_unsynced_count >= SyncBatchSize)
+  {
+    _sync();
+  }
+}
+
+size_t BuildJournal::Replay(const FilePath &path, BuildCache &cache) {
+  const MappedFile file{ path };
+  if (!file.is_open())
+  {
+    return 0;
+  }
+
+  // an empty cache is the one a journal's build started from after a rebuild
+  const bool adopt_hashes = cache.build_hash == 0 && cache.config_hash == 0;
+  const JournalHeader expected_header = MakeHeader(cache);
+
+  JournalHeader header{};
+  vector<pair<FilePath, BuildCache::FileRecord>> records{};
+  ReadRecords(file.get_content(),
+              header,
+              [&records, &cache](const JournalRecordFields &fields,
+                                 std::string_view source,
+                                 std::string_view output) {
+                BuildCache::FileRecord record{};
+                record.output_path = BuildCache::resolve_stored_path(cache.root_directory, output);
+                record.hash = fields.hash;
+                record.obj_hash = fields.obj_hash;
+                record.obj_signature.size = fields.obj_size;
+                record.obj_signature.write_time_ns = fields.obj_write_time_ns;
+                record.obj_signature.change_time_ns = fields.obj_change_time_ns;
+                record.obj_signature.inode = fields.obj_inode;
+                record.source_write_time = fields.source_write_time;
+                record.build_wall_time = fields.build_wall_time;
+                record.build_user_time = fields.build_user_time;
+                record.build_system_time = fields.build_system_time;
+                records.emplace_back(BuildCache::resolve_stored_path(cache.root_directory, source),
+                                     record);
+              });
+
+  if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version ||
+      header.byte_order != BuildCacheFile::ByteOrderMark ||
+      header.hash_algorithm != HashTools::Algorithm)
+  {
+    Logger::verbose("ignoring the build journal at '%s': unknown format", path.c_str());
+    return 0;
+  }
+
+  if (!adopt_hashes && !IsHeaderCompatible(header, expected_header))
+  {
+    Logger::verbose("ignoring the build journal at '%s': written for another build",
+                    path.c_str());
+    return 0;
+  }
+
+  cache.build_hash = header.build_hash;
+  cache.config_hash = header.config_hash;
+
+  // the later record of a source wins
+  for (auto &[source_path, record] : records)
+  {
+    cache.override_old_source_record(source_path, record);
+  }
+
+  return records.size();
+}
+
+void BuildJournal::_sync() {
+  if (m_unsynced_count == 0)
+  {
+    return;
+  }
+
+#ifdef __linux__
+  fdatasync(m_file);
+#else
+  FlushFileBuffers(m_file);
+#endif
+  m_unsynced_count = 0;
+}
+
+inline JournalHeader MakeHeader(const BuildCache &cache) {
+  JournalHeader header{};
+  memcpy(header.magic, BuildJournal::Magic, sizeof(header.magic));
+  header.version = BuildJournal::Version;
+  header.byte_order = BuildCacheFile::ByteOrderMark;
+  header.hash_algorithm = HashTools::Algorithm;
+  header.build_hash = cache.build_hash;
+  header.config_hash = cache.config_hash;
+  return header;
+}
+
+template <typename Func>
+inline size_t ReadRecords(const StrBlob &content, JournalHeader &header, Func &&callback) {
+  if (content.size() < sizeof(JournalHeader))
+  {
+    return 0;
+  }
+  memcpy(&header, content.data, sizeof(header));
+
+  size_t position = sizeof(JournalHeader);
+  while (content.size() - position >= sizeof(JournalRecordHeader))
+  {
+    JournalRecordHeader record_header{};
+    memcpy(&record_header, content.data + position, sizeof(record_header));
+
+    const size_t record_end = position + sizeof(JournalRecordHeader) + record_header.size;
+    if (record_header.size < sizeof(JournalRecordFields) || record_end > content.size())
+    {
+      break;
+    }
+
+    const char *payload = content.data + position + sizeof(JournalRecordHeader);
+    if (HashTools::hash(StrBlob{ payload, record_header.size }) != record_header.checksum)
+    {
+      break;
+    }
+
+    JournalRecordFields fields{};
+    memcpy(&fields, payload, sizeof(fields));
+    if (sizeof(fields) + uint64_t(fields.source_path_size) + fields.output_path_size !=
+        record_header.size)
+    {
+      break;
+    }
+
+    const char *paths = payload + sizeof(fields);
+    callback(fields,
+             std::string_view(paths, fields.source_path_size),
+             std::string_view(paths + fields.source_path_size, fields.output_path_size));
+    position = record_end;
+  }
+
+  return position;
+}
+
+inline bool WriteAll(BuildJournal::file_handle file, const char *data, size_t size) {
+  while (size > 0)
+  {
+#ifdef __linux__
+    const ssize_t written = ::write(file, data, size);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+#else
+    DWORD written = 0;
+    if (!WriteFile(file, data, DWORD(size), &written, nullptr))
+    {
+      written = 0;
+    }
+#endif
+    if (written <= 0)
+    {
+      return false;
+    }
+
+    data += written;
+    size -= size_t(written);
+  }
+
+  return true;
+}
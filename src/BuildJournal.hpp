@@ -0,0 +1,62 @@
+#pragma once
+#include <mutex>
+
+#include "BuildCache.hpp"
+#include "FilePath.hpp"
+#include "base.hpp"
+
+// an append only log of the file records of the compiles finished since the last build
+// cache was written
+//
+// every finished compile appends it's record right away (synced in batches), an interrupted
+// build's finished work is replayed over the last build cache by the next build, the journal
+// is dropped once the build cache is written again, a torn last record (the process died
+// mid write) fails it's checksum & is ignored
+class BuildJournal
+{
+public:
+  static constexpr char Magic[8] = { 'B', 'G', 'N', 'U', 'J', 'R', 'N', 'L' };
+  static constexpr uint32_t Version = 1;
+  // the records appended between syncs
+  static constexpr size_t SyncBatchSize = 32;
+
+#ifdef __linux__
+  typedef int file_handle;
+  static constexpr file_handle InvalidFile = -1;
+#else
+  typedef void *file_handle;
+  static constexpr file_handle InvalidFile = nullptr;
+#endif
+
+  inline BuildJournal() = default;
+  inline ~BuildJournal() noexcept { close(); }
+
+  BuildJournal(const BuildJournal &) = delete;
+  BuildJournal &operator=(const BuildJournal &) = delete;
+
+  // continues the journal at `path` if it was written for the same hashes (the last build
+  // was interrupted as well), otherwise starts it over
+  bool open(const FilePath &path, const BuildCache &cache);
+  // syncs the appended records
+  void close() noexcept;
+
+  inline bool is_open() const noexcept { return m_file != InvalidFile; }
+
+  // thread safe
+  void append(const FilePath &source_path, const BuildCache::FileRecord &record);
+
+  // applies the records at `path` over `cache`, the records of a journal written for other
+  // hashes are skipped unless `cache` is empty (then the journal's hashes are adopted), returns
+  // the applied records count
+  static size_t Replay(const FilePath &path, BuildCache &cache);
+
+private:
+  void _sync();
+
+private:
+  file_handle m_file = InvalidFile;
+  size_t m_unsynced_count = 0;
+  // the paths are stored like the build cache stores them, see `BuildCache::root_directory`
+  string m_root_directory;
+  std::mutex m_mutex;
+};
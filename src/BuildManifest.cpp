@@ -0,0 +1,166 @@
+#include "BuildManifest.hpp"
+
+#include <algorithm>
+
+// size, write time, change time, inode
+static constexpr size_t SignatureFieldCount = 4;
+
+static inline FieldVar WriteSignature(const FileSignature &signature);
+static inline bool LoadSignature(FileSignature &signature, const FieldVar &data);
+
+void BuildManifest::add(const FilePath &path) {
+  add(path, FileSignature::Get(path));
+}
+
+void BuildManifest::add(const FilePath &path, const FileSignature &signature) {
+  signatures.insert_or_assign(path, signature);
+}
+
+void BuildManifest::add_directories(const FilePath &dir, const vector<FilePath> &excluded) {
+  vector<FilePath> directories{};
+  directories.push_back(dir);
+
+  while (!directories.empty())
+  {
+    const FilePath current = directories.back();
+    directories.pop_back();
+
+    add(current);
+
+    for (const auto &entry : current.create_iterator())
+    {
+      if (!entry.is_directory())
+      {
+        continue;
+      }
+
+      const FilePath path = FilePath(entry).resolved_copy();
+      if (std::find(excluded.begin(), excluded.end(), path) != excluded.end())
+      {
+        continue;
+      }
+
+      directories.push_back(path);
+    }
+  }
+}
+
+bool BuildManifest::has_invalid_signatures() const {
+  for (const auto &[_, signature] : signatures)
+  {
+    if (!signature.is_valid())
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool BuildManifest::is_up_to_date() const {
+  if (signatures.empty())
+  {
+    return false;
+  }
+
+  for (const auto &[path, signature] : signatures)
+  {
+    if (FileSignature::Get(path) != signature)
+    {
+      Logger::verbose("manifest: '%s' changed", path.c_str());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+BuildManifest BuildManifest::load(const FieldDataReader &data, ErrorReport &error) {
+  BuildManifest manifest{};
+
+  manifest.config_name =
+      data.try_get_value<FieldVarType::String>("config", FieldVar(FieldVar::String()))
+          .get_string();
+  manifest.settings_hash =
+      data.try_get_value<FieldVarType::Integer>("settings_hash", FieldVar(FieldVar::Int(0)))
+          .get_int();
+  manifest.toolchain_path_hash =
+      data.try_get_value<FieldVarType::Integer>("toolchain_path_hash",
+                                                FieldVar(FieldVar::Int(0)))
+          .get_int();
+
+  const FieldVar &signatures_data = data.try_get_value<FieldVarType::Dict>("signatures");
+  if (signatures_data.is_null())
+  {
+    error.code = Error::NoData;
+    error.message = "no signatures data";
+    return manifest;
+  }
+
+  for (const auto &[path, value] : signatures_data.get_dict())
+  {
+    FileSignature signature{};
+    if (!LoadSignature(signature, value))
+    {
+      error.code = Error::InvalidType;
+      error.message = format_join("invalid signature for '", path, "'");
+      return manifest;
+    }
+
+    manifest.signatures.insert_or_assign(path, signature);
+  }
+
+  return manifest;
+}
+
+FieldVar::Dict BuildManifest::write() const {
+  FieldVar::Dict dict{};
+
+  dict["config"] = FieldVar(config_name);
+  dict["settings_hash"] = FieldVar::Int(settings_hash);
+  dict["toolchain_path_hash"] = FieldVar::Int(toolchain_path_hash);
+
+  FieldVar::Dict signatures_dict{};
+  for (const auto &[path, signature] : signatures)
+  {
+    signatures_dict.insert_or_assign(path.c_str(), WriteSignature(signature));
+  }
+
+  dict["signatures"] = FieldVar{ signatures_dict };
+  return dict;
+}
+
+inline FieldVar WriteSignature(const FileSignature &signature) {
+  FieldVar::Array array{};
+  array.reserve(SignatureFieldCount);
+
+  array.emplace_back(FieldVar::Int(signature.size));
+  array.emplace_back(FieldVar::Int(signature.write_time_ns));
+  array.emplace_back(FieldVar::Int(signature.change_time_ns));
+  array.emplace_back(FieldVar::Int(signature.inode));
+
+  return FieldVar(array);
+}
+
+inline bool LoadSignature(FileSignature &signature, const FieldVar &data) {
+  if (data.get_type() != FieldVarType::Array ||
+      data.get_array().size() != SignatureFieldCount)
+  {
+    return false;
+  }
+
+  const FieldVar::Array &array = data.get_array();
+  for (const FieldVar &field : array)
+  {
+    if (field.get_type() != FieldVarType::Integer)
+    {
+      return false;
+    }
+  }
+
+  signature.size = array[0].get_int();
+  signature.write_time_ns = array[1].get_int();
+  signature.change_time_ns = array[2].get_int();
+  signature.inode = array[3].get_int();
+  return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <map>
+
+#include "FieldDataReader.hpp"
+#include "FilePath.hpp"
+#include "base.hpp"
+#include "misc/hash128.hpp"
+#include "utility/FileStats.hpp"
+
+// a stamp of the last successful full build
+//
+// holds the signatures of everything the build read or wrote (the project file, inputs,
+// objects, the output binary & the compilers), if none of them changed and the settings
+// & build mode are the same, building again would do nothing, so the build is skipped
+// right after loading the project
+struct BuildManifest
+{
+  typedef std::map<FilePath, FileSignature> signature_table;
+
+  // stamps the current signature of `path`
+  void add(const FilePath &path);
+  // stamps `path` with an already known signature
+  void add(const FilePath &path, const FileSignature &signature);
+  // stamps `dir` & all it's sub directories, except the ones in `excluded` (and their
+  // sub directories), a source added/removed under them changes their signature
+  void add_directories(const FilePath &dir, const vector<FilePath> &excluded);
+
+  // does any stamp have an invalid signature (unstat-able or racy file)
+  bool has_invalid_signatures() const;
+
+  // stats every stamped file, true if none of them changed
+  bool is_up_to_date() const;
+
+  static BuildManifest load(const FieldDataReader &data, ErrorReport &error);
+  FieldVar::Dict write() const;
+
+  string config_name = {};
+  hash_t settings_hash = 0;
+  // the $PATH the compilers were resolved with
+  hash_t toolchain_path_hash = 0;
+
+  // file or directory (key), it's signature at the end of the build (value)
+  signature_table signatures;
+};
@@ -1,21 +1,26 @@
 #include "BuildTools.hpp"
 
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <vector>
 
 #include "FilePath.hpp"
 #include "HashTools.hpp"
 #include "Settings.hpp"
+#include "Toolchain.hpp"
 #include "base.hpp"
+#include "utility/JobPool.hpp"
+#include "utility/MappedFile.hpp"
 #include "utility/Process.hpp"
-#include "utility/ThreadBatcher.hpp"
+#include "utility/ProcessReactor.hpp"
 
 using namespace build_tools;
 
 static bool DoesSourceTypeDominate(SourceFileType type, SourceFileType target);
-static void GenerateJoinArgs(const Blob<const BuildCommandInfo> &params,
-                             std::string *results);
+static unsigned long GetProcessTimeoutMs();
+// digests the output of a succeeded command & notifies it's `on_digested`
+static void DigestCommandOutput(const BuildCommandInfo &param);
 
 void build_tools::WriteAutoGeneratedHeader(std::ostream &stream) {
   std::time_t now =
@@ -183,7 +188,8 @@ string build_tools::EscapeQuotes(const StrBlob &str) {
 
   for (size_t i = 0; i < str.length; i++)
   {
-    if (str[i] == '"')
+    // backslashes too, the quoted arguments of a command have escaped quotes
+    if (str[i] == '"' || str[i] == '\\')
     {
       result.push_back('\\');
     }
@@ -214,47 +220,110 @@ void build_tools::DeleteBuildDir(const Project &project) {
 void build_tools::SetupHashes(BuildCache &cache,
                               const Project &proj,
                               const BuildConfiguration *config) {
-  cache.build_hash = proj.hash();
-  cache.config_hash = config->hash();
+  cache.build_hash = GetProjectHash(proj);
+  cache.config_hash = GetConfigHash(*config);
+}
+
+hash_t build_tools::GetProjectHash(const Project &project) {
+  HashDigester digester = {};
+  return project.hash_own(digester);
+}
+
+hash_t build_tools::GetConfigHash(const BuildConfiguration &config) {
+  const CompilerType compiler_type = config.compiler_type.field();
+
+  return HashTools::combine(
+      config.hash(),
+      Toolchain::GetFingerprint(
+          BuildConfiguration::get_compiler_name(compiler_type,
+                                                SourceFileType::C)),
+      Toolchain::GetFingerprint(
+          BuildConfiguration::get_compiler_name(compiler_type,
+                                                SourceFileType::CPP)));
 }
 
 hash_t build_tools::GetFileHash(const char *path) {
-  FILE *fp = fopen(path, "r");
+  const MappedFile file{ path };
 
-  if (fp == nullptr)
+  if (!file.is_open())
   {
     Logger::error("No File to hash at '%s'", path);
     return 0;
   }
 
-  const auto start = ftello(fp);
-  fseek(fp, 0, SEEK_END);
-  const auto end = ftell(fp);
-  rewind(fp);
+  return HashTools::hash(file.get_content(), 0);
+}
+
+void build_tools::DigestOutput(const FilePath &path, OutputDigest &digest) {
+  digest.signature = FileSignature::Get(path);
+  digest.hash = digest.signature.is_valid() ? GetFileHash(path.c_str()) : 0;
+}
+
+bool build_tools::IsObjectHeaderSane(const StrBlob &header) {
+  const auto *const bytes = reinterpret_cast<const uint8_t *>(header.data);
+  const size_t size = header.length;
 
-  const auto len = end - start;
-  char *p = new char[len]{};
+  const auto read_u16 = [bytes](size_t offset, bool little_endian) -> uint16_t {
+    return little_endian ? uint16_t(bytes[offset] | (bytes[offset + 1] << 8))
+                         : uint16_t((bytes[offset] << 8) | bytes[offset + 1]);
+  };
+  const auto read_u32 = [&read_u16](size_t offset, bool little_endian) -> uint32_t {
+    const uint32_t low = read_u16(offset + (little_endian ? 0 : 2), little_endian);
+    const uint32_t high = read_u16(offset + (little_endian ? 2 : 0), little_endian);
+    return low | (high << 16);
+  };
 
-  const auto read_len = fread(p, 1, len, fp);
+  // ELF: class, data encoding & version, then a relocatable (ET_REL) type
+  if (size >= 52 && memcmp(bytes, "\x7f" "ELF", 4) == 0)
+  {
+    const uint8_t elf_class = bytes[4];
+    const uint8_t encoding = bytes[5];
+    if ((elf_class != 1 && elf_class != 2) || (encoding != 1 && encoding != 2) ||
+        bytes[6] != 1)
+    {
+      return false;
+    }
 
-  fclose(fp);
+    return (elf_class == 1 || size >= 64) && read_u16(16, encoding == 1) == 1;
+  }
 
-  if (read_len != len)
+  // LLVM bitcode (lto objects), raw or wrapped
+  if (size >= 4 && (memcmp(bytes, "BC\xC0\xDE", 4) == 0 ||
+                    memcmp(bytes, "\xDE\xC0\x17\x0B", 4) == 0))
   {
-    Logger::warning(
-        "Hashing file '%s' might fail: len=%ld [%ld -> %ld], read_ln=%ld",
-        path,
-        len,
-        start,
-        end,
-        read_len);
+    return true;
   }
 
-  auto hash = HashTools::hash(StrBlob(p, len), 0);
+  // Mach-O (32 & 64 bits, either byte order), then a relocatable (MH_OBJECT) type
+  if (size >= 28)
+  {
+    const uint32_t magic = read_u32(0, true);
+    const bool little_endian = magic == 0xFEEDFACE || magic == 0xFEEDFACF;
+    const bool big_endian = magic == 0xCEFAEDFE || magic == 0xCFFAEDFE;
+    if (little_endian || big_endian)
+    {
+      return read_u32(12, little_endian) == 1;
+    }
+  }
 
-  delete[] p;
+  // COFF: a known machine, or the anonymous header of big & lto objects
+  if (size >= 20)
+  {
+    switch (read_u16(0, true))
+    {
+    case 0x014C: // i386
+    case 0x8664: // amd64
+    case 0x01C4: // armnt
+    case 0xAA64: // arm64
+      return true;
+    case 0x0000:
+      return read_u16(2, true) == 0xFFFF;
+    default:
+      break;
+    }
+  }
 
-  return hash;
+  return false;
 }
 
 void build_tools::DeleteUnusedObjFiles(const std::set<FilePath> &object_files,
@@ -285,19 +354,11 @@ void build_tools::DeleteUnusedObjFiles(const std::set<FilePath> &object_files,
 
 std::vector<int> build_tools::Execute(
     const Blob<const BuildCommandInfo> &params) {
-
-  std::vector<std::string> joined_commands{};
-  joined_commands.resize(params.size());
-
-  GenerateJoinArgs(params, joined_commands.data());
-
   vector<int> results{};
   results.resize(params.size());
 
   const errno_t error =
-      _Execute_Inner({ joined_commands.data(), joined_commands.size() },
-                     params,
-                     { results.data(), results.size() });
+      _Execute_Inner(params, { results.data(), results.size() });
 
   EXECUTE_CHECK_ERR();
 
@@ -306,42 +367,40 @@ std::vector<int> build_tools::Execute(
 
 std::vector<int> build_tools::Execute_Multithreaded(
     const Blob<const BuildCommandInfo> &params,
-    uint32_t batches) {
-
-  std::vector<std::string> joined_commands{};
-  joined_commands.resize(params.size());
-
-  GenerateJoinArgs(params, joined_commands.data());
-
+    JobPool &pool) {
   vector<int> results{};
   results.resize(params.size());
 
   const errno_t error =
-      _ExecuteParallel_Inner({ joined_commands.data(), joined_commands.size() },
-                             params,
-                             { results.data(), results.size() },
-                             batches);
+      _ExecuteParallel_Inner(params, { results.data(), results.size() }, pool);
 
   EXECUTE_CHECK_ERR();
 
   return results;
 }
 
-errno_t build_tools::_Execute_Inner(const Blob<const std::string> &args,
-                                    const Blob<const BuildCommandInfo> &params,
+errno_t build_tools::_Execute_Inner(const Blob<const BuildCommandInfo> &params,
                                     Blob<int> results) {
-  for (size_t i = 0; i < args.length; i++)
+  const unsigned long timeout_ms = GetProcessTimeoutMs();
+
+  for (size_t i = 0; i < params.length; i++)
   {
     const auto &param = params[i];
-    Process process{ args[i] };
+    Process process{ param.args };
     process.set_name(param.name.c_str());
+    process.set_wait_time_ms(HAS_FLAG(param.flags, eExcFlag_Timeout) ? timeout_ms : 0);
 
     if (HAS_FLAG(param.flags, eExcFlag_Printout))
     {
       Logger::notify("executing '%s'...", param.name.c_str());
     }
 
-    results[i] = process.start(param.out);
+    results[i] = process.start(param.out, param.usage);
+
+    if (param.digest != nullptr && results[i] == EOK)
+    {
+      DigestCommandOutput(param);
+    }
 
     if (HAS_FLAG(param.flags, eExcFlag_Printout))
     {
@@ -349,7 +408,7 @@ errno_t build_tools::_Execute_Inner(const Blob<const std::string> &args,
                      param.name.c_str(),
                      results[i],
                      i,
-                     args.length);
+                     params.length);
     }
   }
 
@@ -357,28 +416,31 @@ errno_t build_tools::_Execute_Inner(const Blob<const std::string> &args,
 }
 
 errno_t build_tools::_ExecuteParallel_Inner(
-    const Blob<const std::string> &args,
     const Blob<const BuildCommandInfo> &params,
     Blob<int> results,
-    uint32_t batches) {
-  std::atomic_size_t progress_index = 0;
-  const auto func = [&args, &params, &progress_index](size_t index) {
-    const auto &param = params[index];
-    Process process{ args[index] };
+    JobPool &pool) {
+  const unsigned long timeout_ms = GetProcessTimeoutMs();
+
+  const auto make_process = [&params, timeout_ms](size_t index) {
+    Process process{ params[index].args };
 
 #ifdef __linux__
     process.add_flags(Process::Flag_InheritEnv);
 #endif
-    process.set_name(param.name.c_str());
+    process.set_name(params[index].name.c_str());
+    process.set_wait_time_ms(HAS_FLAG(params[index].flags, eExcFlag_Timeout) ? timeout_ms : 0);
 
-    Logger::verbose("processing parallel: '%s'", args[index].c_str());
-
-    if (HAS_FLAG(param.flags, eExcFlag_Printout))
+    if (Logger::is_verbose())
     {
-      Logger::notify("executing '%s'...", param.name.c_str());
+      Logger::verbose("processing parallel: '%s'",
+                      JoinArguments(params[index].args).c_str());
     }
+    return process;
+  };
 
-    const int result = process.start(param.out);
+  size_t progress_index = 0;
+  const auto report = [&params, &progress_index](size_t index, int result) {
+    const auto &param = params[index];
     progress_index++;
 
     if (HAS_FLAG(param.flags, eExcFlag_Printout))
@@ -388,20 +450,72 @@ errno_t build_tools::_ExecuteParallel_Inner(
                param.name.c_str(),
                GetErrorName(result),
                result,
-               (size_t)progress_index,
-               args.length);
+               progress_index,
+               params.length);
     }
-
-    return result;
   };
 
-  const auto exporter = [&results](size_t index, int result) {
-    results[index] = result;
+#ifdef __linux__
+  // one event loop supervises every compiler, draining their outputs as they
+  // come, instead of a blocked thread per running compiler
+  ProcessReactor reactor{
+    pool.get_workers_count(),
+    (size_t)Settings::Get("process_pipe_buffer_sz",
+                          (FieldVar::Int)ProcessReactor::DefaultPipeBufferSize)
+        .get_int()
   };
 
-  ThreadBatcher batcher = { batches, func, exporter };
+  for (size_t index = 0; index < params.length; index++)
+  {
+    reactor.submit(make_process(index),
+                   params[index].out,
+                   params[index].usage,
+                   [&params, &results, &report, &pool, index](int result) {
+                     results[index] = result;
+                     report(index, result);
+
+                     // the idle workers hash the objects while the other compiles run
+                     if (params[index].digest != nullptr && result == EOK)
+                     {
+                       pool.submit([&param = params[index]]() { DigestCommandOutput(param); });
+                     }
+                   },
+                   [&params, index]() {
+                     if (HAS_FLAG(params[index].flags, eExcFlag_Printout))
+                     {
+                       Logger::notify("executing '%s'...", params[index].name.c_str());
+                     }
+                   });
+  }
+
+  // submission order is the dispatch order
+  reactor.run();
+  pool.wait();
+#else
+  std::mutex report_mutex;
+
+  // jobs are pulled by idle workers in order, so a few heavy TUs don't hold a
+  // pre-assigned range of jobs hostage
+  pool.run(params.length, [&](size_t index) {
+    const auto &param = params[index];
+    Process process = make_process(index);
+
+    if (HAS_FLAG(param.flags, eExcFlag_Printout))
+    {
+      Logger::notify("executing '%s'...", param.name.c_str());
+    }
+
+    results[index] = process.start(param.out, param.usage);
+
+    if (param.digest != nullptr && results[index] == EOK)
+    {
+      DigestCommandOutput(param);
+    }
 
-  batcher.run(args.length);
+    std::scoped_lock<std::mutex> lock{ report_mutex };
+    report(index, results[index]);
+  });
+#endif
 
   return errno_t();
 }
@@ -421,7 +535,7 @@ SourceFileType build_tools::GetDominantSourceType(
   return dominate_type;
 }
 
-bool build_tools::IsAllowedForClangdFlags(const std::string &str) {
+bool build_tools::IsAllowedForClangdFlags(const std::string_view str) {
   if (str == "-Wfatal-errors")
   {
     return false;
@@ -435,7 +549,7 @@ bool build_tools::IsAllowedForClangdFlags(const std::string &str) {
   return true;
 }
 
-bool build_tools::IsAllowedForClangdCommands(const std::string &str) {
+bool build_tools::IsAllowedForClangdCommands(const std::string_view str) {
   if (str == "-Wfatal-errors")
   {
     return false;
@@ -454,11 +568,11 @@ void build_tools::TryCreateClangdCompileFlagsFile(
     return;
   }
 
-  vector<string> flags{};
+  ArgumentList flags{};
   config.build_clangd_contents(flags);
 
   auto file = compile_flags_file.stream_write(false);
-  for (const string &s : flags)
+  for (const std::string_view s : flags)
   {
     if (!IsAllowedForClangdFlags(s))
     {
@@ -572,9 +686,8 @@ SourceFileType build_tools::GetFileTypeFromTypeName(
   return DefaultSourceFileTypeForExtension(file_type_name);  // yeah...
 }
 
-void build_tools::DumpDependencyMap(
-    const SourceProcessor::dependency_info_map &map,
-    const FilePath &output_dir) {
+void build_tools::DumpDependencyMap(const DependencyGraph &graph,
+                                    const FilePath &output_dir) {
   const FilePath output_path = output_dir.join_path("dependency.txt");
 
   std::ofstream stream = output_path.stream_write(false);
@@ -584,16 +697,12 @@ void build_tools::DumpDependencyMap(
   WriteAutoGeneratedHeader(stream);
   stream << "# below is the dependency map of the entire project\n";
 
-  // We can do it by converting 'map' to field var and save it
-  // sadly, im too lazy rn
-
-  for (const auto &[name, deps] : map)
+  for (DependencyGraph::file_id id = 0; id < graph.size(); id++)
   {
-    stream << name << ":\n[\n";
-    for (const auto &dep_name : deps.sub_dependencies)
+    stream << '"' << graph.get_path(id) << "\":\n[\n";
+    for (const DependencyGraph::file_id dependency : graph.get_dependencies(id))
     {
-      stream << "  \"" << dep_name << "\", # "
-             << FilePath(dep_name).resolved_copy(name.parent()) << "\n";
+      stream << "  \"" << graph.get_path(dependency) << "\",\n";
     }
     stream << "]\n\n";
   }
@@ -636,19 +745,18 @@ bool DoesSourceTypeDominate(SourceFileType type, SourceFileType target) {
   return false;
 }
 
-void GenerateJoinArgs(const Blob<const BuildCommandInfo> &params,
-                      std::string *results) {
-
-  for (size_t i = 0; i < params.size(); i++)
-  {
-    std::ostringstream oss;
+unsigned long GetProcessTimeoutMs() {
+  // zero (the default) for no timeout
+  const int64_t timeout_sec =
+      Settings::Get("build_process_timeout_sec", (FieldVar::Int)0).get_int();
+  return (unsigned long)std::max<int64_t>(timeout_sec, 0) * 1000;
+}
 
-    for (const string &str : params[i].args)
-    {
-      oss << str << ' ';
-    }
+void DigestCommandOutput(const BuildCommandInfo &param) {
+  DigestOutput(param.out_path, *param.digest);
 
-    results[i] = oss.str();
-    results[i].pop_back();
+  if (param.on_digested != nullptr)
+  {
+    (*param.on_digested)(param);
   }
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <set>
 #include <vector>
 
@@ -10,23 +11,49 @@
 #include "code/SourceProcessor.hpp"
 #include "code/SourceTools.hpp"
 #include "misc/hash128.hpp"
+#include "utility/ArgumentList.hpp"
+#include "utility/Process.hpp"
+
+class JobPool;
 
 namespace build_tools
 {
   enum _ExecuteFlags : uint8_t {
     eExcFlag_Printout = 0x01,
     eExcFlag_PrintoutProgress = 0x02,
+    // killed past `build_process_timeout_sec` (when set), only compiles have it
+    eExcFlag_Timeout = 0x04,
   };
 
   typedef std::underlying_type_t<_ExecuteFlags> ExecuteFlags;
 
+  // enough of an object file's start to tell it's format & type
+  static constexpr size_t ObjectHeaderSize = 64;
+
+  // what's recorded of a written object to verify it without reading it again
+  struct OutputDigest
+  {
+    // taken before the hash, so a write racing the read changes it
+    FileSignature signature = {};
+    // zero if the output can't be read
+    hash_t hash = 0;
+  };
+
   struct BuildCommandInfo
   {
     ExecuteFlags flags = eExcFlag_Printout;
     std::ostream *out;
+    // if not null, receives the process's wall/cpu times
+    ProcessUsage *usage = nullptr;
+    // if not null, receives `out_path`'s digest when the process succeeds, taken right
+    // after it exits (on a worker thread when executed in parallel)
+    OutputDigest *digest = nullptr;
+    // if not null, called right after `digest` is taken (on the same thread), so a finished
+    // compile is recorded before the others finish
+    const std::function<void(const BuildCommandInfo &)> *on_digested = nullptr;
     StaticString<128> name;
     bool critical = false;
-    std::vector<string> args;
+    ArgumentList args;
     FilePath in_path;
     FilePath out_path;
   };
@@ -55,31 +82,42 @@ namespace build_tools
                           const Project &proj,
                           const BuildConfiguration *config);
 
+  // the project's hash without it's configurations, each has it's own cache (hashed with
+  // `GetConfigHash`) so editing one doesn't invalidate the others
+  extern hash_t GetProjectHash(const Project &project);
+  // the configuration's hash, including the fingerprints of it's compilers
+  extern hash_t GetConfigHash(const BuildConfiguration &config);
+
   extern hash_t GetFileHash(const char *path);
 
+  // stats then hashes `path`
+  extern void DigestOutput(const FilePath &path, OutputDigest &digest);
+
+  // checks the start of an object file (ELF, Mach-O, COFF or LLVM bitcode) for a known
+  // format & the relocatable type, catches truncated or clobbered objects
+  extern bool IsObjectHeaderSane(const StrBlob &header);
+
   extern void DeleteUnusedObjFiles(const std::set<FilePath> &object_files,
                                    const std::set<FilePath> &used_files);
 
   extern std::vector<int> Execute(const Blob<const BuildCommandInfo> &params);
   extern std::vector<int> Execute_Multithreaded(
       const Blob<const BuildCommandInfo> &params,
-      uint32_t batches);
+      JobPool &pool);
 
-  extern errno_t _Execute_Inner(const Blob<const std::string> &args,
-                                const Blob<const BuildCommandInfo> &params,
+  extern errno_t _Execute_Inner(const Blob<const BuildCommandInfo> &params,
                                 Blob<int> results);
 
   extern errno_t _ExecuteParallel_Inner(
-      const Blob<const std::string> &args,
       const Blob<const BuildCommandInfo> &params,
       Blob<int> results,
-      uint32_t batches);
+      JobPool &pool);
 
   extern SourceFileType GetDominantSourceType(
       Blob<const SourceFileType> file_types);
 
-  extern bool IsAllowedForClangdFlags(const std::string &str);
-  extern bool IsAllowedForClangdCommands(const std::string &str);
+  extern bool IsAllowedForClangdFlags(std::string_view str);
+  extern bool IsAllowedForClangdCommands(std::string_view str);
 
   extern void TryCreateClangdCompileFlagsFile(const BuildConfiguration &config,
                                               const FilePath &build_folder);
@@ -111,45 +149,35 @@ namespace build_tools
         FilePath::string_blob{ str.c_str(), str.length() });
   }
 
-  extern void DumpDependencyMap(const SourceProcessor::dependency_info_map &map,
+  extern void DumpDependencyMap(const DependencyGraph &graph,
                                 const FilePath &output_path);
 
+  // joins `args` into a single command line (quoting where needed), skipping the
+  // arguments not passing `pred`
   template <typename PRED>
-  static inline string JoinArguments(const std::string *args,
-                                     size_t count,
-                                     PRED &&pred) {
-    std::ostringstream oss;
+  static inline string JoinArguments(const ArgumentList &args, PRED &&pred) {
+    string result;
+    result.reserve(args.get_chars_count());
 
-    for (size_t i = 0; i < count; i++)
+    for (const std::string_view arg : args)
     {
-      if (!pred(args[i]))
+      if (!pred(arg))
       {
         continue;
       }
 
-      bool need_enclosure =
-          string_tools::all_of(args[i].c_str(),
-                               [](char value) { return !isgraph(value); });
-
-      if (need_enclosure)
-      {
-        oss << '"' << args[i] << '"';
-      }
-      else
+      if (!result.empty())
       {
-        oss << args[i];
+        result.push_back(' ');
       }
 
-      oss << ' ';
+      ArgumentList::AppendQuoted(result, arg);
     }
 
-    return oss.str();
+    return result;
   }
 
-  static inline string JoinArguments(const std::string *args, size_t count) {
-    return JoinArguments(args, count, [](const std::string &s) {
-      (void)s;
-      return true;
-    });
+  static inline string JoinArguments(const ArgumentList &args) {
+    return args.join();
   }
 }
@@ -0,0 +1,385 @@
+#include "CacheBundle.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+
+#include "BuildCacheFile.hpp"
+#include "HashTools.hpp"
+#include "Logger.hpp"
+#include "utility/AtomicFile.hpp"
+
+namespace fs = std::filesystem;
+
+struct BundleHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  int64_t hash_algorithm;
+  hash_t project_hash;
+  hash_t config_hash;
+  hash_t c_compiler_fingerprint;
+  hash_t cpp_compiler_fingerprint;
+};
+
+// precedes every file's path & content, an entry with an empty path ends the bundle
+struct BundleEntryHeader
+{
+  uint64_t size;
+  uint32_t path_size;
+  uint32_t reserved;
+  // of the content
+  hash_t checksum;
+};
+
+static constexpr char TemporaryExtension[] = ".tmp";
+// the replaced directory's name while an import swaps it
+static constexpr char OldExtension[] = ".old";
+static constexpr size_t CopyChunkSize = 1 << 16;
+// an export never writes longer paths, a bundle with one is broken
+static constexpr uint32_t MaxPathSize = 4096;
+
+// the files under `directory` ('/' separated, relative to it), the build caches last
+static vector<string> ListBundledFiles(const string &directory);
+// relative & without '.' or '..' components, an import never writes outside it's directory
+static bool IsSafeRelativePath(std::string_view path);
+static bool ReadFileContent(const string &path, string &content);
+// streams the bundle's entries (after it's header) into `directory_str`, until the end marker
+static ErrorReport UnpackEntries(std::ifstream &in,
+                                 uint64_t bundle_size,
+                                 const string &directory_str,
+                                 size_t &files_count);
+// renames `staging_directory` to `base_str` (without a trailing separator), over the old one
+static ErrorReport SwapDirectory(const FilePath &staging_directory, const string &base_str);
+static string GetDirectoryString(const FilePath &directory);
+
+ErrorReport CacheBundle::Export(const FilePath &path,
+                                const FilePath &directory,
+                                const Fingerprints &fingerprints,
+                                size_t &files_count) {
+  files_count = 0;
+
+  const string directory_str = GetDirectoryString(directory);
+  const vector<string> files = ListBundledFiles(directory_str);
+
+  // renamed into place, an interrupted export never leaves a bundle that looks whole
+  const FilePath temporary_path = AtomicFile::GetTemporaryPath(path);
+  std::ofstream out{ temporary_path.to_std_path(), std::ios::binary | std::ios::trunc };
+  if (!out)
+  {
+    return { Error::Failure, format_join("can't write the cache bundle to '", path.c_str(), "'") };
+  }
+
+  BundleHeader header{};
+  memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.byte_order = BuildCacheFile::ByteOrderMark;
+  header.hash_algorithm = HashTools::Algorithm;
+  header.project_hash = fingerprints.project_hash;
+  header.config_hash = fingerprints.config_hash;
+  header.c_compiler_fingerprint = fingerprints.c_compiler_fingerprint;
+  header.cpp_compiler_fingerprint = fingerprints.cpp_compiler_fingerprint;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  string content{};
+  for (const string &file : files)
+  {
+    if (!ReadFileContent(directory_str + file, content))
+    {
+      out.close();
+      temporary_path.remove();
+      return { Error::Failure, format_join("can't read '", directory_str, file, "'") };
+    }
+
+    BundleEntryHeader entry{};
+    entry.size = content.size();
+    entry.path_size = uint32_t(file.size());
+    entry.checksum = HashTools::hash(StrBlob{ content.data(), content.size() });
+
+    out.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    out.write(file.data(), std::streamsize(file.size()));
+    out.write(content.data(), std::streamsize(content.size()));
+    files_count++;
+  }
+
+  const BundleEntryHeader end_marker{};
+  out.write(reinterpret_cast<const char *>(&end_marker), sizeof(end_marker));
+  out.close();
+
+  if (!out || !AtomicFile::Replace(temporary_path, path))
+  {
+    temporary_path.remove();
+    return { Error::Failure, format_join("can't write the cache bundle to '", path.c_str(), "'") };
+  }
+
+  return {};
+}
+
+ErrorReport CacheBundle::Import(const FilePath &path,
+                                const FilePath &directory,
+                                const Fingerprints &fingerprints,
+                                size_t &files_count) {
+  files_count = 0;
+
+  std::error_code err_code{};
+  const uint64_t bundle_size = fs::file_size(path.to_std_path(), err_code);
+  std::ifstream in{ path.to_std_path(), std::ios::binary };
+  if (err_code || !in)
+  {
+    return { Error::FileNotFound, format_join("no cache bundle at '", path.c_str(), "'") };
+  }
+
+  BundleHeader header{};
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!in || memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+  {
+    return { Error::InvalidType, format_join("'", path.c_str(), "' is not a cache bundle") };
+  }
+
+  if (header.version != Version || header.byte_order != BuildCacheFile::ByteOrderMark ||
+      header.hash_algorithm != HashTools::Algorithm)
+  {
+    return { Error::InvalidType,
+             "the cache bundle was written by another version of bgnu (or on another kind of "
+             "machine)" };
+  }
+
+  // the compilers are folded into the configuration's hash, they're compared first for a
+  // clearer message
+  if (header.project_hash != fingerprints.project_hash)
+  {
+    return { Error::Failure, "the cache bundle was made for another project (or output)" };
+  }
+
+  if (header.c_compiler_fingerprint != fingerprints.c_compiler_fingerprint ||
+      header.cpp_compiler_fingerprint != fingerprints.cpp_compiler_fingerprint)
+  {
+    return { Error::Failure, "the cache bundle was made with another toolchain" };
+  }
+
+  if (header.config_hash != fingerprints.config_hash)
+  {
+    return { Error::Failure, "the cache bundle was made with another build configuration" };
+  }
+
+  // the bundle replaces the old state as a whole, it's unpacked next to it and swapped in once
+  // it's whole, a broken (or truncated) bundle leaves the old state as it was
+  const string directory_str = GetDirectoryString(directory);
+  const string base_str = directory_str.substr(0, directory_str.size() - 1);
+  const FilePath staging_directory{ AtomicFile::GetTemporaryPath(FilePath(base_str)).c_str() +
+                                    string(1, FilePath::DirectorySeparator) };
+  staging_directory.remove_recursive();
+  staging_directory.create_directory();
+
+  ErrorReport err = UnpackEntries(in, bundle_size, GetDirectoryString(staging_directory),
+                                  files_count);
+  if (!err)
+  {
+    err = SwapDirectory(staging_directory, base_str);
+  }
+
+  if (err)
+  {
+    files_count = 0;
+    staging_directory.remove_recursive();
+  }
+
+  return err;
+}
+
+inline ErrorReport UnpackEntries(std::ifstream &in,
+                                 uint64_t bundle_size,
+                                 const string &directory_str,
+                                 size_t &files_count) {
+  string file{};
+  vector<char> buffer{};
+  buffer.resize(CopyChunkSize);
+  HashStream checksum{};
+  while (true)
+  {
+    BundleEntryHeader entry{};
+    in.read(reinterpret_cast<char *>(&entry), sizeof(entry));
+    if (!in)
+    {
+      return { Error::Failure, "the cache bundle is truncated" };
+    }
+
+    // the end marker
+    if (entry.path_size == 0)
+    {
+      return {};
+    }
+
+    const uint64_t position = uint64_t(in.tellg());
+    if (entry.path_size > MaxPathSize || position > bundle_size ||
+        entry.path_size > bundle_size - position ||
+        entry.size > bundle_size - position - entry.path_size)
+    {
+      return { Error::Failure, "the cache bundle is truncated or broken" };
+    }
+
+    file.resize(entry.path_size);
+    in.read(file.data(), std::streamsize(file.size()));
+    if (!in)
+    {
+      return { Error::Failure, "the cache bundle is truncated" };
+    }
+
+    if (!IsSafeRelativePath(file))
+    {
+      return { Error::Failure,
+               format_join("the cache bundle has a file outside it's directory ('", file, "')") };
+    }
+
+    const FilePath output_path{ directory_str + file };
+    output_path.parent().create_directory();
+    std::ofstream out{ output_path.to_std_path(), std::ios::binary | std::ios::trunc };
+    if (!out)
+    {
+      return { Error::Failure, format_join("can't write '", output_path.c_str(), "'") };
+    }
+
+    // copied in chunks, the objects can be large
+    checksum.reset();
+    uint64_t remaining = entry.size;
+    while (remaining != 0)
+    {
+      const size_t chunk_size = size_t(std::min<uint64_t>(remaining, buffer.size()));
+      in.read(buffer.data(), std::streamsize(chunk_size));
+      if (!in)
+      {
+        return { Error::Failure, "the cache bundle is truncated" };
+      }
+
+      checksum.update(StrBlob{ buffer.data(), chunk_size });
+      out.write(buffer.data(), std::streamsize(chunk_size));
+      remaining -= chunk_size;
+    }
+
+    out.close();
+    if (!out)
+    {
+      return { Error::Failure, format_join("can't write '", output_path.c_str(), "'") };
+    }
+
+    if (checksum.digest() != entry.checksum)
+    {
+      return { Error::Failure, format_join("the cache bundle's '", file, "' is corrupted") };
+    }
+
+    files_count++;
+  }
+}
+
+inline ErrorReport SwapDirectory(const FilePath &staging_directory, const string &base_str) {
+  // moved aside first, a directory can't be renamed over a non empty one
+  const fs::path directory_path = FilePath(base_str).to_std_path();
+  const fs::path old_path = FilePath(base_str + OldExtension).to_std_path();
+
+  std::error_code err_code{};
+  fs::remove_all(old_path, err_code);
+  err_code.clear();
+
+  const bool had_directory = fs::exists(directory_path, err_code);
+  if (had_directory)
+  {
+    fs::rename(directory_path, old_path, err_code);
+    if (err_code)
+    {
+      return { Error::Failure, format_join("can't replace '", base_str, "'") };
+    }
+  }
+
+  fs::rename(staging_directory.to_std_path(), directory_path, err_code);
+  if (err_code)
+  {
+    if (had_directory)
+    {
+      std::error_code restore_err_code{};
+      fs::rename(old_path, directory_path, restore_err_code);
+    }
+
+    return { Error::Failure, format_join("can't replace '", base_str, "'") };
+  }
+
+  fs::remove_all(old_path, err_code);
+  return {};
+}
+
+inline vector<string> ListBundledFiles(const string &directory) {
+  vector<string> files{};
+
+  std::error_code err_code{};
+  for (const auto &entry : fs::recursive_directory_iterator(directory, err_code))
+  {
+    if (!entry.is_regular_file(err_code))
+    {
+      continue;
+    }
+
+    const string path = entry.path().generic_string();
+    // the temporary files are left by interrupted writes
+    if (!path.starts_with(directory) || path.ends_with(TemporaryExtension))
+    {
+      continue;
+    }
+
+    files.push_back(path.substr(directory.size()));
+  }
+
+  // the build caches are named with a leading '.', the rest is sorted for a stable bundle
+  std::sort(files.begin(), files.end(), [](const string &left, const string &right) {
+    return std::make_tuple(left.starts_with('.'), std::string_view(left)) <
+           std::make_tuple(right.starts_with('.'), std::string_view(right));
+  });
+
+  return files;
+}
+
+inline bool IsSafeRelativePath(std::string_view path) {
+  if (path.empty() || path.front() == '/' || path.find_first_of("\\:") != path.npos)
+  {
+    return false;
+  }
+
+  size_t start = 0;
+  while (start <= path.size())
+  {
+    const size_t end = std::min(path.find('/', start), path.size());
+    const std::string_view component = path.substr(start, end - start);
+    if (component.empty() || component == "." || component == "..")
+    {
+      return false;
+    }
+
+    start = end + 1;
+  }
+
+  return true;
+}
+
+inline bool ReadFileContent(const string &path, string &content) {
+  std::ifstream in{ path, std::ios::binary | std::ios::ate };
+  if (!in)
+  {
+    return false;
+  }
+
+  content.resize(size_t(in.tellg()));
+  in.seekg(0);
+  in.read(content.data(), std::streamsize(content.size()));
+  return bool(in);
+}
+
+inline string GetDirectoryString(const FilePath &directory) {
+  string str = directory.c_str();
+  if (!str.empty() && str.back() != FilePath::DirectorySeparator)
+  {
+    str += FilePath::DirectorySeparator;
+  }
+
+  return str;
+}
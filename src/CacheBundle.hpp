@@ -0,0 +1,46 @@
+#pragma once
+#include "FilePath.hpp"
+#include "base.hpp"
+#include "misc/Error.hpp"
+#include "misc/hash128.hpp"
+
+// a configuration's build cache & objects packed in one file, restores a build's state in
+// another checkout (a fresh CI workspace) with a single copy
+//
+// the bundle is a header (the fingerprints of what made the cache) followed by the files of
+// the configuration's cache directory, each with it's relative path & checksum, & an end
+// marker (so a truncated bundle is told apart), it's written & read in one pass, an import
+// writes every file in place as soon as it's read & verified
+class CacheBundle
+{
+public:
+  static constexpr char Magic[8] = { 'B', 'G', 'N', 'U', 'P', 'A', 'C', 'K' };
+  static constexpr uint32_t Version = 1;
+
+  // what the bundled cache was built with, an import into a build with others is rejected
+  struct Fingerprints
+  {
+    hash_t project_hash = 0;
+    // the configuration & the compilers' fingerprints, see `build_tools::GetConfigHash`
+    hash_t config_hash = 0;
+    hash_t c_compiler_fingerprint = 0;
+    hash_t cpp_compiler_fingerprint = 0;
+  };
+
+  CacheBundle() = delete;
+
+  // packs the files under `directory` into `path` (replaced as a whole), the build caches
+  // (the names starting with a '.') after the objects, so an import cut short never has a
+  // cache without it's objects, returns the packed files count in `files_count`
+  static ErrorReport Export(const FilePath &path,
+                            const FilePath &directory,
+                            const Fingerprints &fingerprints,
+                            size_t &files_count);
+
+  // replaces the files under `directory` with the bundle's, nothing is touched if the
+  // bundle isn't made with `fingerprints`, returns the unpacked files count in `files_count`
+  static ErrorReport Import(const FilePath &path,
+                            const FilePath &directory,
+                            const Fingerprints &fingerprints,
+                            size_t &files_count);
+};
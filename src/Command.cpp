@@ -5,6 +5,7 @@
 #include "Logger.hpp"
 #include "StringTools.hpp"
 #include "commands/BuildCommand.hpp"
+#include "commands/CacheCommand.hpp"
 #include "commands/HelpCommand.hpp"
 #include "commands/MapCommand.hpp"
 #include "commands/NewCommand.hpp"
@@ -68,6 +69,7 @@ void CommandDB::_load_commands() {
   _add_command(std::make_unique<commands::NewCommand>());
   _add_command(std::make_unique<commands::RunCommand>());
   _add_command(std::make_unique<commands::MapCommand>());
+  _add_command(std::make_unique<commands::CacheCommand>());
 }
 
 void CommandDB::_add_command(command_ptr &&command) {
@@ -4,9 +4,10 @@
 
 #include <fstream>
 
-#include "FileTools.hpp"
 #include "Logger.hpp"
 #include "misc/StringCursor.hpp"
+#include "utility/AtomicFile.hpp"
+#include "utility/MappedFile.hpp"
 
 constexpr uint32_t FieldFileVersion = 0x01'01;
 
@@ -119,7 +120,7 @@ public:
   static constexpr char CommentChar = '#';
 
   inline Tokenizer(const char *p_source, size_t p_length)
-      : m_source{ p_source }, m_length{ p_length } {}
+      : m_source{ p_source }, m_length{ p_length }, m_cursor{ _copy_source(p_source, p_length) } {}
 
   inline Token get_next();
 
@@ -152,7 +153,19 @@ public:
   size_t line_start = 0;
 
 private:
-  inline string_cursor _get_current_str() const { return { m_source, index }; }
+  // the source might not be NUL terminated (a mapped file), it's copied by it's length & the
+  // copy is terminated (the tokens' values are parsed from it)
+  static inline string_cursor _copy_source(const char *source, size_t length) {
+    string_cursor cursor{ length };
+    if (length != 0)
+    {
+      memcpy(cursor.data(), source, length);
+    }
+    return cursor;
+  }
+
+  // shares the source copy, instead of copying the source for every token
+  inline string_cursor _get_current_str() const { return m_cursor.slice(index); }
 
   template <typename Pred>
   inline size_t _get_length(Pred &&pred) const {
@@ -180,6 +193,7 @@ private:
 private:
   const char *const m_source;
   const size_t m_length;
+  const string_cursor m_cursor;
 };
 
 inline Token Tokenizer::get_next() {
@@ -947,10 +961,8 @@ void FieldFileWriter::write(const FieldVar &data) {
 #pragma endregion
 
 FieldVar FieldFile::load(const FilePath &filepath) {
-  const string text = FileTools::read_str(filepath);
-  // std::cout << "\n\n[[[\n" << text << "\n]]]" << text.size() << "\n\n";
-
-  return read(text.c_str(), text.length());
+  const MappedFile file{ filepath };
+  return read(file.data(), file.size());
 }
 
 FieldVar FieldFile::read(const string_char *source, size_t length) {
@@ -966,11 +978,24 @@ FieldVar FieldFile::read(const string_char *source, size_t length) {
 }
 
 void FieldFile::dump(const FilePath &filepath, const FieldVar::Dict &data) {
-  string source = write(data);
+  const string source = write(data);
 
-  std::ofstream out{ filepath };
+  // an unchanged file isn't written, it's (& it's directory's) write time stays for the build
+  // manifest
+  {
+    const MappedFile file{ filepath };
+    if (file.is_open() && file.size() == source.size() &&
+        (source.empty() || memcmp(file.data(), source.data(), source.size()) == 0))
+    {
+      return;
+    }
+  }
 
-  out << source;
+  // replaced as a whole, a concurrent reader never sees a partial file
+  if (!AtomicFile::Write(filepath, StrBlob{ source.data(), source.size() }))
+  {
+    Logger::error("can't write '%s'", filepath.c_str());
+  }
 }
 
 string FieldFile::write(const FieldVar::Dict &data) {
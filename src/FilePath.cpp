@@ -109,7 +109,8 @@ bool FilePath::operator<(const FilePath &other) const {
 
     return true;
   }
-  return false;
+  // a path goes before the paths it prefixes
+  return m_text.size() < other.m_text.size();
 }
 
 bool FilePath::operator==(const FilePath &other) const {
@@ -6,8 +6,6 @@
 
 namespace FileTools
 {
-  // 128 MEGABYTES
-  static constexpr std::streamsize MaxReadSize = 0x8000000;
   typedef std::ios::openmode openmode;
 
   enum class FileKind : uint8_t {
@@ -62,15 +60,17 @@ namespace FileTools
     const auto end = input.tellg();
     input.seekg(0, std::ios::beg);
 
+    // the whole file, however big
     const std::streampos kind_offset = (kind == FileKind::Binary) ? 0 : 1;
-    const std::streamsize size = std::min(MaxReadSize, end - begin);
+    const std::streamsize size = end - begin;
 
     Buffer buffer{ size_t((size + kind_offset) * _get_unit_size(kind)) };
-    memset(buffer, 0, buffer.size());
 
-    input.read(reinterpret_cast<decltype(input)::char_type *>(buffer.get()),
-               buffer.size() - kind_offset  // to keep null termination
-    );
+    input.read(reinterpret_cast<decltype(input)::char_type *>(buffer.get()), size);
+
+    // null terminated text, zeroed past what was read
+    const size_t read_size = size_t(input.gcount());
+    memset(static_cast<char *>(buffer.get()) + read_size, 0, buffer.size() - read_size);
     return buffer;
   }
 
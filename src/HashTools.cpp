@@ -0,0 +1,437 @@
+#include "HashTools.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HASH_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HASH_SSE2 1
+#endif
+
+static constexpr uint64_t Prime32_1 = 0x9E3779B1ULL;
+static constexpr uint64_t Prime32_2 = 0x85EBCA77ULL;
+static constexpr uint64_t Prime32_3 = 0xC2B2AE3DULL;
+static constexpr uint64_t Prime64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t Prime64_3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t Prime64_5 = 0x27D4EB2F165667C5ULL;
+
+static constexpr uint64_t InitialLanes[HashStream::LaneCount] = {
+  Prime32_3, Prime64_1, Prime64_2, Prime64_3, Prime64_4, Prime32_2, Prime64_5, Prime32_1,
+};
+
+// the keys (word offsets) the last stripe & the digests are mixed with
+static constexpr size_t LastStripeKey = 7;
+static constexpr size_t LowDigestKey = 1;
+static constexpr size_t HighDigestKey = 11;
+
+// the keys (byte offsets into `CipherTable`) the short contents are mixed with, the
+// 16 byte chunks of a content each have their own key
+static constexpr size_t LowShortKey = 0;
+static constexpr size_t HighShortKey = 19;
+static constexpr size_t ShortChunkKeyStride = 11;
+
+static inline uint64_t Read64(const uint8_t *p);
+static inline uint32_t Read32(const uint8_t *p);
+static inline uint64_t ReadShortKey(size_t offset);
+
+// the 128-bit product of `left` & `right`, it's halves xor-ed
+static inline uint64_t Multiply128Fold(uint64_t left, uint64_t right);
+static inline uint64_t Avalanche(uint64_t hash);
+
+static inline void SeedKeys(uint64_t *keys, hash_t seed);
+
+// mixes `count` stripes into the lanes, stripe `i` with the keys at `keys + i`
+static inline void AccumulateStripes(uint64_t *lanes, const uint8_t *stripes, size_t count,
+                                     const uint64_t *keys);
+static inline void ScrambleLanes(uint64_t *lanes, const uint64_t *keys);
+// `stripe` is the stripe of the current block, the lanes are scrambled at each block's end
+static inline void ConsumeStripes(uint64_t *lanes, size_t &stripe, const uint8_t *stripes,
+                                  size_t count, const uint64_t *keys);
+// mixes the last bytes (1 to `HashStream::BufferSize`) of a content, the last stripe zero padded
+static inline void FinishLanes(uint64_t *lanes, size_t stripe, const uint8_t *data, size_t length,
+                               const uint64_t *keys);
+static inline hash_t MergeLanes(const uint64_t *lanes, const uint64_t *keys, uint64_t start);
+
+static inline hash_t HashShort(const uint8_t *data, size_t length, hash_t seed, size_t key,
+                               uint64_t start);
+
+hash_t HashTools::hash(const StrBlob &data, hash_t seed) {
+  if (data.length <= HashStream::MaxShortLength)
+  {
+    return HashShort(reinterpret_cast<const uint8_t *>(data.data), data.length, seed, LowShortKey,
+                     data.length * Prime64_1);
+  }
+
+  return HashStream(seed).update(data).digest();
+}
+
+Hash128 HashTools::hash128(const StrBlob &data, hash_t seed) {
+  if (data.length <= HashStream::MaxShortLength)
+  {
+    const uint8_t *const bytes = reinterpret_cast<const uint8_t *>(data.data);
+    return { HashShort(bytes, data.length, seed, LowShortKey, data.length * Prime64_1),
+             HashShort(bytes, data.length, seed, HighShortKey, data.length * Prime64_2) };
+  }
+
+  return HashStream(seed).update(data).digest128();
+}
+
+HashStream::HashStream(hash_t seed) { reset(seed); }
+
+void HashStream::reset(hash_t seed) {
+  std::memcpy(m_lanes, InitialLanes, sizeof(m_lanes));
+  SeedKeys(m_keys, seed);
+
+  m_seed = seed;
+  m_length = 0;
+  m_stripe = 0;
+  m_buffered = 0;
+}
+
+HashStream &HashStream::update(const StrBlob &chunk) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(chunk.data);
+  size_t length = chunk.length;
+  m_length += length;
+
+  if (m_buffered + length <= BufferSize)
+  {
+    if (length > 0)
+    {
+      std::memcpy(m_buffer + m_buffered, p, length);
+    }
+    m_buffered += length;
+    return *this;
+  }
+
+  // more of the content follows the buffered bytes, so none of them is the last stripe
+  if (m_buffered > 0)
+  {
+    const size_t fill = BufferSize - m_buffered;
+    std::memcpy(m_buffer + m_buffered, p, fill);
+    p += fill;
+    length -= fill;
+
+    _consume(m_buffer, BufferSize / StripeSize);
+    m_buffered = 0;
+  }
+
+  // consumed in place, leaving the last stripe (& up to 3 more) buffered
+  if (length > BufferSize)
+  {
+    const size_t count = (length - 1) / StripeSize;
+    _consume(p, count);
+    p += count * StripeSize;
+    length -= count * StripeSize;
+  }
+
+  std::memcpy(m_buffer, p, length);
+  m_buffered = length;
+  return *this;
+}
+
+hash_t HashStream::digest() const noexcept {
+  // short contents are never consumed, they're all buffered
+  if (m_length <= MaxShortLength)
+  {
+    return HashShort(m_buffer, m_buffered, m_seed, LowShortKey, m_length * Prime64_1);
+  }
+
+  uint64_t lanes[LaneCount];
+  std::memcpy(lanes, m_lanes, sizeof(lanes));
+  FinishLanes(lanes, m_stripe, m_buffer, m_buffered, m_keys);
+
+  return MergeLanes(lanes, m_keys + LowDigestKey, m_length * Prime64_1);
+}
+
+Hash128 HashStream::digest128() const noexcept {
+  if (m_length <= MaxShortLength)
+  {
+    return { HashShort(m_buffer, m_buffered, m_seed, LowShortKey, m_length * Prime64_1),
+             HashShort(m_buffer, m_buffered, m_seed, HighShortKey, m_length * Prime64_2) };
+  }
+
+  uint64_t lanes[LaneCount];
+  std::memcpy(lanes, m_lanes, sizeof(lanes));
+  FinishLanes(lanes, m_stripe, m_buffer, m_buffered, m_keys);
+
+  return { MergeLanes(lanes, m_keys + LowDigestKey, m_length * Prime64_1),
+           MergeLanes(lanes, m_keys + HighDigestKey, ~(m_length * Prime64_2)) };
+}
+
+void HashStream::_consume(const uint8_t *stripes, size_t count) {
+  ConsumeStripes(m_lanes, m_stripe, stripes, count, m_keys);
+}
+
+inline uint64_t Read64(const uint8_t *p) {
+  uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint32_t Read32(const uint8_t *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint64_t ReadShortKey(size_t offset) {
+  return Read64(reinterpret_cast<const uint8_t *>(HashTools::CipherTable) + offset);
+}
+
+inline uint64_t Multiply128Fold(uint64_t left, uint64_t right) {
+#if defined(__SIZEOF_INT128__)
+  const unsigned __int128 product = (unsigned __int128)left * right;
+  return uint64_t(product) ^ uint64_t(product >> 64);
+#else
+  const uint64_t left_low = left & 0xFFFFFFFF, left_high = left >> 32;
+  const uint64_t right_low = right & 0xFFFFFFFF, right_high = right >> 32;
+
+  const uint64_t low_low = left_low * right_low;
+  const uint64_t high_low = left_high * right_low;
+  const uint64_t low_high = left_low * right_high;
+  const uint64_t high_high = left_high * right_high;
+
+  const uint64_t cross = (low_low >> 32) + (high_low & 0xFFFFFFFF) + low_high;
+  const uint64_t high = (high_low >> 32) + (cross >> 32) + high_high;
+  const uint64_t low = (cross << 32) | (low_low & 0xFFFFFFFF);
+  return low ^ high;
+#endif
+}
+
+inline uint64_t Avalanche(uint64_t hash) {
+  hash ^= hash >> 37;
+  hash *= 0x165667919E3779F9ULL;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+inline void SeedKeys(uint64_t *keys, hash_t seed) {
+  for (size_t i = 0; i < HashStream::KeyCount; i++)
+  {
+    keys[i] = (i & 1) ? HashTools::CipherTable[i] - seed : HashTools::CipherTable[i] + seed;
+  }
+}
+
+#if HASH_AVX2
+static inline __m256i AccumulateLanes(__m256i lanes, __m256i data, __m256i keys) {
+  const __m256i keyed = _mm256_xor_si256(data, keys);
+  // the high half of every keyed lane times it's low half
+  const __m256i product =
+      _mm256_mul_epu32(keyed, _mm256_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+  // the data goes to the neighboring lane
+  const __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+  return _mm256_add_epi64(lanes, _mm256_add_epi64(product, swapped));
+}
+
+static inline __m256i ScrambleLanes(__m256i lanes, __m256i keys) {
+  const __m256i prime = _mm256_set1_epi32(int(Prime32_1));
+
+  lanes = _mm256_xor_si256(lanes, _mm256_srli_epi64(lanes, 47));
+  lanes = _mm256_xor_si256(lanes, keys);
+
+  const __m256i low = _mm256_mul_epu32(lanes, prime);
+  const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(lanes, 32), prime);
+  return _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+}
+#elif HASH_SSE2
+static inline __m128i AccumulateLanes(__m128i lanes, __m128i data, __m128i keys) {
+  const __m128i keyed = _mm_xor_si128(data, keys);
+  // the high half of every keyed lane times it's low half
+  const __m128i product =
+      _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+  // the data goes to the neighboring lane
+  const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+  return _mm_add_epi64(lanes, _mm_add_epi64(product, swapped));
+}
+
+static inline __m128i ScrambleLanes(__m128i lanes, __m128i keys) {
+  const __m128i prime = _mm_set1_epi32(int(Prime32_1));
+
+  lanes = _mm_xor_si128(lanes, _mm_srli_epi64(lanes, 47));
+  lanes = _mm_xor_si128(lanes, keys);
+
+  const __m128i low = _mm_mul_epu32(lanes, prime);
+  const __m128i high = _mm_mul_epu32(_mm_srli_epi64(lanes, 32), prime);
+  return _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+}
+#endif
+
+inline void AccumulateStripes(uint64_t *lanes, const uint8_t *stripes, size_t count,
+                              const uint64_t *keys) {
+#if HASH_AVX2
+  __m256i lanes_0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes));
+  __m256i lanes_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes + 4));
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const __m256i *const data = reinterpret_cast<const __m256i *>(stripes + i * 64);
+    const __m256i *const key = reinterpret_cast<const __m256i *>(keys + i);
+
+    lanes_0 = AccumulateLanes(lanes_0, _mm256_loadu_si256(data), _mm256_loadu_si256(key));
+    lanes_1 = AccumulateLanes(lanes_1, _mm256_loadu_si256(data + 1), _mm256_loadu_si256(key + 1));
+  }
+
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), lanes_0);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes + 4), lanes_1);
+#elif HASH_SSE2
+  __m128i vector_lanes[4];
+  for (size_t j = 0; j < 4; j++)
+  {
+    vector_lanes[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes + j * 2));
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const __m128i *const data = reinterpret_cast<const __m128i *>(stripes + i * 64);
+    const __m128i *const key = reinterpret_cast<const __m128i *>(keys + i);
+
+    for (size_t j = 0; j < 4; j++)
+    {
+      vector_lanes[j] =
+          AccumulateLanes(vector_lanes[j], _mm_loadu_si128(data + j), _mm_loadu_si128(key + j));
+    }
+  }
+
+  for (size_t j = 0; j < 4; j++)
+  {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + j * 2), vector_lanes[j]);
+  }
+#else
+  for (size_t i = 0; i < count; i++)
+  {
+    const uint8_t *const data = stripes + i * 64;
+
+    for (size_t lane = 0; lane < HashStream::LaneCount; lane++)
+    {
+      const uint64_t value = Read64(data + lane * 8);
+      const uint64_t keyed = value ^ keys[i + lane];
+
+      lanes[lane ^ 1] += value;
+      lanes[lane] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+    }
+  }
+#endif
+}
+
+inline void ScrambleLanes(uint64_t *lanes, const uint64_t *keys) {
+#if HASH_AVX2
+  for (size_t j = 0; j < 2; j++)
+  {
+    __m256i *const vector_lanes = reinterpret_cast<__m256i *>(lanes + j * 4);
+    const __m256i *const vector_keys = reinterpret_cast<const __m256i *>(keys + j * 4);
+    _mm256_storeu_si256(vector_lanes, ScrambleLanes(_mm256_loadu_si256(vector_lanes),
+                                                    _mm256_loadu_si256(vector_keys)));
+  }
+#elif HASH_SSE2
+  for (size_t j = 0; j < 4; j++)
+  {
+    __m128i *const vector_lanes = reinterpret_cast<__m128i *>(lanes + j * 2);
+    const __m128i *const vector_keys = reinterpret_cast<const __m128i *>(keys + j * 2);
+    _mm_storeu_si128(vector_lanes,
+                     ScrambleLanes(_mm_loadu_si128(vector_lanes), _mm_loadu_si128(vector_keys)));
+  }
+#else
+  for (size_t lane = 0; lane < HashStream::LaneCount; lane++)
+  {
+    uint64_t value = lanes[lane];
+    value ^= value >> 47;
+    value ^= keys[lane];
+    value *= Prime32_1;
+    lanes[lane] = value;
+  }
+#endif
+}
+
+inline void ConsumeStripes(uint64_t *lanes, size_t &stripe, const uint8_t *stripes, size_t count,
+                           const uint64_t *keys) {
+  while (count > 0)
+  {
+    const size_t block_count = std::min(count, HashStream::BlockStripes - stripe);
+    AccumulateStripes(lanes, stripes, block_count, keys + stripe);
+
+    stripes += block_count * HashStream::StripeSize;
+    count -= block_count;
+    stripe += block_count;
+
+    if (stripe == HashStream::BlockStripes)
+    {
+      ScrambleLanes(lanes, keys + HashStream::BlockStripes);
+      stripe = 0;
+    }
+  }
+}
+
+inline void FinishLanes(uint64_t *lanes, size_t stripe, const uint8_t *data, size_t length,
+                        const uint64_t *keys) {
+  const size_t full_count = (length - 1) / HashStream::StripeSize;
+  ConsumeStripes(lanes, stripe, data, full_count, keys);
+
+  // the padding is told apart from zeros by the content's length, that's merged in
+  uint8_t last[HashStream::StripeSize] = {};
+  const size_t consumed = full_count * HashStream::StripeSize;
+  std::memcpy(last, data + consumed, length - consumed);
+
+  AccumulateStripes(lanes, last, 1, keys + LastStripeKey);
+}
+
+inline hash_t MergeLanes(const uint64_t *lanes, const uint64_t *keys, uint64_t start) {
+  uint64_t hash = start;
+  for (size_t i = 0; i < HashStream::LaneCount; i += 2)
+  {
+    hash += Multiply128Fold(lanes[i] ^ keys[i], lanes[i + 1] ^ keys[i + 1]);
+  }
+  return Avalanche(hash);
+}
+
+// mixes 16 bytes of a short content
+static inline uint64_t MixChunk(uint64_t low, uint64_t high, size_t key, hash_t seed) {
+  return Multiply128Fold(low ^ (ReadShortKey(key) + seed), high ^ (ReadShortKey(key + 8) - seed));
+}
+
+inline hash_t HashShort(const uint8_t *data, size_t length, hash_t seed, size_t key,
+                        uint64_t start) {
+  uint64_t hash = start;
+
+  if (length > 16)
+  {
+    // the last chunk overlaps the one before it, unless the length is a multiple of 16
+    const size_t chunk_count = (length - 1) / 16;
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+      hash += MixChunk(Read64(data + i * 16), Read64(data + i * 16 + 8),
+                       key + i * ShortChunkKeyStride, seed);
+    }
+
+    hash += MixChunk(Read64(data + length - 16), Read64(data + length - 8),
+                     key + chunk_count * ShortChunkKeyStride, seed);
+    return Avalanche(hash);
+  }
+
+  uint64_t low = 0, high = 0;
+  if (length >= 8)
+  {
+    low = Read64(data);
+    high = Read64(data + length - 8);
+  }
+  else if (length >= 4)
+  {
+    low = Read32(data);
+    high = Read32(data + length - 4);
+  }
+  else if (length > 0)
+  {
+    low = uint64_t(data[0]) | (uint64_t(data[length / 2]) << 8) |
+          (uint64_t(data[length - 1]) << 16) | (uint64_t(length) << 24);
+    high = Math::rotl(low, 29);
+  }
+
+  hash += MixChunk(low, high, key, seed);
+  return Avalanche(hash);
+}
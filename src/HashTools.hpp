@@ -83,9 +83,15 @@ struct HashTools
     return combine(hash(left, right), std::forward<_Hashes>(hashes)...);
   }
 
-  inline static hash_t hash(const StrBlob &data, hash_t seed = StartSeed);
+  // the algorithm contents are hashed with (by `hash(StrBlob)`, `hash128` & `HashStream`),
+  // stored along the hashes so hashes of another algorithm are never compared to them
+  static constexpr int64_t Algorithm = 2;
+
+  static hash_t hash(const StrBlob &data, hash_t seed = StartSeed);
   inline static hash_t hash(const std::string &source, hash_t seed = StartSeed);
 
+  static Hash128 hash128(const StrBlob &data, hash_t seed = StartSeed);
+
   // only recommend for simple types
   template <typename T>
   inline static hash_t hash(const T &obj, hash_t seed = StartSeed);
@@ -105,6 +111,49 @@ struct HashTools
   inline static hash_t hash(const T (&objects)[N], hash_t seed = StartSeed);
 };
 
+// hashes a content that's fed in chunks, the digests are the same as hashing the whole
+// content at once with `HashTools::hash` & `HashTools::hash128`
+//
+// the content is read in 64 byte stripes, mixed into 8 64-bit lanes (vectorized with
+// SSE2/AVX2), contents up to 240 bytes are mixed 16 bytes at a time instead
+class HashStream
+{
+public:
+  static constexpr size_t StripeSize = 64;
+  static constexpr size_t LaneCount = StripeSize / sizeof(uint64_t);
+  // the lanes are scrambled every block
+  static constexpr size_t BlockStripes = 16;
+  static constexpr size_t KeyCount = BlockStripes + LaneCount;
+  // the longest content that's mixed without the lanes
+  static constexpr size_t MaxShortLength = 240;
+  // the last bytes of the content are kept until it's known whether more follow
+  static constexpr size_t BufferSize = StripeSize * 4;
+
+  explicit HashStream(hash_t seed = HashTools::StartSeed);
+
+  void reset(hash_t seed = HashTools::StartSeed);
+  HashStream &update(const StrBlob &chunk);
+
+  hash_t digest() const noexcept;
+  Hash128 digest128() const noexcept;
+
+  inline uint64_t get_length() const noexcept { return m_length; }
+
+private:
+  void _consume(const uint8_t *stripes, size_t count);
+
+private:
+  alignas(32) uint64_t m_lanes[LaneCount];
+  // the first `CipherTable` entries, seeded
+  uint64_t m_keys[KeyCount];
+  hash_t m_seed;
+  uint64_t m_length = 0;
+  // the stripe of the current block
+  size_t m_stripe = 0;
+  size_t m_buffered = 0;
+  alignas(32) uint8_t m_buffer[BufferSize];
+};
+
 struct HashDigester
 {
   inline HashDigester() = default;
@@ -123,24 +172,25 @@ struct HashDigester
     return add(obj);
   }
 
-  inline hash_t hash() const noexcept { return value; }
+  // feeds the next chunk of a content, the chunks are hashed as one stream (so how the
+  // content is split doesn't matter), which is combined with the added values
+  inline HashDigester &update(const StrBlob &chunk) {
+    stream.update(chunk);
+    return *this;
+  }
+
+  inline hash_t hash() const noexcept {
+    return stream.get_length() == 0 ? value : HashTools::combine(value, stream.digest());
+  }
 
   hash_t value = HashTools::StartSeed;
+  HashStream stream;
 };
 
 inline constexpr hash_t HashTools::hash(hash_t left, hash_t right) {
   return (left ^ StartSeed) ^ ~Math::rotr(right, 21) ^ Math::rotl(right, 14);
 }
 
-inline hash_t HashTools::hash(const StrBlob &data, hash_t seed) {
-  for (size_t i = 0; i < data.length; i++)
-  {
-    seed ^= Math::rotr(CipherTable[(uint8_t)data[i]], (int)i);
-  }
-
-  return seed;
-}
-
 inline hash_t HashTools::hash(const std::string &source, hash_t seed) {
   return hash(StrBlob{ source.c_str(), source.length() }, seed);
 }
@@ -0,0 +1,307 @@
+#include "ObjectStore.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+
+#include "HashTools.hpp"
+#include "Logger.hpp"
+#include "Settings.hpp"
+#include "utility/AtomicFile.hpp"
+#include "utility/FileLock.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static constexpr char ObjectsDirectoryName[] = "objects";
+static constexpr char ObjectExtension[] = ".o";
+static constexpr char LockFileName[] = ".lock";
+
+// the store's lock, fetching & publishing share it, collecting excludes them (it would evict
+// their temporary files & race the other collections)
+static std::mutex s_store_mutex;
+static FileLock s_store_lock;
+
+// holds the store's lock for a scope, without it (the store's directory can't be created) the
+// store is used unlocked
+struct StoreLockScope
+{
+  StoreLockScope(FileLock::Mode mode, bool wait);
+  ~StoreLockScope() noexcept;
+
+  std::scoped_lock<std::mutex> guard{ s_store_mutex };
+  bool locked = false;
+};
+
+static string GetObjectsDirectory();
+// replaces every `target` in `text` with `replacement`
+static void ReplaceAll(string &text, std::string_view target, std::string_view replacement);
+// makes `to` a reflink or a copy of `from`, never a hardlink: a stored object's inode shared
+// with checkouts would have it's times changed by every fetch & publish of the others, going
+// stale in their caches
+static bool MaterializeFile(const char *from, const char *to);
+
+bool ObjectStore::IsEnabled() { return Settings::Get("object_store", true).get_bool(); }
+
+FilePath ObjectStore::GetDirectory() {
+  const FieldVar &value = Settings::Get("object_store_dir", "~/.bgnu-objects");
+
+  if (value.get_type() != FieldVarType::String || value.get_string().empty())
+  {
+    Logger::warning("setting 'object_store_dir' should be a path, defaulting to '~/.bgnu-objects'");
+    return FilePath("~/.bgnu-objects").resolved_copy();
+  }
+
+  return FilePath(value.get_string()).resolved_copy();
+}
+
+uint64_t ObjectStore::GetMaxSize() {
+  const FieldVar::Int size_mb =
+      Settings::Get("object_store_max_size_mb", (FieldVar::Int)4096).get_int();
+  return uint64_t(std::max<FieldVar::Int>(size_mb, 0)) * 1024 * 1024;
+}
+
+hash_t ObjectStore::MakeKey(hash_t closure_hash,
+                            const ArgumentList &args,
+                            std::string_view output_path,
+                            std::string_view root_directory,
+                            hash_t compiler_fingerprint) {
+  HashDigester digester{};
+  digester += closure_hash;
+  digester += compiler_fingerprint;
+
+  // matched without it's separator, like the prefix map arguments have it
+  if (root_directory.ends_with(FilePath::DirectorySeparator))
+  {
+    root_directory.remove_suffix(1);
+  }
+
+  string normalized_arg{};
+  for (std::string_view arg : args)
+  {
+    // the output path can be glued to it's flag ('-o<path>'), it's under the root as well
+    normalized_arg.assign(arg);
+    ReplaceAll(normalized_arg, output_path, "<output>");
+    ReplaceAll(normalized_arg, root_directory, "<root>");
+
+    digester += HashTools::hash(StrBlob{ normalized_arg.data(), normalized_arg.size() });
+  }
+
+  return digester.value;
+}
+
+bool ObjectStore::Fetch(hash_t key, const FilePath &output) {
+  const FilePath object_path = GetObjectPath(key);
+  const StoreLockScope lock_scope{ FileLock::Mode::Shared, true };
+  std::error_code err_code{};
+
+  // the last use is the write time, the eviction order (the stored object's inode is the
+  // store's own, no checkout sees it)
+  fs::last_write_time(object_path.to_std_path(), fs::file_time_type::clock::now(), err_code);
+  if (err_code)
+  {
+    return false;
+  }
+
+  output.remove();
+  output.parent().create_directory();
+
+  if (!MaterializeFile(object_path.c_str(), output.c_str()))
+  {
+    Logger::warning("object store: can't materialize '%s' as '%s'",
+                    object_path.c_str(),
+                    output.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool ObjectStore::Publish(hash_t key, const FilePath &object) {
+  const FilePath object_path = GetObjectPath(key);
+  if (object_path.is_file())
+  {
+    return true;
+  }
+
+  object_path.parent().create_directory();
+  const StoreLockScope lock_scope{ FileLock::Mode::Shared, true };
+
+  // renamed into place, a reader never sees a partial object
+  const FilePath temporary_path = AtomicFile::GetTemporaryPath(object_path);
+  if (!MaterializeFile(object.c_str(), temporary_path.c_str()))
+  {
+    Logger::warning("object store: can't store '%s' as '%s'",
+                    object.c_str(),
+                    object_path.c_str());
+    return false;
+  }
+
+  return AtomicFile::Replace(temporary_path, object_path);
+}
+
+ObjectStore::Stats ObjectStore::GetStats() {
+  Stats stats{};
+  stats.max_size = GetMaxSize();
+
+  std::error_code err_code{};
+  const fs::path objects_dir = GetObjectsDirectory();
+  for (const auto &entry : fs::recursive_directory_iterator(objects_dir, err_code))
+  {
+    if (!entry.is_regular_file(err_code))
+    {
+      continue;
+    }
+
+    stats.objects_count++;
+    stats.total_size += entry.file_size(err_code);
+  }
+
+  return stats;
+}
+
+size_t ObjectStore::Collect(uint64_t max_size, bool wait) {
+  const StoreLockScope lock_scope{ FileLock::Mode::Exclusive, wait };
+  if (!lock_scope.locked && !wait)
+  {
+    Logger::verbose("object store: in use by another build, skipping the collection");
+    return 0;
+  }
+
+  struct StoredObject
+  {
+    fs::path path;
+    fs::file_time_type last_use;
+    uint64_t size;
+  };
+
+  vector<StoredObject> objects{};
+  uint64_t total_size = 0;
+
+  std::error_code err_code{};
+  const fs::path objects_dir = GetObjectsDirectory();
+  for (const auto &entry : fs::recursive_directory_iterator(objects_dir, err_code))
+  {
+    if (!entry.is_regular_file(err_code))
+    {
+      continue;
+    }
+
+    const StoredObject &object = objects.emplace_back(
+        StoredObject{ entry.path(), entry.last_write_time(err_code), entry.file_size(err_code) });
+    total_size += object.size;
+  }
+
+  if (total_size <= max_size)
+  {
+    return 0;
+  }
+
+  std::sort(objects.begin(), objects.end(), [](const StoredObject &left, const StoredObject &right) {
+    return left.last_use < right.last_use;
+  });
+
+  size_t evicted_count = 0;
+  for (const StoredObject &object : objects)
+  {
+    if (total_size <= max_size)
+    {
+      break;
+    }
+
+    if (fs::remove(object.path, err_code))
+    {
+      total_size -= object.size;
+      evicted_count++;
+    }
+  }
+
+  Logger::verbose("object store: evicted %llu objects, %llu bytes left",
+                  evicted_count,
+                  total_size);
+  return evicted_count;
+}
+
+FilePath ObjectStore::GetObjectPath(hash_t key) {
+  char name[24] = {};
+  snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+
+  // sharded by the key's first byte
+  string path = GetObjectsDirectory();
+  path.append(1, FilePath::DirectorySeparator).append(name, 2);
+  path.append(1, FilePath::DirectorySeparator).append(name).append(ObjectExtension);
+  return FilePath(path);
+}
+
+inline string GetObjectsDirectory() {
+  string path = ObjectStore::GetDirectory().c_str();
+  path.append(1, FilePath::DirectorySeparator).append(ObjectsDirectoryName);
+  return path;
+}
+
+inline void ReplaceAll(string &text, std::string_view target, std::string_view replacement) {
+  if (target.empty())
+  {
+    return;
+  }
+
+  size_t position = text.find(target);
+  while (position != text.npos)
+  {
+    text.replace(position, target.size(), replacement);
+    position = text.find(target, position + replacement.size());
+  }
+}
+
+inline bool MaterializeFile(const char *from, const char *to) {
+#ifdef __linux__
+  const int source_fd = open(from, O_RDONLY | O_CLOEXEC);
+  if (source_fd < 0)
+  {
+    return false;
+  }
+
+  const int dest_fd = open(to, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (dest_fd >= 0)
+  {
+    const bool cloned = ioctl(dest_fd, FICLONE, source_fd) == 0;
+    close(dest_fd);
+    close(source_fd);
+
+    if (cloned)
+    {
+      return true;
+    }
+    unlink(to);
+  }
+  else
+  {
+    close(source_fd);
+  }
+#endif
+
+  // without reflinks (or across file systems)
+  std::error_code err_code{};
+  return fs::copy_file(from, to, err_code);
+}
+
+StoreLockScope::StoreLockScope(FileLock::Mode mode, bool wait) {
+  if (!s_store_lock.is_open())
+  {
+    const FilePath store_dir = ObjectStore::GetDirectory();
+    store_dir.create_directory();
+    s_store_lock.open(
+        FilePath(string(store_dir.c_str()) + FilePath::DirectorySeparator + LockFileName));
+  }
+
+  locked = wait ? s_store_lock.lock(mode) : s_store_lock.try_lock(mode);
+}
+
+StoreLockScope::~StoreLockScope() noexcept { s_store_lock.unlock(); }
@@ -0,0 +1,58 @@
+#pragma once
+#include <string_view>
+
+#include "FilePath.hpp"
+#include "base.hpp"
+#include "utility/ArgumentList.hpp"
+
+// a content addressed store of compiled objects, shared by every project, configuration &
+// checkout of the user
+//
+// an object is keyed by what compiled it (it's source's dependency closure hash, the compile
+// arguments & the compiler's fingerprint), so a source compiled once the same way (before
+// switching branches or configurations) is materialized from the store instead of compiled,
+// objects are materialized as reflinks or copies (whatever the file system allows), the least
+// recently used objects are evicted once the store outgrows it's limit
+class ObjectStore
+{
+public:
+  struct Stats
+  {
+    uint64_t objects_count = 0;
+    uint64_t total_size = 0;
+    uint64_t max_size = 0;
+  };
+
+  ObjectStore() = delete;
+
+  // the 'object_store' setting
+  static bool IsEnabled();
+  // the 'object_store_dir' setting
+  static FilePath GetDirectory();
+  // the 'object_store_max_size_mb' setting, in bytes
+  static uint64_t GetMaxSize();
+
+  // the compile arguments are hashed without `output_path` (where the object lands doesn't
+  // change it's content) & with `root_directory` (the project's directory, mapped away by the
+  // compile arguments) replaced, so the same project in another directory has the same keys
+  static hash_t MakeKey(hash_t closure_hash,
+                        const ArgumentList &args,
+                        std::string_view output_path,
+                        std::string_view root_directory,
+                        hash_t compiler_fingerprint);
+
+  // materializes the object stored at `key` as `output`, returns false on a miss
+  static bool Fetch(hash_t key, const FilePath &output);
+  // stores `object` at `key` unless there is one already
+  static bool Publish(hash_t key, const FilePath &object);
+
+  static Stats GetStats();
+
+  // evicts the least recently used objects until the store fits in `max_size` bytes,
+  // returns the evicted objects count, without `wait` nothing is evicted while another
+  // process uses the store
+  static size_t Collect(uint64_t max_size, bool wait);
+
+private:
+  static FilePath GetObjectPath(hash_t key);
+};
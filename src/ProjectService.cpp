@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -11,12 +13,15 @@
 #include "FieldFile.hpp"
 #include "FieldVar.hpp"
 #include "Logger.hpp"
+#include "ObjectStore.hpp"
 #include "Project.hpp"
 #include "Settings.hpp"
+#include "Toolchain.hpp"
 #include "code/SourceProcessor.hpp"
 #include "misc/ContainerTools.hpp"
 #include "misc/Error.hpp"
 #include "misc/Time.hpp"
+#include "utility/AtomicFile.hpp"
 #include "utility/FileStats.hpp"
 
 BuildStep ProjectService::s_current_step = BuildStep::None;
@@ -38,12 +43,21 @@ vector<build_tools::BuildCommandInfo>
     ProjectService::s_total_build_commands = {};
 vector<build_tools::BuildCommandInfo>
     ProjectService::s_used_build_commands = {};
+std::map<SourceFileType, ArgumentTemplate>
+    ProjectService::s_argument_templates = {};
 vector<int> ProjectService::s_source_build_result_codes = {};
 
 std::map<FilePath, FilePath> ProjectService::s_source_io_map = {};
 std::map<FilePath, hash_t> ProjectService::s_source_files_hashes_map = {};
 std::map<FilePath, hash_t> ProjectService::s_obj_files_hashes_map = {};
 std::map<FilePath, hash_t> ProjectService::s_source2obj_files_hashes_map = {};
+std::map<FilePath, FileSignature> ProjectService::s_source2obj_signatures_map = {};
+std::map<FilePath, hash_t> ProjectService::s_source2store_keys_map = {};
+size_t ProjectService::s_fetched_objects_count = 0;
+string ProjectService::s_last_config_name = "";
+BuildCache::scan_record_table ProjectService::s_scan_records = {};
+BuildCache::macro_record_table ProjectService::s_scan_macros = {};
+hash_t ProjectService::s_scan_macros_hash = 0;
 
 build_tools::BuildCommandInfo ProjectService::s_linking_build_cmd = {};
 int ProjectService::s_linking_result_code = 0;
@@ -51,6 +65,12 @@ int ProjectService::s_linking_result_code = 0;
 FilePath ProjectService::s_project_file = {};
 FilePath ProjectService::s_build_directory = {};
 
+std::unique_ptr<JobPool> ProjectService::s_job_pool = nullptr;
+std::unique_ptr<BatchIO> ProjectService::s_batch_io = nullptr;
+BuildJournal ProjectService::s_build_journal{};
+FileLock ProjectService::s_config_lock{};
+FileLock ProjectService::s_output_lock{};
+
 BuildCache ProjectService::s_current_cache = {};
 BuildCache ProjectService::s_updated_cache = {};
 
@@ -58,6 +78,8 @@ bool ProjectService::s_cache_loaded = false;
 bool ProjectService::s_forced_rebuild = false;
 bool ProjectService::s_resave_required = false;
 bool ProjectService::s_hash_mismatched = false;
+bool ProjectService::s_up_to_date = false;
+hash_t ProjectService::s_settings_hash = 0;
 
 constexpr string RebuildArgs[] = { "-r", "--rebuild" };
 constexpr string ResaveArgs[] = { "--resave" };
@@ -70,6 +92,9 @@ void ProjectService::Clear() {
   s_read_only = false;
 
   s_project = nullptr;
+  s_build_journal.close();
+  s_output_lock.close();
+  s_config_lock.close();
   s_current_config_name = "";
   s_current_config = nullptr;
 
@@ -80,12 +105,21 @@ void ProjectService::Clear() {
 
   s_total_build_commands = {};
   s_used_build_commands = {};
+  s_argument_templates = {};
+  Toolchain::Clear();
   s_source_build_result_codes = {};
 
   s_source_io_map = {};
   s_source_files_hashes_map = {};
   s_obj_files_hashes_map = {};
   s_source2obj_files_hashes_map = {};
+  s_source2obj_signatures_map = {};
+  s_source2store_keys_map = {};
+  s_fetched_objects_count = 0;
+  s_last_config_name = "";
+  s_scan_records = {};
+  s_scan_macros = {};
+  s_scan_macros_hash = 0;
 
   s_linking_build_cmd = {};
   s_linking_result_code = 0;
@@ -100,6 +134,8 @@ void ProjectService::Clear() {
   s_forced_rebuild = false;
   s_resave_required = false;
   s_hash_mismatched = false;
+  s_up_to_date = false;
+  s_settings_hash = 0;
 }
 
 Error ProjectService::ExecuteStep(BuildStep step) {
@@ -128,6 +164,11 @@ std::pair<Error, BuildStep> ProjectService::ExecuteStepsTo(
     {
       return { result, BuildStep(i) };
     }
+
+    if (s_up_to_date)
+    {
+      break;
+    }
   }
 
   s_final_step = BuildStep::None;
@@ -140,7 +181,10 @@ void ProjectService::SetArguments(ArgumentSource args) {
 }
 
 Error ProjectService::SetupArgs() {
+  // the steps being executed still end at the same step after clearing
+  const BuildStep final_step = s_final_step;
   Clear();
+  s_final_step = final_step;
 
   s_forced_rebuild = Argument::try_use(
       s_arguments.extract_any(Blob<const string>(RebuildArgs)));
@@ -228,6 +272,24 @@ Error ProjectService::SetupProject() {
 }
 
 Error ProjectService::LoadCaches() {
+  // a forced rebuild writes the manifest too, with the settings it was built with
+  s_settings_hash = Settings::Hash();
+
+  if (!s_forced_rebuild && IsFullBuild() && !s_resave_required && IsBuildManifestMatching())
+  {
+    Logger::notify("Nothing changed since the last build, project is up-to-date");
+    s_up_to_date = true;
+    return Error::Ok;
+  }
+
+  // held until the build ends, the cache is read after the last build of the configuration
+  // wrote it
+  if (!s_read_only)
+  {
+    AcquireBuildLock(
+        s_config_lock, GetConfigLockPath(), "configuration '" + s_current_config_name + "'");
+  }
+
   if (s_forced_rebuild)
   {
     s_cache_loaded = false;
@@ -252,7 +314,8 @@ Error ProjectService::ProcessPrebuild() {
 
   if (should_clear_cache)
   {
-    build_tools::DeleteBuildCache(*s_project);
+    // only this configuration's cache, the others are still valid
+    GetConfigCacheDirectory().remove_recursive();
   }
   else if (show_cache_warning)
   {
@@ -273,9 +336,13 @@ Error ProjectService::LoadSourceInfo() {
   }
 
   processor.process();
+  s_scan_records = processor.get_scan_records();
+  // the records are keyed by the macros they were finally scanned with
+  s_scan_macros_hash = CPreprocessor::hash_macros(processor.get_macros());
+
   if (!s_read_only)
   {
-    build_tools::DumpDependencyMap(processor.get_dependency_info_map(),
+    build_tools::DumpDependencyMap(processor.get_graph(),
                                    s_project->get_output().dir.field());
   }
 
@@ -317,8 +384,13 @@ Error ProjectService::UpdateBuildCache() {
   }
 
   s_updated_cache = s_current_cache;
+  s_updated_cache.root_directory = GetProjectRootDirectory();
   s_updated_cache.build_time = t::Now_ms();
   build_tools::SetupHashes(s_updated_cache, *s_project, s_current_config);
+  Toolchain::Store(s_updated_cache);
+  s_updated_cache.scan_macros = s_scan_macros;
+  s_updated_cache.scan_macros_hash = s_scan_macros_hash;
+  s_updated_cache.scan_records = s_scan_records;
 
   Logger::verbose("## build cache hashes: new[%llX, %llX]  old[%llX, %llX] ##",
                   s_updated_cache.build_hash,
@@ -331,9 +403,10 @@ Error ProjectService::UpdateBuildCache() {
 Error ProjectService::PopulateCompileNeededFiles() {
   if (ShouldRebuild())
   {
-    Logger::note("** rebuilding project: deleting output & cache directory **");
+    Logger::note("** rebuilding configuration '%s': deleting it's cache directory **",
+                 s_current_config_name.c_str());
     s_compile_needed_source_files = s_source_files;
-    build_tools::DeleteBuildDir(*s_project);
+    GetConfigCacheDirectory().remove_recursive();
     return Error::Ok;
   }
   // add files that have changed from last build
@@ -397,8 +470,7 @@ Error ProjectService::PostBuildCommandsStep() {
     {
 
       cmds.emplace_back(
-          build_tools::JoinArguments(s_total_build_commands[i].args.data(),
-                                     s_total_build_commands[i].args.size(),
+          build_tools::JoinArguments(s_total_build_commands[i].args,
                                      build_tools::IsAllowedForClangdCommands));
       names.emplace_back(s_build_directory.relative_to(
           s_total_build_commands[i].in_path.resolved_copy()));
@@ -415,6 +487,13 @@ Error ProjectService::PostBuildCommandsStep() {
 }
 
 Error ProjectService::DispatchBuildProcesses() {
+  // the sources compiled the same way before aren't compiled again
+  std::erase_if(s_used_build_commands, FetchStoredObject);
+  if (s_fetched_objects_count > 0)
+  {
+    Logger::notify("%llu object[s] reused from the object store",
+                   s_fetched_objects_count);
+  }
 
   s_source_build_result_codes.clear();
   s_source_build_result_codes.resize(s_used_build_commands.size());
@@ -433,15 +512,42 @@ Error ProjectService::DispatchBuildProcesses() {
 }
 
 Error ProjectService::ReapplyUpdatedBuildCache() {
-  LoadObjectHashesToUpdatedCache();
   s_updated_cache.fix_file_records();
   s_current_cache = s_updated_cache;
-  const auto data = s_current_cache.write();
-  FieldFile::dump(GetBuildCachePath(), data);
+  // the journal's records are in the build cache now, once it's rename is on the disk too
+  const FilePath cache_path = GetBuildCachePath();
+  if (BuildCacheFile::Write(s_current_cache, cache_path) &&
+      AtomicFile::SyncDirectory(cache_path.parent()))
+  {
+    GetBuildJournalPath().remove();
+  }
+
+  // superseded once adopted, the old layout's shard directories are left empty
+  const FilePath legacy_path = GetLegacyBuildCachePath();
+  if (legacy_path.is_file())
+  {
+    legacy_path.remove();
+
+    std::error_code err_code{};
+    const std::filesystem::path cache_dir = s_project->get_output().cache_dir->to_std_path();
+    for (const auto &entry : std::filesystem::directory_iterator(cache_dir, err_code))
+    {
+      // the locks & the configurations' directories stay, only the emptied shards go
+      if (entry.is_directory(err_code) && std::filesystem::is_empty(entry.path(), err_code))
+      {
+        std::filesystem::remove(entry.path(), err_code);
+      }
+    }
+  }
   return Error::Ok;
 }
 
 Error ProjectService::LinkBuiltFiles() {
+  if (!s_read_only)
+  {
+    AcquireBuildLock(s_output_lock, GetOutputLockPath(), "the output directory");
+  }
+
   const bool intermidiate_build_all_success = IsBuildSuccessful();
 
   constexpr char force_linking_setting_name[] = "force_linking";
@@ -458,8 +564,12 @@ Error ProjectService::LinkBuiltFiles() {
 
   // no intermediates required rebuilding
   // no failures and no success => No files needed a rebuild
-  const bool all_intermediates_upto_date =
-      intermidiate_build_all_success && GetBuildSuccessCount() == 0;
+  // the binary is shared by every configuration, the last one linked it
+  const bool all_intermediates_upto_date = intermidiate_build_all_success &&
+                                          GetBuildSuccessCount() == 0 &&
+                                          s_fetched_objects_count == 0 &&
+                                          s_last_config_name == s_current_config_name &&
+                                          GetLinkOutputPath().is_file();
 
   const bool linking_necessary =
       !all_intermediates_upto_date ||
@@ -548,6 +658,11 @@ Error ProjectService::LinkBuiltFiles() {
 }
 
 Error ProjectService::PostLinkingStep() {
+  if (!s_read_only)
+  {
+    AcquireBuildLock(s_output_lock, GetOutputLockPath(), "the output directory");
+  }
+
   // if 'no_cache' or 'clear_cache', the cache will be deleted
   if (Settings::Get("no_cache", Settings::Get("clear_cache", false)))
   {
@@ -569,6 +684,8 @@ Error ProjectService::PostLinkingStep() {
     FieldFile::dump(s_project_file, output.get_dict());
   }
 
+  WriteBuildManifest();
+  s_output_lock.close();
   return Error::Ok;
 }
 
@@ -582,15 +699,270 @@ Error ProjectService::DumpAvailableBuildCommands() {
   return Error::Ok;
 }
 
-FilePath ProjectService::GetCompiledOutputPath(const FilePath &path,
-                                               hash_t hash) {
-  (void)hash;
-  auto str = s_project->get_output().cache_dir->to_string();
+Error ProjectService::ExportCache(const FilePath &path) {
+  AcquireBuildLock(
+      s_config_lock, GetConfigLockPath(), "configuration '" + s_current_config_name + "'");
+
+  const CacheBundle::Fingerprints fingerprints = GetCacheFingerprints();
+
+  // the bundle is checked against the build it's imported in, a stale cache would be rejected
+  // there or (worse) bring the objects of old sources
+  {
+    BuildCacheFile cache_file{};
+    if (cache_file.open(GetBuildCachePath()) != Error::Ok)
+    {
+      Logger::error("no build cache for the configuration '%s', build it before exporting",
+                    s_current_config_name.c_str());
+      s_config_lock.close();
+      return Error::FileNotFound;
+    }
+
+    const BuildCacheFile::Header &header = cache_file.get_header();
+    if (header.build_hash != fingerprints.project_hash ||
+        header.config_hash != fingerprints.config_hash)
+    {
+      Logger::error("the build cache of the configuration '%s' is out of date, build it before "
+                    "exporting",
+                    s_current_config_name.c_str());
+      s_config_lock.close();
+      return Error::Failure;
+    }
+  }
+
+  size_t files_count = 0;
+  const ErrorReport report =
+      CacheBundle::Export(path, GetConfigCacheDirectory(), fingerprints, files_count);
+  s_config_lock.close();
+
+  if (report)
+  {
+    Logger::error(report);
+    return report.code;
+  }
+
+  Logger::notify("exported %llu file[s] of the configuration '%s' to '%s'",
+                 files_count,
+                 s_current_config_name.c_str(),
+                 path.c_str());
+  return Error::Ok;
+}
+
+Error ProjectService::ImportCache(const FilePath &path) {
+  AcquireBuildLock(
+      s_config_lock, GetConfigLockPath(), "configuration '" + s_current_config_name + "'");
+
+  size_t files_count = 0;
+  const ErrorReport report =
+      CacheBundle::Import(path, GetConfigCacheDirectory(), GetCacheFingerprints(), files_count);
+
+  // the manifest is of the replaced cache's build, the next build checks every file
+  if (files_count != 0)
+  {
+    GetBuildManifestPath().remove();
+  }
+
+  s_config_lock.close();
+
+  if (report)
+  {
+    Logger::error(report);
+    return report.code;
+  }
+
+  Logger::notify("imported %llu file[s] into the configuration '%s'",
+                 files_count,
+                 s_current_config_name.c_str());
+  return Error::Ok;
+}
+
+JobPool &ProjectService::GetJobPool() {
+  if (!s_job_pool)
+  {
+    const int64_t workers_count =
+        Settings::Get("build_jobs_count", (FieldVar::Int)8).get_int();
+
+    s_job_pool = std::make_unique<JobPool>(
+        (uint32_t)std::clamp<int64_t>(workers_count, 0, UINT16_MAX));
+  }
+
+  return *s_job_pool;
+}
+
+BatchIO &ProjectService::GetBatchIO() {
+  if (!s_batch_io)
+  {
+    s_batch_io = std::make_unique<BatchIO>(&GetJobPool());
+  }
+
+  return *s_batch_io;
+}
+
+FilePath ProjectService::GetCompiledOutputPath(const FilePath &path) {
+  // keyed by the project relative path, same named sources in different directories don't
+  // collide & the layout is the same on every machine
+  const string relative_path = s_build_directory.relative_to(path.resolved_copy()).c_str();
+  const hash_t path_hash = HashTools::hash(relative_path);
+
+  char hash_str[24] = {};
+  snprintf(hash_str, sizeof(hash_str), "%016llx", (unsigned long long)path_hash);
+
+  // sharded by the hash's first byte, `<cache>/<config>/ab/cdef0123456789.<name>.o`
+  string str = GetConfigCacheDirectory().c_str();
+  str.append(hash_str, 2);
+  str += FilePath::DirectorySeparator;
+  str.append(hash_str + 2);
+  str += '.';
   str += path.name();
   str += ".o";
   return FilePath(str);
 }
 
+FilePath ProjectService::GetConfigCacheDirectory() {
+  string str = s_project->get_output().cache_dir->c_str();
+  if (!str.empty() && str.back() != FilePath::DirectorySeparator)
+  {
+    str += FilePath::DirectorySeparator;
+  }
+
+  str += GetConfigDirectoryName();
+  str += FilePath::DirectorySeparator;
+  return FilePath(str);
+}
+
+string ProjectService::GetProjectRootDirectory() {
+  string str = s_build_directory.c_str();
+  if (!str.empty() && str.back() != FilePath::DirectorySeparator)
+  {
+    str += FilePath::DirectorySeparator;
+  }
+
+  return str;
+}
+
+FilePath ProjectService::GetConfigLockPath() {
+  string str = s_project->get_output().cache_dir->c_str();
+  if (!str.empty() && str.back() != FilePath::DirectorySeparator)
+  {
+    str += FilePath::DirectorySeparator;
+  }
+
+  str += '.';
+  str += GetConfigDirectoryName();
+  str += ".lock";
+  return FilePath(str);
+}
+
+string ProjectService::GetConfigDirectoryName() {
+  // a configuration named with characters a file name can't have is named by it's hash, so are
+  // the names with separators or a leading '.' (like '.' or '..'), they'd lead out of the cache
+  // directory (or onto it's hidden files)
+  const bool valid_name =
+      !s_current_config_name.empty() && s_current_config_name.front() != '.' &&
+      std::all_of(s_current_config_name.begin(), s_current_config_name.end(), [](char character) {
+        return character != '/' && character != '\\' &&
+               FilePath::is_valid_filename_char(character);
+      });
+
+  if (valid_name)
+  {
+    return s_current_config_name;
+  }
+
+  char hash_str[24] = {};
+  snprintf(hash_str,
+           sizeof(hash_str),
+           "%016llx",
+           (unsigned long long)HashTools::hash(s_current_config_name));
+  return hash_str;
+}
+
+void ProjectService::AcquireBuildLock(FileLock &lock,
+                                      const FilePath &path,
+                                      const string &holder_name) {
+  if (lock.is_locked())
+  {
+    return;
+  }
+
+  path.parent().create_directory();
+  if (!lock.open(path))
+  {
+    Logger::warning("can't open the lock file '%s', not excluding the other builds using %s",
+                    path.c_str(),
+                    holder_name.c_str());
+    return;
+  }
+
+  if (lock.try_lock(FileLock::Mode::Exclusive))
+  {
+    return;
+  }
+
+  Logger::notify("waiting for another build using %s to finish", holder_name.c_str());
+  if (!lock.lock(FileLock::Mode::Exclusive))
+  {
+    Logger::warning("can't lock '%s', not excluding the other builds using %s",
+                    path.c_str(),
+                    holder_name.c_str());
+  }
+}
+
+CacheBundle::Fingerprints ProjectService::GetCacheFingerprints() {
+  const CompilerType compiler_type = s_current_config->compiler_type.field();
+
+  CacheBundle::Fingerprints fingerprints{};
+  fingerprints.project_hash = build_tools::GetProjectHash(*s_project);
+  fingerprints.config_hash = build_tools::GetConfigHash(*s_current_config);
+  fingerprints.c_compiler_fingerprint = Toolchain::GetFingerprint(
+      BuildConfiguration::get_compiler_name(compiler_type, SourceFileType::C));
+  fingerprints.cpp_compiler_fingerprint = Toolchain::GetFingerprint(
+      BuildConfiguration::get_compiler_name(compiler_type, SourceFileType::CPP));
+  return fingerprints;
+}
+
+void ProjectService::MigrateObjects(const vector<FilePath> &obj_paths) {
+  // the objects each old path was shared by (same named sources overwrote each other)
+  std::map<FilePath, size_t> old_path_users{};
+  for (const auto &[_, record] : s_current_cache.file_records)
+  {
+    old_path_users[record.output_path]++;
+  }
+
+  size_t migrated_count = 0;
+  for (size_t i = 0; i < obj_paths.size(); i++)
+  {
+    const auto record_iter = s_current_cache.file_records.find(s_source_files[i]);
+    if (record_iter == s_current_cache.file_records.end())
+    {
+      continue;
+    }
+
+    BuildCache::FileRecord &record = record_iter->second;
+    if (record.output_path == obj_paths[i] || old_path_users[record.output_path] != 1 ||
+        !record.output_path.is_file() || obj_paths[i].exists())
+    {
+      continue;
+    }
+
+    obj_paths[i].parent().create_directory();
+
+    std::error_code err_code{};
+    std::filesystem::rename(record.output_path.to_std_path(), obj_paths[i].to_std_path(), err_code);
+    if (err_code)
+    {
+      continue;
+    }
+
+    record.output_path = obj_paths[i];
+    migrated_count++;
+  }
+
+  if (migrated_count > 0)
+  {
+    Logger::verbose("migrated %llu object[s] to the sharded layout", migrated_count);
+  }
+}
+
 size_t ProjectService::GetBuildFailureCount() {
   LOG_ASSERT(s_used_build_commands.size() ==
              s_source_build_result_codes.size());
@@ -640,6 +1012,43 @@ const char *ProjectService::GetStepName(BuildStep step) {
   return "UNKNOWN";
 }
 
+BuildSchedulePolicy ProjectService::GetBuildSchedulePolicy() {
+  constexpr char setting_name[] = "build_schedule_policy";
+  const FieldVar &value = Settings::Get(setting_name, "longest_first");
+
+  if (value.get_type() != FieldVarType::String)
+  {
+    Logger::warning(
+        "setting '%s' should be a string, defaulting to 'longest_first'",
+        setting_name);
+    return BuildSchedulePolicy::LongestFirst;
+  }
+
+  const string &name = value.get_string();
+  if (name == "none")
+  {
+    return BuildSchedulePolicy::None;
+  }
+  if (name == "longest_first")
+  {
+    return BuildSchedulePolicy::LongestFirst;
+  }
+  if (name == "recently_modified_first")
+  {
+    return BuildSchedulePolicy::RecentlyModifiedFirst;
+  }
+  if (name == "failed_first")
+  {
+    return BuildSchedulePolicy::FailedFirst;
+  }
+
+  Logger::warning("unknown %s '%s', expected one of 'none', 'longest_first', "
+                  "'recently_modified_first' or 'failed_first'",
+                  setting_name,
+                  name.c_str());
+  return BuildSchedulePolicy::LongestFirst;
+}
+
 FilePath ProjectService::GetLinkOutputPath() {
   return s_project->get_output().dir->join_path(*s_project->get_output().name);
 }
@@ -686,11 +1095,12 @@ void ProjectService::UpdateHashMismatchFlag() {
 }
 
 bool ProjectService::IsProjectHashMatching() {
-  return s_project->hash() == s_current_cache.build_hash;
+  return build_tools::GetProjectHash(*s_project) == s_current_cache.build_hash;
 }
 
 bool ProjectService::IsConfigHashMatching() {
-  return s_current_config->hash() == s_current_cache.config_hash;
+  return build_tools::GetConfigHash(*s_current_config) ==
+         s_current_cache.config_hash;
 }
 
 Error ProjectService::ExecuteStep_Inner(BuildStep step) {
@@ -841,28 +1251,63 @@ ErrorReport ProjectService::SetupConfig() {
 }
 
 ErrorReport ProjectService::ReadBuildCache() {
-  const FilePath build_cache_path = GetBuildCachePath();
+  FilePath build_cache_path = GetBuildCachePath();
 
   if (!build_cache_path.is_file())
   {
-    Logger::verbose("no build cache found at '%s'", build_cache_path.c_str());
-    return { Error::FileNotFound, "Build cache not found" };
-  }
+    // an interrupted first build (or rebuild) only left it's journal
+    s_current_cache.root_directory = GetProjectRootDirectory();
+    const size_t replayed_count = BuildJournal::Replay(GetBuildJournalPath(), s_current_cache);
+    if (replayed_count > 0)
+    {
+      Logger::notify("recovered %llu object[s] of an interrupted build", replayed_count);
+      Toolchain::Load(s_current_cache);
+      return {};
+    }
 
-  FieldVar old_build_cache_data;
-  try
-  { old_build_cache_data = FieldFile::load(build_cache_path); }
-  catch (const std::exception &e)
-  {
-    Logger::error("failed to load build cache: %s", e.what());
-    return { Error::FileNotFound, e.what() };
+    // a cache from before the split is adopted by the configuration that made it, it's
+    // objects are moved into the configuration's directory with the other old layouts
+    const FilePath legacy_path = GetLegacyBuildCachePath();
+    if (!legacy_path.is_file())
+    {
+      Logger::verbose("no build cache found at '%s'", build_cache_path.c_str());
+      return { Error::FileNotFound, "Build cache not found" };
+    }
+
+    Logger::verbose("adopting the build cache at '%s'", legacy_path.c_str());
+    build_cache_path = legacy_path;
   }
 
   ErrorReport report = {};
 
-  s_current_cache = BuildCache::load(
-      FieldDataReader("BuildCache", old_build_cache_data.get_dict()),
-      report);
+  BuildCacheFile cache_file{};
+  const Error open_error = cache_file.open(build_cache_path);
+
+  if (open_error == Error::Ok)
+  {
+    s_current_cache = BuildCache::load(cache_file, GetProjectRootDirectory(), report);
+  }
+  else if (open_error == Error::InvalidType)
+  {
+    // written as text by an older version, rewritten as binary after this build
+    FieldVar old_build_cache_data;
+    try
+    { old_build_cache_data = FieldFile::load(build_cache_path); }
+    catch (const std::exception &e)
+    {
+      Logger::error("failed to load build cache: %s", e.what());
+      return { Error::FileNotFound, e.what() };
+    }
+
+    s_current_cache = BuildCache::load(
+        FieldDataReader("BuildCache", old_build_cache_data.get_dict()),
+        GetProjectRootDirectory(),
+        report);
+  }
+  else
+  {
+    return { Error::FileNotFound, "Build cache can't be read" };
+  }
 
   if (report.code != Error::Ok)
   {
@@ -870,11 +1315,147 @@ ErrorReport ProjectService::ReadBuildCache() {
     return report;
   }
 
+  const size_t replayed_count = BuildJournal::Replay(GetBuildJournalPath(), s_current_cache);
+  if (replayed_count > 0)
+  {
+    Logger::notify("recovered %llu object[s] of an interrupted build", replayed_count);
+  }
+
+  Toolchain::Load(s_current_cache);
   return {};
 }
 
+bool ProjectService::IsBuildManifestMatching() {
+  const FilePath manifest_path = GetBuildManifestPath();
+  if (!manifest_path.is_file())
+  {
+    return false;
+  }
+
+  const FieldVar manifest_data = FieldFile::load(manifest_path);
+  if (manifest_data.get_type() != FieldVarType::Dict)
+  {
+    return false;
+  }
+
+  ErrorReport report = {};
+  const BuildManifest manifest = BuildManifest::load(
+      FieldDataReader("BuildManifest", manifest_data.get_dict()), report);
+
+  if (report)
+  {
+    Logger::verbose("ignoring a broken build manifest: %s",
+                    to_cstr(report.message));
+    return false;
+  }
+
+  s_last_config_name = manifest.config_name;
+  if (manifest.config_name != s_current_config_name)
+  {
+    Logger::verbose("manifest: build mode changed from '%s'",
+                    manifest.config_name.c_str());
+    return false;
+  }
+
+  if (manifest.settings_hash != s_settings_hash)
+  {
+    Logger::verbose("manifest: settings changed");
+    return false;
+  }
+
+  if (manifest.toolchain_path_hash != Toolchain::GetPathHash())
+  {
+    Logger::verbose("manifest: $PATH changed");
+    return false;
+  }
+
+  return manifest.is_up_to_date();
+}
+
+void ProjectService::WriteBuildManifest() {
+  const FilePath manifest_path = GetBuildManifestPath();
+
+  // a stale manifest must never outlive the build it stamped
+  manifest_path.remove();
+
+  if (!IsBuildSuccessful() || s_linking_result_code != EOK ||
+      Settings::Get("no_cache", Settings::Get("clear_cache", false)))
+  {
+    return;
+  }
+
+  BuildManifest manifest = {};
+  manifest.config_name = s_current_config_name;
+  manifest.settings_hash = s_settings_hash;
+  manifest.toolchain_path_hash = s_current_cache.toolchain_path_hash;
+
+  // the signatures taken while scanning, a file edited during the build won't match
+  for (const auto &[path, record] : s_scan_records)
+  {
+    manifest.add(path, record.signature);
+  }
+
+  for (const auto &[_, obj_path] : s_source_io_map)
+  {
+    manifest.add(obj_path);
+  }
+
+  for (const auto &[_, record] : s_current_cache.toolchain_records)
+  {
+    manifest.add(record.path);
+  }
+
+  manifest.add(s_project_file);
+  manifest.add(s_project->get_output().get_result_path().resolved_copy());
+  manifest.add_directories(
+      s_project->source_dir.resolved_copy(),
+      { s_project->get_output().dir->resolved_copy(),
+        s_project->get_output().cache_dir->resolved_copy() });
+
+  if (manifest.has_invalid_signatures())
+  {
+    Logger::verbose("not writing the build manifest, some files are too new "
+                    "or missing");
+    return;
+  }
+
+  FieldFile::dump(manifest_path, manifest.write());
+}
+
 ErrorReport ProjectService::BuildSourceProcessor(SourceProcessor &processor) {
   processor.set_file_records(s_current_cache.file_records);
+  CPreprocessor::macro_table macros = BuildMacroTable();
+
+  // the macros redefined by the last build's files start unknown, so the files aren't
+  // scanned twice while the project still redefines them
+  for (const auto &[_, record] : s_current_cache.scan_records)
+  {
+    for (const string &name : record.redefined_macros)
+    {
+      const auto iter = macros.find(name);
+      if (iter != macros.end())
+      {
+        iter->second.redefined = true;
+      }
+    }
+  }
+
+  s_scan_macros_hash = CPreprocessor::hash_macros(macros);
+
+  // the includes depend on the macros, scans with different macros can't be reused
+  if (s_current_cache.scan_macros_hash == s_scan_macros_hash)
+  {
+    processor.set_scan_records(s_current_cache.scan_records);
+  }
+  else
+  {
+    Logger::verbose("the predefined macros changed, scanning every file again");
+  }
+
+  processor.set_macros(std::move(macros));
+  processor.set_root_directory(GetProjectRootDirectory());
+  processor.set_job_pool(&GetJobPool());
+  processor.set_batch_io(&GetBatchIO());
 
   for (const FilePath &path : s_current_config->include_directories.field())
   {
@@ -891,39 +1472,212 @@ ErrorReport ProjectService::BuildSourceProcessor(SourceProcessor &processor) {
   return { Error::Ok };
 }
 
+CPreprocessor::macro_table ProjectService::BuildMacroTable() {
+  static constexpr SourceFileType Languages[] = { SourceFileType::C, SourceFileType::CPP };
+
+  CPreprocessor::macro_table macros{};
+
+  // the compilers are only queried when the configuration (or a compiler) changed, the
+  // last build's table is of the same otherwise
+  if (s_cache_loaded && IsConfigHashMatching() && !s_current_cache.scan_macros.empty())
+  {
+    s_scan_macros = s_current_cache.scan_macros;
+    for (const auto &[name, record] : s_scan_macros)
+    {
+      CPreprocessor::Macro macro{};
+      macro.defined = record.defined;
+      macro.value = record.value;
+      macros.insert_or_assign(name, macro);
+    }
+    return macros;
+  }
+
+  // a language that can't be queried can't be compiled either, so it's left out
+  vector<std::map<string, string>> language_macros{};
+  for (const SourceFileType language : Languages)
+  {
+    ArgumentList args{};
+    s_current_config->build_macro_query_arguments(args, language);
+
+    std::map<string, string> queried{};
+    if (Toolchain::QueryMacros(args, queried) == EOK)
+    {
+      language_macros.emplace_back(std::move(queried));
+    }
+  }
+
+  if (language_macros.empty())
+  {
+    Logger::warning("couldn't query the compilers' predefined macros, the includes in "
+                    "conditionals depending on them are all kept");
+
+    // only the configuration's predefines are known
+    for (const auto &[name, value] : s_current_config->predefines.field())
+    {
+      CPreprocessor::Macro macro{};
+      macro.defined = true;
+      macro.value = value.is_null() ? "1" : value.copy_stringified().get_string();
+      macros.insert_or_assign(name, macro);
+    }
+    return macros;
+  }
+
+  // a header is scanned once for every language, so only the macros
+  // all the compilers define the same are known
+  for (const auto &[name, value] : language_macros.front())
+  {
+    const bool agreed = std::all_of(
+        language_macros.begin() + 1, language_macros.end(), [&](const auto &other) {
+          const auto iter = other.find(name);
+          return iter != other.end() && iter->second == value;
+        });
+
+    if (agreed)
+    {
+      CPreprocessor::Macro macro{};
+      macro.defined = true;
+      macro.value = value;
+      macros.insert_or_assign(name, macro);
+    }
+  }
+
+  for (const char *name : CPreprocessor::CompilerOwnedMacros)
+  {
+    const bool undefined = std::none_of(language_macros.begin(),
+                                        language_macros.end(),
+                                        [name](const auto &other) { return other.contains(name); });
+
+    if (undefined)
+    {
+      macros.insert_or_assign(name, CPreprocessor::Macro{});
+    }
+  }
+
+  s_scan_macros.clear();
+  for (const auto &[name, macro] : macros)
+  {
+    s_scan_macros.insert_or_assign(name, BuildCache::MacroRecord{ macro.defined, macro.value });
+  }
+
+  return macros;
+}
+
 ErrorReport ProjectService::SetupSourceProperties(SourceProcessor &processor) {
   s_source_io_map.clear();
   s_hanging_source_files.clear();
   s_hash_mismatched_source_files.clear();
   s_unrecorded_source_files.clear();
 
+  vector<FilePath> obj_paths{};
   for (const auto &inputs : processor.get_inputs())
   {
     s_source_files.emplace_back(inputs.path.resolved_copy());
     const auto &[emplaced_io, _] = s_source_io_map.emplace(
-        s_source_files.back(),
-        GetCompiledOutputPath(inputs.path, processor.get_file_hash(inputs.path))
-            .resolved_copy());
+        s_source_files.back(), GetCompiledOutputPath(inputs.path).resolved_copy());
+
+    obj_paths.push_back(emplaced_io->second);
+  }
+
+  MigrateObjects(obj_paths);
 
-    if (!emplaced_io->second.is_file() || emplaced_io->second.is_empty())
+  // the objects are stat-ed in a batch, the ones still matching their recorded signature
+  // (with a sane header) keep their recorded hash, only the others are read & hashed
+  vector<FileSignature> obj_signatures{};
+  GetBatchIO().stat(obj_paths, obj_signatures);
+
+  vector<size_t> recorded_objs{};
+  vector<size_t> changed_objs{};
+  for (size_t i = 0; i < obj_paths.size(); i++)
+  {
+    if (!obj_signatures[i].is_valid() || obj_signatures[i].size == 0)
     {
-      s_hanging_source_files.push_back(emplaced_io->first);
+      s_hanging_source_files.push_back(s_source_files[i]);
       continue;
     }
 
-    auto obj_hash = build_tools::GetFileHash(emplaced_io->second.c_str());
-    if (obj_hash == 0)
+    const auto record_iter = s_current_cache.file_records.find(s_source_files[i]);
+    const bool recorded = record_iter != s_current_cache.file_records.end() &&
+                          record_iter->second.obj_hash != 0 &&
+                          record_iter->second.output_path == obj_paths[i] &&
+                          record_iter->second.obj_signature == obj_signatures[i];
+
+    (recorded ? recorded_objs : changed_objs).push_back(i);
+  }
+
+  vector<hash_t> obj_hashes(obj_paths.size(), 0);
+
+  // an object truncated or overwritten behind a restored signature fails the header check
+  vector<FilePath> header_paths{};
+  for (const size_t i : recorded_objs)
+  {
+    header_paths.push_back(obj_paths[i]);
+  }
+
+  GetBatchIO().read(
+      header_paths,
+      [&recorded_objs, &obj_hashes](size_t index, const StrBlob &header, bool success) {
+        const size_t obj_index = recorded_objs[index];
+        if (success && build_tools::IsObjectHeaderSane(header))
+        {
+          obj_hashes[obj_index] =
+              s_current_cache.file_records.at(s_source_files[obj_index]).obj_hash;
+        }
+      },
+      build_tools::ObjectHeaderSize);
+
+  size_t verified_count = 0;
+  for (const size_t i : recorded_objs)
+  {
+    if (obj_hashes[i] == 0)
     {
+      changed_objs.push_back(i);
       continue;
     }
+    verified_count++;
+  }
+
+  Logger::verbose("objects verified by signature: %llu, hashed: %llu",
+                  verified_count,
+                  changed_objs.size());
 
-    s_obj_files_hashes_map.emplace(emplaced_io->second, obj_hash);
-    s_source2obj_files_hashes_map.emplace(emplaced_io->first, obj_hash);
+  vector<FilePath> changed_paths{};
+  for (const size_t i : changed_objs)
+  {
+    changed_paths.push_back(obj_paths[i]);
   }
 
-  for (const auto &[path, info] : processor.get_dependency_info_map())
+  GetBatchIO().read(
+      changed_paths,
+      [&changed_objs, &obj_hashes](size_t index, const StrBlob &content, bool success) {
+        if (success)
+        {
+          obj_hashes[changed_objs[index]] = HashTools::hash(content, 0);
+        }
+      });
+
+  for (size_t i = 0; i < obj_paths.size(); i++)
   {
-    s_source_files_hashes_map.emplace(path, info.hash);
+    if (!obj_signatures[i].is_valid() || obj_signatures[i].size == 0)
+    {
+      continue;
+    }
+
+    if (obj_hashes[i] == 0)
+    {
+      Logger::error("No File to hash at '%s'", obj_paths[i].c_str());
+      continue;
+    }
+
+    s_obj_files_hashes_map.emplace(obj_paths[i], obj_hashes[i]);
+    s_source2obj_files_hashes_map.emplace(s_source_files[i], obj_hashes[i]);
+    s_source2obj_signatures_map.emplace(s_source_files[i], obj_signatures[i]);
+  }
+
+  const DependencyGraph &graph = processor.get_graph();
+  for (DependencyGraph::file_id id = 0; id < graph.size(); id++)
+  {
+    s_source_files_hashes_map.emplace(graph.get_path(id),
+                                      graph.get_node(id).hash);
   }
 
   for (const auto &path : s_source_files)
@@ -999,15 +1753,27 @@ ErrorReport ProjectService::SetupBuildCommand(
   const hash_t &hash = s_source_files_hashes_map.at(source_path);
   // fully intended to not use tha `at()` function VVVVVVVVVVVVVVVVVV
   const hash_t &obj_hash = s_source2obj_files_hashes_map[source_path];
+  const FileSignature &obj_signature = s_source2obj_signatures_map[source_path];
 
   const FileStats file_stats = { source_path };
 
   BuildCache::FileRecord record;
   record.hash = hash;
   record.obj_hash = obj_hash;
+  record.obj_signature = obj_signature;
   record.output_path = output_path;
   record.source_write_time = file_stats.last_write_time.count();
 
+  // keep the timing history, it's updated only when the source gets compiled
+  const auto old_record_iter = s_current_cache.file_records.find(source_path);
+  if (old_record_iter != s_current_cache.file_records.end())
+  {
+    record.build_wall_time = old_record_iter->second.build_wall_time;
+    record.build_user_time = old_record_iter->second.build_user_time;
+    record.build_system_time = old_record_iter->second.build_system_time;
+    record.build_failed = old_record_iter->second.build_failed;
+  }
+
   s_updated_cache.override_old_source_record(source_path, record);
 
   Logger::verbose("adding \"%s\" -> \"%s\" to the build force",
@@ -1024,18 +1790,202 @@ ErrorReport ProjectService::SetupBuildCommand(
   cmd_info.in_path = source_path;
   cmd_info.out_path = output_path;
 
-  s_current_config->build_arguments(cmd_info.args,
-                                    source_path.get_text(),
-                                    output_path.get_text(),
-                                    file_type);
+  GetArgumentTemplate(file_type).instantiate(cmd_info.args,
+                                             source_path.c_str(),
+                                             output_path.c_str());
+
+  const hash_t compiler_fingerprint = Toolchain::GetFingerprint(
+      BuildConfiguration::get_compiler_name(s_current_config->compiler_type.field(), file_type));
+  s_source2store_keys_map.insert_or_assign(
+      source_path,
+      ObjectStore::MakeKey(hash,
+                           cmd_info.args,
+                           output_path.c_str(),
+                           GetProjectRootDirectory(),
+                           compiler_fingerprint));
 
   cmd_info.name = source_path.c_str();
-  cmd_info.flags |= build_tools::eExcFlag_Printout;
+  cmd_info.flags |= build_tools::eExcFlag_Printout | build_tools::eExcFlag_Timeout;
   cmd_info.out = &std::cout;
   return {};
 }
 
+bool ProjectService::FetchStoredObject(const build_tools::BuildCommandInfo &cmd_info) {
+  // a forced rebuild compiles everything
+  if (s_forced_rebuild || !ObjectStore::IsEnabled())
+  {
+    return false;
+  }
+
+  const hash_t key = s_source2store_keys_map.at(cmd_info.in_path);
+  if (!ObjectStore::Fetch(key, cmd_info.out_path))
+  {
+    return false;
+  }
+
+  build_tools::OutputDigest digest{};
+  build_tools::DigestOutput(cmd_info.out_path, digest);
+  if (digest.hash == 0)
+  {
+    return false;
+  }
+
+  BuildCache::FileRecord &record = s_updated_cache.file_records.at(cmd_info.in_path);
+  record.obj_hash = digest.hash;
+  record.obj_signature = digest.signature;
+  record.build_failed = false;
+
+  Logger::verbose("materialized '%s' from the object store [%llX]",
+                  cmd_info.out_path.c_str(),
+                  key);
+  s_fetched_objects_count++;
+  return true;
+}
+
+const ArgumentTemplate &ProjectService::GetArgumentTemplate(
+    SourceFileType type) {
+  auto iter = s_argument_templates.find(type);
+  if (iter != s_argument_templates.end())
+  {
+    return iter->second;
+  }
+
+  ArgumentTemplate arg_template = s_current_config->build_argument_template(type);
+
+  // the objects don't record where the project is (the debug info & `__FILE__` see '.'), so
+  // they're the same in every checkout, msvc has no such option
+  const string root_directory = GetProjectRootDirectory();
+  std::string_view root = root_directory;
+  if (root.ends_with(FilePath::DirectorySeparator))
+  {
+    root.remove_suffix(1);
+  }
+
+  if (!root.empty() && s_current_config->compiler_type.field() != CompilerType::MSVC)
+  {
+    // the working directory is the debug info's compile directory
+    std::string_view working_directory = FilePath::get_working_directory().c_str();
+    if (working_directory.ends_with(FilePath::DirectorySeparator))
+    {
+      working_directory.remove_suffix(1);
+    }
+
+    if (!working_directory.empty() && working_directory != root)
+    {
+      arg_template.push_back(format_join("-fdebug-prefix-map=", working_directory, "=."));
+    }
+
+    // the last matching map is used, the project's files are mapped by this one
+    arg_template.push_back(format_join("-ffile-prefix-map=", root, "=."));
+  }
+
+  return s_argument_templates.emplace(type, std::move(arg_template)).first->second;
+}
+
+void ProjectService::ScheduleBuildCommands(const BuildSchedulePolicy policy) {
+  typedef build_tools::BuildCommandInfo cmd_info;
+
+  if (policy == BuildSchedulePolicy::None || s_used_build_commands.size() < 2)
+  {
+    return;
+  }
+
+  // sources with no recorded compile time are assumed to take the average time
+  t::microsecond_t known_time_sum = 0;
+  size_t known_time_count = 0;
+
+  for (const auto &[_, record] : s_current_cache.file_records)
+  {
+    if (record.build_wall_time > 0)
+    {
+      known_time_sum += record.build_wall_time;
+      known_time_count++;
+    }
+  }
+
+  const t::microsecond_t average_time =
+      known_time_count == 0
+          ? 0
+          : known_time_sum / t::microsecond_t(known_time_count);
+
+  const auto get_estimated_time = [average_time](const FilePath &path) {
+    const auto iter = s_current_cache.file_records.find(path);
+    if (iter == s_current_cache.file_records.end() ||
+        iter->second.build_wall_time <= 0)
+    {
+      return average_time;
+    }
+    return iter->second.build_wall_time;
+  };
+
+  const auto has_failed = [](const FilePath &path) {
+    const auto iter = s_current_cache.file_records.find(path);
+    return iter != s_current_cache.file_records.end() &&
+           iter->second.build_failed;
+  };
+
+  const auto get_write_time = [](const FilePath &path) -> t::microsecond_t {
+    const auto iter = s_updated_cache.file_records.find(path);
+    if (iter == s_updated_cache.file_records.end())
+    {
+      return 0;
+    }
+    return iter->second.source_write_time;
+  };
+
+  const auto longest_first = [&get_estimated_time](const cmd_info &left,
+                                                   const cmd_info &right) {
+    return get_estimated_time(left.in_path) > get_estimated_time(right.in_path);
+  };
+
+  const auto recent_first = [&get_write_time](const cmd_info &left,
+                                              const cmd_info &right) {
+    return get_write_time(left.in_path) > get_write_time(right.in_path);
+  };
+
+  const auto failed_first = [&has_failed, &longest_first](
+                                const cmd_info &left,
+                                const cmd_info &right) {
+    const bool left_failed = has_failed(left.in_path);
+    if (left_failed != has_failed(right.in_path))
+    {
+      return left_failed;
+    }
+    return longest_first(left, right);
+  };
+
+  auto &cmds = s_used_build_commands;
+
+  // stable, so the project order is kept between equals
+  switch (policy)
+  {
+  case BuildSchedulePolicy::LongestFirst:
+    std::stable_sort(cmds.begin(), cmds.end(), longest_first);
+    break;
+  case BuildSchedulePolicy::RecentlyModifiedFirst:
+    std::stable_sort(cmds.begin(), cmds.end(), recent_first);
+    break;
+  case BuildSchedulePolicy::FailedFirst:
+    std::stable_sort(cmds.begin(), cmds.end(), failed_first);
+    break;
+  default:
+    break;
+  }
+
+  if (Logger::is_verbose())
+  {
+    for (const auto &cmd : cmds)
+    {
+      Logger::verbose("scheduled '%s' [estimated %lld us]",
+                      cmd.name.c_str(),
+                      get_estimated_time(cmd.in_path));
+    }
+  }
+}
+
 ErrorReport ProjectService::DispatchBuildCommands(int *output_codes) {
+  ScheduleBuildCommands(GetBuildSchedulePolicy());
+
   /*
     diverting build output to independent streams, avoid parallel output
     shenanigans
@@ -1045,23 +1995,104 @@ ErrorReport ProjectService::DispatchBuildCommands(int *output_codes) {
   std::vector<std::ostringstream> build_output_streams{};
   build_output_streams.resize(count);
 
+  std::vector<ProcessUsage> build_usages{};
+  build_usages.resize(count);
+
+  // the rebuilt objects are hashed as their compiles exit
+  std::vector<build_tools::OutputDigest> obj_digests{};
+  obj_digests.resize(count);
+
   const auto *_old_build_output_streams_data = build_output_streams.data();
 
+  // every finished compile is journaled as it's object is hashed, an interrupted build
+  // keeps it's finished work
+  const std::function<void(const build_tools::BuildCommandInfo &)> journal_record =
+      [](const build_tools::BuildCommandInfo &cmd) {
+        const auto record_iter = s_updated_cache.file_records.find(cmd.in_path);
+        if (record_iter == s_updated_cache.file_records.end())
+        {
+          return;
+        }
+
+        BuildCache::FileRecord record = record_iter->second;
+        record.obj_hash = cmd.digest->hash;
+        record.obj_signature = cmd.digest->signature;
+        record.build_wall_time = cmd.usage->wall_time;
+        record.build_user_time = cmd.usage->user_time;
+        record.build_system_time = cmd.usage->system_time;
+        record.build_failed = false;
+        s_build_journal.append(cmd.in_path, record);
+      };
+
+  s_build_journal.open(GetBuildJournalPath(), s_updated_cache);
+
   // setting up
   for (size_t i = 0; i < count; i++)
   {
     s_used_build_commands[i].out = build_output_streams.data() + i;
+    s_used_build_commands[i].usage = build_usages.data() + i;
+    s_used_build_commands[i].digest = obj_digests.data() + i;
+    s_used_build_commands[i].on_digested = &journal_record;
+
+    // an object fetched by an older bgnu may be hardlinked to the object store, a compiler
+    // writing it in place would change the stored one too
+    s_used_build_commands[i].out_path.remove();
+    s_used_build_commands[i].out_path.parent().create_directory();
   }
 
   // building
   ErrorReport err =
       ExecuteBuildCommands(s_used_build_commands.data(), output_codes, count);
+  s_build_journal.close();
   if (err)
   {
     Logger::error(err);
     return err;
   }
 
+  const bool store_enabled = ObjectStore::IsEnabled();
+  size_t published_count = 0;
+
+  // recording the objects & the timings for the next build's scheduling, the new objects
+  // are published to the object store
+  for (size_t i = 0; i < count; i++)
+  {
+    s_used_build_commands[i].usage = nullptr;
+    s_used_build_commands[i].digest = nullptr;
+    s_used_build_commands[i].on_digested = nullptr;
+
+    const auto record_iter =
+        s_updated_cache.file_records.find(s_used_build_commands[i].in_path);
+    if (record_iter == s_updated_cache.file_records.end())
+    {
+      continue;
+    }
+
+    BuildCache::FileRecord &record = record_iter->second;
+    record.build_wall_time = build_usages[i].wall_time;
+    record.build_user_time = build_usages[i].user_time;
+    record.build_system_time = build_usages[i].system_time;
+    record.build_failed = output_codes[i] != EOK;
+
+    // a failed compile's leftover object (if any) never matches it's record, publishing copies
+    // the object (it's signature, journaled on the compile's exit, stays valid)
+    record.obj_hash = obj_digests[i].hash;
+    record.obj_signature = obj_digests[i].signature;
+
+    if (store_enabled && record.obj_hash != 0 &&
+        ObjectStore::Publish(s_source2store_keys_map.at(s_used_build_commands[i].in_path),
+                             s_used_build_commands[i].out_path))
+    {
+      published_count++;
+    }
+  }
+
+  if (published_count > 0)
+  {
+    // skipped while another build uses the store, a later build collects it
+    ObjectStore::Collect(ObjectStore::GetMaxSize(), false);
+  }
+
   // unloading
   std::vector<string> names{};
   for (const auto &cmd : s_used_build_commands)
@@ -1107,8 +2138,6 @@ ErrorReport ProjectService::ExecuteBuildCommands(
     size_t count) {
   const bool multithreaded =
       Settings::Get("build_multithreaded", false).get_bool();
-  const int64_t threads_count =
-      Settings::Get("build_jobs_count", (FieldVar::Int)8).get_int();
 
   const Blob<const build_tools::BuildCommandInfo> build_cmds_blob = { cmds,
                                                                       count };
@@ -1117,7 +2146,7 @@ ErrorReport ProjectService::ExecuteBuildCommands(
   if (multithreaded)
   {
     result_codes =
-        build_tools::Execute_Multithreaded(build_cmds_blob, threads_count);
+        build_tools::Execute_Multithreaded(build_cmds_blob, GetJobPool());
   }
   else
   {
@@ -1200,17 +2229,6 @@ ErrorReport ProjectService::ReportSourceBuildFailures() {
   return {};
 }
 
-void ProjectService::LoadObjectHashesToUpdatedCache() {
-  for (const auto &[in_path, out_path] : s_source_io_map)
-  {
-    if (out_path.is_file())
-    {
-      s_updated_cache.file_records.at(in_path).obj_hash =
-          build_tools::GetFileHash(out_path.c_str());
-    }
-  }
-}
-
 vector<StrBlob> ProjectService::GenerateLinkerInputs() {
   std::vector<StrBlob> result = {};
 
@@ -1240,17 +2258,7 @@ void ProjectService::DumpBuildCommands(
 
   for (size_t i = 0; i < count; i++)
   {
-    bool first = true;
-    for (const auto &arg : cmds[i].args)
-    {
-      if (!first)
-      {
-        stream << ' ';
-      }
-      first = false;
-      stream << arg;
-    }
-    stream << '\n';
+    stream << build_tools::JoinArguments(cmds[i].args) << '\n';
   }
 
   Logger::verbose("dumped the build argument list: size=%lld bytes to '%s'",
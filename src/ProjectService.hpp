@@ -5,14 +5,20 @@
 
 #include "Argument.hpp"
 #include "BuildCache.hpp"
+#include "BuildJournal.hpp"
+#include "BuildManifest.hpp"
 #include "BuildConfiguration.hpp"
 #include "BuildTools.hpp"
+#include "CacheBundle.hpp"
 #include "FilePath.hpp"
 #include "Project.hpp"
 #include "base.hpp"
 #include "code/SourceProcessor.hpp"
 #include "misc/Error.hpp"
 #include "misc/hash128.hpp"
+#include "utility/BatchIO.hpp"
+#include "utility/FileLock.hpp"
+#include "utility/JobPool.hpp"
 
 enum class BuildStep : uint8_t {
   None,
@@ -32,6 +38,19 @@ enum class BuildStep : uint8_t {
   PostLinking
 };
 
+// the order in which the compile commands are dispatched,
+// picked by the 'build_schedule_policy' setting
+enum class BuildSchedulePolicy : uint8_t {
+  // project order
+  None,
+  // longest (last known) compile time first, shrinks the total build time
+  LongestFirst,
+  // most recently modified sources first, errors show up quickly
+  RecentlyModifiedFirst,
+  // sources that failed the last time first, then longest first
+  FailedFirst,
+};
+
 class ProjectService
 {
 public:
@@ -65,10 +84,22 @@ public:
 
   static Error DumpAvailableBuildCommands();
 
+  // packs the current configuration's build cache & objects into the bundle at `path`, the
+  // cache must be from the last build of the project as it is now
+  static Error ExportCache(const FilePath &path);
+  // replaces the current configuration's build cache & objects with the bundle's at `path`,
+  // the bundle must be made for the same project, configuration & toolchain
+  static Error ImportCache(const FilePath &path);
+
   static Project *GetProject() { return s_project.get(); }
   static const BuildConfiguration *GetBuildConfig() { return s_current_config; }
   static const string &GetBuildConfigName() { return s_current_config_name; }
 
+  // the persistent worker pool, sized by the 'build_jobs_count' setting
+  static JobPool &GetJobPool();
+  // batches the file system requests of the main thread, runs on the job pool
+  static BatchIO &GetBatchIO();
+
   static const FilePath &GetProjectFile() { return s_project_file; }
   static const FilePath &GetBuildDir() { return s_build_directory; }
 
@@ -78,22 +109,58 @@ public:
     return s_forced_rebuild || !s_cache_loaded || s_hash_mismatched;
   }
 
+  // the build manifest matched, the build steps after loading the caches are skipped
+  static inline bool IsUpToDate() { return s_up_to_date; }
+
   static inline bool IsFullBuild() {
     return s_final_step == BuildStep::PostLinking;
   }
 
   static inline BuildStep GetStep() { return s_current_step; }
 
+  // every configuration has it's own objects & build cache under `<cache>/<config>/`,
+  // switching configurations doesn't invalidate the others
+  static FilePath GetConfigCacheDirectory();
+
+  // the project's directory, ending with a separator, the build cache stores the paths under
+  // it relative to it & the compilers map it to '.' (see `BuildCache::root_directory`)
+  static string GetProjectRootDirectory();
+
+  // held by the build of the configuration, next to (not in) it's cache directory as a
+  // rebuild deletes that
+  static FilePath GetConfigLockPath();
+
+  // held by the build linking the output binary & writing the build manifest, shared by
+  // every configuration
+  static inline FilePath GetOutputLockPath() {
+    return s_project->get_output().dir->join_path(".lock");
+  }
+
   static inline FilePath GetBuildCachePath() {
+    return GetConfigCacheDirectory().join_path(".build");
+  }
+
+  // the records of the compiles finished since the build cache was written
+  static inline FilePath GetBuildJournalPath() {
+    return GetConfigCacheDirectory().join_path(".journal");
+  }
+
+  // where the build cache was kept before it was split by configuration
+  static inline FilePath GetLegacyBuildCachePath() {
     return s_project->get_output().dir->join_path(".build");
   }
 
-  static FilePath GetCompiledOutputPath(const FilePath &path, hash_t hash);
+  static inline FilePath GetBuildManifestPath() {
+    return s_project->get_output().dir->join_path(".manifest");
+  }
+
+  static FilePath GetCompiledOutputPath(const FilePath &path);
   static size_t GetBuildFailureCount();
   static size_t GetBuildSuccessCount();
   static inline bool IsBuildSuccessful() { return GetBuildFailureCount() == 0; }
 
   static const char *GetStepName(BuildStep step);
+  static BuildSchedulePolicy GetBuildSchedulePolicy();
   static FilePath GetLinkOutputPath();
   static std::string GetDefaultConfigName();
 
@@ -108,15 +175,39 @@ private:
   static ErrorReport SetupConfigArgs(ArgumentSource &src);
   static ErrorReport SetupConfig();
 
+  // the cache directory's name of the current configuration
+  static string GetConfigDirectoryName();
+  // takes `lock` exclusively, waiting (& saying so) for the other build holding it, the build
+  // goes on unlocked if the lock file can't be opened
+  static void AcquireBuildLock(FileLock &lock, const FilePath &path, const string &holder_name);
+  // what the current configuration's cache is built with, checked by a cache bundle import
+  static CacheBundle::Fingerprints GetCacheFingerprints();
+
   static ErrorReport ReadBuildCache();
+  // true if nothing changed since the last successful full build
+  static bool IsBuildManifestMatching();
+  static void WriteBuildManifest();
   static ErrorReport BuildSourceProcessor(SourceProcessor &processor);
+  // the macros the sources' conditionals are evaluated with, queried from the compilers (only
+  // when the configuration or a compiler changed, the last build's table is kept otherwise)
+  static CPreprocessor::macro_table BuildMacroTable();
   static ErrorReport SetupSourceProperties(SourceProcessor &processor);
 
   static ErrorReport PopulateSourceFilesToBuild();
 
+  // moves the objects of the old (flat, colliding) layout to their paths, unless their name
+  // was shared by other sources
+  static void MigrateObjects(const vector<FilePath> &obj_paths);
   static ErrorReport SetupBuildCommand(const FilePath &source_path,
                                        build_tools::BuildCommandInfo &cmd_info);
-
+  // materializes the source's object from the object store, recording it, returns false on
+  // a miss
+  static bool FetchStoredObject(const build_tools::BuildCommandInfo &cmd_info);
+  // the current config's compile arguments for `type`, built on first use
+  static const ArgumentTemplate &GetArgumentTemplate(SourceFileType type);
+
+  // reorders the used build commands per `policy`
+  static void ScheduleBuildCommands(BuildSchedulePolicy policy);
   static ErrorReport DispatchBuildCommands(int *output_codes);
   static ErrorReport ExecuteBuildCommands(
       const build_tools::BuildCommandInfo *cmds,
@@ -129,8 +220,6 @@ private:
 
   static ErrorReport ReportSourceBuildFailures();
 
-  static void LoadObjectHashesToUpdatedCache();
-
   static vector<StrBlob> GenerateLinkerInputs();
   static void DumpBuildCommands(const build_tools::BuildCommandInfo *cmds,
                                 size_t count);
@@ -156,11 +245,27 @@ private:
   static vector<FilePath> s_compile_needed_source_files;
   static vector<build_tools::BuildCommandInfo> s_total_build_commands;
   static vector<build_tools::BuildCommandInfo> s_used_build_commands;
+  static std::map<SourceFileType, ArgumentTemplate> s_argument_templates;
   static vector<int> s_source_build_result_codes;
   static std::map<FilePath, FilePath> s_source_io_map;
   static std::map<FilePath, hash_t> s_source_files_hashes_map;
   static std::map<FilePath, hash_t> s_obj_files_hashes_map;
   static std::map<FilePath, hash_t> s_source2obj_files_hashes_map;
+  // the signatures the objects were verified (or hashed) with
+  static std::map<FilePath, FileSignature> s_source2obj_signatures_map;
+  // the object store keys of the sources' objects, see `ObjectStore`
+  static std::map<FilePath, hash_t> s_source2store_keys_map;
+  // the objects materialized from the object store instead of compiled
+  static size_t s_fetched_objects_count;
+  // the configuration the last build (it's manifest) was made with, the output binary is
+  // linked again when it was linked by another one
+  static string s_last_config_name;
+  // the source processor's scans, written to the updated cache
+  static BuildCache::scan_record_table s_scan_records;
+  // the hash of the macros `s_scan_records` were scanned with
+  static hash_t s_scan_macros_hash;
+  // the compilers' macros `s_scan_macros_hash` is made from (before the project's redefinitions)
+  static BuildCache::macro_record_table s_scan_macros;
 
   static build_tools::BuildCommandInfo s_linking_build_cmd;
   static int s_linking_result_code;
@@ -168,11 +273,24 @@ private:
   static FilePath s_project_file;
   static FilePath s_build_directory;
 
+  static std::unique_ptr<JobPool> s_job_pool;
+  static std::unique_ptr<BatchIO> s_batch_io;
+
   static BuildCache s_current_cache;
   static BuildCache s_updated_cache;
+  // open while the build commands run
+  static BuildJournal s_build_journal;
+  // the other writing builds of the configuration wait for it's build to end, readers never
+  // lock (every cache file is replaced atomically)
+  static FileLock s_config_lock;
+  // from linking to writing the build manifest
+  static FileLock s_output_lock;
 
   static bool s_cache_loaded;
   static bool s_forced_rebuild;
   static bool s_resave_required;
   static bool s_hash_mismatched;
+  static bool s_up_to_date;
+  // the settings hash before building, stamped into the build manifest
+  static hash_t s_settings_hash;
 };
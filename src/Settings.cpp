@@ -3,6 +3,7 @@
 #include "FieldDataReader.hpp"
 #include "FieldFile.hpp"
 #include "FilePath.hpp"
+#include "HashTools.hpp"
 #include "StringTools.hpp"
 
 typedef std::map<std::string, SettingValue> SettingMap;
@@ -104,6 +105,10 @@ const FieldVar &Settings::Get(const std::string &name,
   return GetSettingInnerValue(name, default_val);
 }
 
+hash_t Settings::Hash() {
+  return HashTools::hash(FieldFile::write(Serialize()));
+}
+
 void Settings::Set(const std::string &name, const FieldVar &value) {
   throw std::runtime_error("unimplemented");
 }
@@ -31,6 +31,9 @@ public:
   static void Set(const std::string &name, const FieldVar &value);
   static const FieldVar &Reset(const std::string &name);
 
+  // hash of the current settings (including the requested defaults added so far)
+  static hash_t Hash();
+
   // defaults to false
   static bool s_SilentSaveFail;
 
@@ -0,0 +1,190 @@
+#include "Toolchain.hpp"
+
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include "Logger.hpp"
+#include "utility/FileStats.hpp"
+#include "utility/Process.hpp"
+
+static std::mutex s_mutex;
+// the compilers resolved by this run
+static std::map<std::string, Toolchain::Record> s_records;
+// the records from the older cache, if they were resolved under the same $PATH
+static std::map<std::string, Toolchain::Record> s_old_records;
+
+void Toolchain::Load(const BuildCache &cache) {
+  std::lock_guard guard{ s_mutex };
+
+  s_old_records.clear();
+  if (cache.toolchain_path_hash != GetPathHash())
+  {
+    Logger::verbose("toolchain: $PATH changed, resolving the compilers again");
+    return;
+  }
+
+  for (const auto &[name, record] : cache.toolchain_records)
+  {
+    s_old_records.insert_or_assign(name, record);
+  }
+}
+
+void Toolchain::Store(BuildCache &cache) {
+  std::lock_guard guard{ s_mutex };
+
+  cache.toolchain_path_hash = GetPathHash();
+  cache.toolchain_records.clear();
+  for (const auto &[name, record] : s_records)
+  {
+    cache.toolchain_records.insert_or_assign(name, record);
+  }
+}
+
+void Toolchain::Clear() {
+  std::lock_guard guard{ s_mutex };
+
+  s_records.clear();
+  s_old_records.clear();
+}
+
+const Toolchain::Record *Toolchain::Get(const std::string &name) {
+  std::lock_guard guard{ s_mutex };
+
+  const auto iter = s_records.find(name);
+  if (iter != s_records.end())
+  {
+    return iter->second.path.empty() ? nullptr : &iter->second;
+  }
+
+  Record record{};
+
+  const auto old_iter = s_old_records.find(name);
+  if (old_iter != s_old_records.end() && IsRecordValid(old_iter->second))
+  {
+    record = old_iter->second;
+  }
+  else if (Resolve(record, name) != EOK)
+  {
+    // remembered as not found, so it's not searched for again
+    record = {};
+  }
+
+  const Record &result = s_records.insert_or_assign(name, record).first->second;
+  return result.path.empty() ? nullptr : &result;
+}
+
+hash_t Toolchain::GetFingerprint(const std::string &name) {
+  const Record *record = Get(name);
+  return record ? record->fingerprint : 0;
+}
+
+hash_t Toolchain::GetPathHash() {
+  const char *path_env = getenv("PATH");
+  return path_env ? HashTools::hash(std::string(path_env)) : 0;
+}
+
+errno_t Toolchain::QueryMacros(const ArgumentList &args,
+                               std::map<std::string, std::string> &macros) {
+  Process process{ args };
+  process.set_flags(Process::Flag_InheritEnv);
+
+  std::ostringstream output{};
+  if (process.start(&output) != 0)
+  {
+    Logger::verbose("toolchain: failed to query the predefined macros of '%s'",
+                    process.get_name().c_str());
+    return ECHILD;
+  }
+
+  static constexpr std::string_view DefinePrefix = "#define ";
+
+  std::istringstream lines{ output.str() };
+  std::string line{};
+  while (std::getline(lines, line))
+  {
+    // anything else is a diagnostic
+    if (!line.starts_with(DefinePrefix))
+    {
+      continue;
+    }
+
+    const size_t name_end = line.find_first_of(" (\r", DefinePrefix.size());
+    // function-like macros aren't expanded while scanning
+    if (name_end != std::string::npos && line[name_end] == '(')
+    {
+      continue;
+    }
+
+    std::string name = line.substr(DefinePrefix.size(), name_end - DefinePrefix.size());
+    std::string value =
+        name_end == std::string::npos || line[name_end] != ' ' ? "" : line.substr(name_end + 1);
+    if (!value.empty() && value.back() == '\r')
+    {
+      value.pop_back();
+    }
+
+    macros.insert_or_assign(std::move(name), std::move(value));
+  }
+
+  return EOK;
+}
+
+bool Toolchain::IsRecordValid(const Record &record) {
+  if (record.path.empty() || !record.path.is_file())
+  {
+    return false;
+  }
+
+  const FileStats stats{ record.path };
+  return int64_t(stats.size) == record.size &&
+         stats.last_write_time.count() == record.write_time;
+}
+
+errno_t Toolchain::Resolve(Record &record, const std::string &name) {
+  const FilePath path = FilePath::FindExecutableInPATHEnv(name);
+  if (path.empty())
+  {
+    Logger::verbose("toolchain: '%s' not found in $PATH", name.c_str());
+    return ENOENT;
+  }
+
+  const FileStats stats{ path };
+
+  record.path = path;
+  record.size = int64_t(stats.size);
+  record.write_time = stats.last_write_time.count();
+  record.version = QueryVersion(path);
+  record.fingerprint = HashTools::combine(path.hash(),
+                                          hash_t(record.size),
+                                          hash_t(record.write_time),
+                                          HashTools::hash(record.version));
+
+  Logger::verbose("toolchain: resolved '%s' to '%s' (%s)",
+                  name.c_str(),
+                  record.path.c_str(),
+                  record.version.c_str());
+  return EOK;
+}
+
+std::string Toolchain::QueryVersion(const FilePath &path) {
+  Process process{ ArgumentList{ path.c_str(), "--version" } };
+  process.set_flags(Process::Flag_InheritEnv);
+
+  std::ostringstream output{};
+  if (process.start(&output) != 0)
+  {
+    Logger::warning("toolchain: failed to query the version of '%s'",
+                    path.c_str());
+    return {};
+  }
+
+  std::string version = output.str();
+  const size_t line_end = version.find_first_of("\r\n");
+  if (line_end != std::string::npos)
+  {
+    version.resize(line_end);
+  }
+
+  return version;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <map>
+#include <string>
+
+#include "BuildCache.hpp"
+#include "base.hpp"
+#include "utility/ArgumentList.hpp"
+
+// resolves the compilers from $PATH once per run & fingerprints them
+//
+// the resolved compilers are persisted in the build cache (keyed by the $PATH they were
+// resolved under), so a later run only has to stat a compiler to reuse it's record,
+// and a changed compiler (upgraded, different $PATH) changes the configuration hash
+class Toolchain
+{
+public:
+  typedef BuildCache::ToolchainRecord Record;
+
+  Toolchain() = delete;
+
+  // takes the records from an older cache, they are reused while
+  // the $PATH & the compilers' size/write time didn't change
+  static void Load(const BuildCache &cache);
+  // writes the records resolved by this run to `cache`
+  static void Store(BuildCache &cache);
+
+  static void Clear();
+
+  // resolves the compiler named `name`, returns null if it's not found
+  static const Record *Get(const std::string &name);
+
+  // zero if the compiler is not found
+  static hash_t GetFingerprint(const std::string &name);
+
+  static hash_t GetPathHash();
+
+  // runs a compiler with `args` (that make it dump it's predefined macros, '-dM -E') and
+  // reads the macros' names & values
+  static errno_t QueryMacros(const ArgumentList &args,
+                             std::map<std::string, std::string> &macros);
+
+private:
+  static bool IsRecordValid(const Record &record);
+  static errno_t Resolve(Record &record, const std::string &name);
+  static std::string QueryVersion(const FilePath &path);
+};
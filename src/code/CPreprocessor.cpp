@@ -1,6 +1,12 @@
 #include "CPreprocessor.hpp"
 
+#include <algorithm>
+#include <map>
+#include <optional>
+
 #include "CodeTokenizer.hpp"
+#include "DirectiveScanner.hpp"
+#include "HashTools.hpp"
 
 constexpr auto whitespace_no_newlines = [](char cur) {
   return string_tools::is_whitespace(cur) && !string_tools::is_newline(cur);
@@ -265,3 +271,872 @@ string CPreprocessor::_escape(const StrBlob &source) {
 
 CPreprocessor::Token::Token(const string &name, const string &value)
     : type{ _get_tk_type({ name.c_str(), name.length() }) }, value{ value } {}
+
+// how deep object-like macros are expanded in a conditional, deeper ones are unknown
+static constexpr int MaxExpansionDepth = 32;
+
+static inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static inline bool IsIdentifierStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool IsIdentifierChar(char c) {
+  return IsIdentifierStart(c) || IsDigit(c);
+}
+
+// a conditional's truth, unknown if it depends on a macro that's not known
+enum class ConditionTruth : uint8_t {
+  False,
+  True,
+  Unknown
+};
+
+struct ConditionFrame
+{
+  inline ConditionTruth state() const {
+    if (enclosing == ConditionTruth::False || branch == ConditionTruth::False)
+    {
+      return ConditionTruth::False;
+    }
+    if (enclosing == ConditionTruth::Unknown || branch == ConditionTruth::Unknown)
+    {
+      return ConditionTruth::Unknown;
+    }
+    return ConditionTruth::True;
+  }
+
+  // enters the next branch ('#elif'/'#else'), `truth` is the branch's own condition
+  inline void next_branch(ConditionTruth truth) {
+    if (taken)
+    {
+      branch = ConditionTruth::False;
+      return;
+    }
+
+    branch = truth;
+    if (maybe_taken && truth == ConditionTruth::True)
+    {
+      // only taken if the unknown branches before it aren't
+      branch = ConditionTruth::Unknown;
+    }
+
+    taken = truth == ConditionTruth::True;
+    maybe_taken = maybe_taken || truth == ConditionTruth::Unknown;
+  }
+
+  // the state of the enclosing branch
+  ConditionTruth enclosing = ConditionTruth::True;
+  ConditionTruth branch = ConditionTruth::True;
+  // a previous branch (or this one) is definitely taken
+  bool taken = false;
+  // a previous branch (or this one) might be taken
+  bool maybe_taken = false;
+};
+
+// the macros of a file being scanned, on top of the known macros
+class MacroScope
+{
+public:
+  inline MacroScope(const CPreprocessor::macro_table &macros) : m_macros{ macros } {}
+
+  // null if the macro is unknown
+  inline const CPreprocessor::Macro *find(const std::string_view &name) const {
+    m_key.assign(name);
+
+    const auto local_iter = m_locals.find(m_key);
+    if (local_iter != m_locals.end())
+    {
+      return local_iter->second.has_value() ? &*local_iter->second : nullptr;
+    }
+
+    const auto iter = m_macros.find(m_key);
+    return iter != m_macros.end() && !iter->second.redefined ? &iter->second : nullptr;
+  }
+
+  inline void set(const std::string_view &name, const CPreprocessor::Macro &macro) {
+    m_locals.insert_or_assign(string(name), macro);
+  }
+
+  // defined/undefined in a branch that might not be taken
+  inline void set_unknown(const std::string_view &name) {
+    m_locals.insert_or_assign(string(name), std::nullopt);
+  }
+
+private:
+  const CPreprocessor::macro_table &m_macros;
+  std::unordered_map<string, std::optional<CPreprocessor::Macro>> m_locals;
+  mutable string m_key;
+};
+
+// an integer in a conditional, unknown if it depends on a macro that's not known
+struct ConditionValue
+{
+  int64_t value = 0;
+  bool known = false;
+};
+
+static constexpr ConditionValue UnknownValue = {};
+
+// evaluates the expression of an '#if'/'#elif', any part depending on an unknown macro
+// (or that's not supported) is unknown, so are the parts depending on it
+class ConditionEvaluator
+{
+public:
+  typedef ConditionValue Value;
+
+  inline ConditionEvaluator(const std::string_view &expression, const MacroScope &scope,
+                            const CPreprocessor::include_resolver &resolver, int depth = 0)
+      : m_cursor{ expression.data() }, m_end{ expression.data() + expression.size() },
+        m_scope{ scope }, m_resolver{ resolver }, m_depth{ depth } {}
+
+  inline ConditionTruth evaluate() {
+    const Value value = _conditional();
+    if (m_failed || !_at_end() || !value.known)
+    {
+      return ConditionTruth::Unknown;
+    }
+    return value.value != 0 ? ConditionTruth::True : ConditionTruth::False;
+  }
+
+  // evaluates a macro's replacement, which should be a single operand ('1', '-1', '(A + 1)')
+  // so it's value doesn't depend on the operators around it
+  inline Value evaluate_operand() {
+    const Value value = _unary();
+    if (m_failed || !_at_end())
+    {
+      return {};
+    }
+    return value;
+  }
+
+private:
+  static inline Value Known(int64_t value) { return { value, true }; }
+
+  // operator, precedence (higher binds tighter), zero if not a binary operator
+  static inline int Precedence(const std::string_view &op) {
+    static constexpr pair<std::string_view, int> Operators[] = {
+      { "||", 1 }, { "&&", 2 }, { "|", 3 },  { "^", 4 },  { "&", 5 },
+      { "==", 6 }, { "!=", 6 }, { "<", 7 },  { ">", 7 },  { "<=", 7 },
+      { ">=", 7 }, { "<<", 8 }, { ">>", 8 }, { "+", 9 },  { "-", 9 },
+      { "*", 10 }, { "/", 10 }, { "%", 10 },
+    };
+
+    for (const auto &[name, precedence] : Operators)
+    {
+      if (name == op)
+      {
+        return precedence;
+      }
+    }
+    return 0;
+  }
+
+  inline Value _conditional() {
+    const Value condition = _binary(1);
+    if (!_accept("?"))
+    {
+      return condition;
+    }
+
+    const Value left = _conditional();
+    if (!_accept(":"))
+    {
+      m_failed = true;
+      return UnknownValue;
+    }
+    const Value right = _conditional();
+
+    if (!condition.known)
+    {
+      return UnknownValue;
+    }
+    return condition.value != 0 ? left : right;
+  }
+
+  inline Value _binary(int min_precedence) {
+    Value left = _unary();
+
+    while (!m_failed)
+    {
+      const std::string_view op = _peek();
+      const int precedence = Precedence(op);
+      if (precedence < min_precedence || precedence == 0)
+      {
+        break;
+      }
+
+      _next();
+      const Value right = _binary(precedence + 1);
+      left = _apply(op, left, right);
+    }
+
+    return left;
+  }
+
+  static inline Value _apply(const std::string_view &op, const Value &left, const Value &right) {
+    // short circuits on a known side
+    if (op == "&&")
+    {
+      if ((left.known && left.value == 0) || (right.known && right.value == 0))
+      {
+        return Known(0);
+      }
+      return left.known && right.known ? Known(1) : UnknownValue;
+    }
+
+    if (op == "||")
+    {
+      if ((left.known && left.value != 0) || (right.known && right.value != 0))
+      {
+        return Known(1);
+      }
+      return left.known && right.known ? Known(0) : UnknownValue;
+    }
+
+    if (!left.known || !right.known)
+    {
+      return UnknownValue;
+    }
+
+    // wrapping arithmetic
+    const uint64_t a = uint64_t(left.value);
+    const uint64_t b = uint64_t(right.value);
+
+    switch (op[0])
+    {
+    case '+':
+      return Known(int64_t(a + b));
+    case '-':
+      return Known(int64_t(a - b));
+    case '*':
+      return Known(int64_t(a * b));
+    case '/':
+    case '%':
+      if (right.value == 0 || (left.value == INT64_MIN && right.value == -1))
+      {
+        return UnknownValue;
+      }
+      return Known(op[0] == '/' ? left.value / right.value : left.value % right.value);
+    case '^':
+      return Known(int64_t(a ^ b));
+    case '=':
+      return Known(left.value == right.value);
+    case '!':
+      return Known(left.value != right.value);
+    case '|':
+      return Known(int64_t(a | b));
+    case '&':
+      return Known(int64_t(a & b));
+    case '<':
+    case '>':
+      if (op == "<<" || op == ">>")
+      {
+        if (right.value < 0 || right.value >= 64)
+        {
+          return UnknownValue;
+        }
+        return Known(op == "<<" ? int64_t(a << b) : left.value >> right.value);
+      }
+      if (op == "<")
+      {
+        return Known(left.value < right.value);
+      }
+      if (op == ">")
+      {
+        return Known(left.value > right.value);
+      }
+      if (op == "<=")
+      {
+        return Known(left.value <= right.value);
+      }
+      return Known(left.value >= right.value);
+    default:
+      return UnknownValue;
+    }
+  }
+
+  inline Value _unary() {
+    if (_accept("!"))
+    {
+      const Value value = _unary();
+      return value.known ? Known(value.value == 0) : UnknownValue;
+    }
+    if (_accept("~"))
+    {
+      const Value value = _unary();
+      return value.known ? Known(~value.value) : UnknownValue;
+    }
+    if (_accept("-"))
+    {
+      const Value value = _unary();
+      return value.known ? Known(int64_t(0 - uint64_t(value.value))) : UnknownValue;
+    }
+    if (_accept("+"))
+    {
+      return _unary();
+    }
+
+    return _primary();
+  }
+
+  inline Value _primary() {
+    const std::string_view token = _next();
+    if (token.empty())
+    {
+      m_failed = true;
+      return UnknownValue;
+    }
+
+    if (token == "(")
+    {
+      const Value value = _conditional();
+      if (!_accept(")"))
+      {
+        m_failed = true;
+      }
+      return value;
+    }
+
+    if (IsDigit(token[0]))
+    {
+      return _number(token);
+    }
+
+    if (token[0] == '\'')
+    {
+      // plain characters only, no escapes or multi-chars
+      if (token.size() == 3 && token[2] == '\'' && token[1] != '\\')
+      {
+        return Known(int64_t(token[1]));
+      }
+      return UnknownValue;
+    }
+
+    if (!_is_identifier(token))
+    {
+      m_failed = true;
+      return UnknownValue;
+    }
+
+    if (token == "defined")
+    {
+      return _defined();
+    }
+
+    if (token == "__has_include" || token == "__has_include_next")
+    {
+      return _has_include();
+    }
+
+    if (token == "true")
+    {
+      return Known(1);
+    }
+    if (token == "false")
+    {
+      return Known(0);
+    }
+
+    return _macro(token);
+  }
+
+  inline Value _defined() {
+    const bool parenthesized = _accept("(");
+    const std::string_view name = _next();
+    if (!_is_identifier(name) || (parenthesized && !_accept(")")))
+    {
+      m_failed = true;
+      return UnknownValue;
+    }
+
+    const CPreprocessor::Macro *macro = m_scope.find(name);
+    return macro ? Known(macro->defined) : UnknownValue;
+  }
+
+  inline Value _has_include() {
+    if (!_accept("("))
+    {
+      m_failed = true;
+      return UnknownValue;
+    }
+
+    // the spec is read raw, '<...>' isn't a token
+    _skip_space();
+    const char *const spec_begin = m_cursor;
+    while (m_cursor < m_end && *m_cursor != ')')
+    {
+      ++m_cursor;
+    }
+
+    if (m_cursor >= m_end)
+    {
+      m_failed = true;
+      return UnknownValue;
+    }
+
+    const std::string_view body{ spec_begin, size_t(m_cursor - spec_begin) };
+    ++m_cursor;
+
+    bool angled = false;
+    const std::string_view spec = DirectiveScanner::get_include_spec(body, &angled);
+
+    // a missing include might be in a directory that's not searched, so it's unknown
+    if (spec.empty() || !m_resolver || !m_resolver(spec, angled))
+    {
+      return UnknownValue;
+    }
+    return Known(1);
+  }
+
+  inline Value _macro(const std::string_view &name) {
+    // a function-like macro's (or a builtin's, '__has_cpp_attribute(...)') arguments
+    if (_peek() == "(")
+    {
+      _skip_arguments();
+      return UnknownValue;
+    }
+
+    const CPreprocessor::Macro *macro = m_scope.find(name);
+    if (macro == nullptr || macro->function_like)
+    {
+      return UnknownValue;
+    }
+
+    // an undefined identifier is zero
+    if (!macro->defined)
+    {
+      return Known(0);
+    }
+
+    if (m_depth >= MaxExpansionDepth)
+    {
+      return UnknownValue;
+    }
+
+    return ConditionEvaluator{ macro->value, m_scope, m_resolver, m_depth + 1 }
+        .evaluate_operand();
+  }
+
+  inline void _skip_arguments() {
+    int depth = 0;
+    do
+    {
+      const std::string_view token = _next();
+      if (token.empty())
+      {
+        m_failed = true;
+        return;
+      }
+
+      depth += token == "(" ? 1 : token == ")" ? -1 : 0;
+    } while (depth > 0);
+  }
+
+  static inline Value _number(const std::string_view &token) {
+    int base = 10;
+    size_t index = 0;
+
+    if (token.size() > 1 && token[0] == '0')
+    {
+      if (token[1] == 'x' || token[1] == 'X')
+      {
+        base = 16;
+        index = 2;
+      }
+      else if (token[1] == 'b' || token[1] == 'B')
+      {
+        base = 2;
+        index = 2;
+      }
+      else
+      {
+        base = 8;
+        index = 1;
+      }
+    }
+
+    uint64_t value = 0;
+    for (; index < token.size(); index++)
+    {
+      const char c = token[index];
+      if (c == '\'')
+      {
+        continue;
+      }
+
+      int digit = -1;
+      if (c >= '0' && c <= '9')
+      {
+        digit = c - '0';
+      }
+      else if (base == 16 && c >= 'a' && c <= 'f')
+      {
+        digit = c - 'a' + 10;
+      }
+      else if (base == 16 && c >= 'A' && c <= 'F')
+      {
+        digit = c - 'A' + 10;
+      }
+
+      if (digit < 0 || digit >= base)
+      {
+        break;
+      }
+      value = value * base + digit;
+    }
+
+    // only integer suffixes are allowed after the digits
+    for (; index < token.size(); index++)
+    {
+      const char c = token[index] | 0x20;
+      if (c != 'u' && c != 'l' && c != 'z')
+      {
+        return UnknownValue;
+      }
+    }
+
+    return Known(int64_t(value));
+  }
+
+  static inline bool _is_identifier(const std::string_view &token) {
+    return !token.empty() && IsIdentifierStart(token[0]);
+  }
+
+  inline bool _accept(const std::string_view &token) {
+    if (_peek() != token)
+    {
+      return false;
+    }
+    _next();
+    return true;
+  }
+
+  inline bool _at_end() {
+    _skip_space();
+    return m_cursor >= m_end;
+  }
+
+  inline std::string_view _peek() {
+    const char *const cursor = m_cursor;
+    const std::string_view token = _next();
+    m_cursor = cursor;
+    return token;
+  }
+
+  // empty at the end of the expression
+  inline std::string_view _next() {
+    _skip_space();
+    if (m_cursor >= m_end)
+    {
+      return {};
+    }
+
+    const char *const begin = m_cursor;
+    const char c = *m_cursor;
+
+    if (IsIdentifierStart(c))
+    {
+      while (m_cursor < m_end && IsIdentifierChar(*m_cursor))
+      {
+        ++m_cursor;
+      }
+    }
+    else if (IsDigit(c))
+    {
+      // a pp-number, including any suffix & digit separators
+      while (m_cursor < m_end &&
+             (IsIdentifierChar(*m_cursor) || *m_cursor == '.' || *m_cursor == '\''))
+      {
+        ++m_cursor;
+      }
+    }
+    else if (c == '\'' || c == '"')
+    {
+      ++m_cursor;
+      while (m_cursor < m_end && *m_cursor != c)
+      {
+        m_cursor += *m_cursor == '\\' ? 2 : 1;
+      }
+      m_cursor = std::min(m_cursor + 1, m_end);
+    }
+    else
+    {
+      static constexpr std::string_view TwoCharOperators[] = { "&&", "||", "==", "!=",
+                                                               "<=", ">=", "<<", ">>" };
+
+      m_cursor += 1;
+      for (const std::string_view &op : TwoCharOperators)
+      {
+        if (size_t(m_end - begin) >= 2 && op[0] == begin[0] && op[1] == begin[1])
+        {
+          m_cursor = begin + 2;
+          break;
+        }
+      }
+    }
+
+    return { begin, size_t(m_cursor - begin) };
+  }
+
+  inline void _skip_space() {
+    const std::string_view rest =
+        DirectiveScanner::skip_space({ m_cursor, size_t(m_end - m_cursor) });
+    m_cursor = rest.data();
+
+    // a line comment runs to the end of the directive
+    if (m_end - m_cursor >= 2 && m_cursor[0] == '/' && m_cursor[1] == '/')
+    {
+      m_cursor = m_end;
+    }
+  }
+
+  const char *m_cursor;
+  const char *const m_end;
+  const MacroScope &m_scope;
+  const CPreprocessor::include_resolver &m_resolver;
+  const int m_depth;
+  bool m_failed = false;
+};
+
+static inline void DefineMacro(MacroScope &scope, const std::string_view &body, bool known);
+static inline void UndefineMacro(MacroScope &scope, const std::string_view &body, bool known);
+static inline std::string_view ReadIdentifier(const std::string_view &body);
+static inline ConditionTruth IsDefined(const MacroScope &scope, const std::string_view &body);
+static inline ConditionTruth Negate(ConditionTruth truth);
+
+void CPreprocessor::gather_includes(const StrBlob &input, const macro_table &macros,
+                                    const include_resolver &resolver, vector<string> &output,
+                                    vector<string> &redefined) {
+  vector<DirectiveScanner::Directive> directives{};
+  DirectiveScanner::scan_directives(input, directives);
+
+  MacroScope scope{ macros };
+  vector<ConditionFrame> frames{};
+
+  const auto state = [&frames]() {
+    return frames.empty() ? ConditionTruth::True : frames.back().state();
+  };
+
+  const auto evaluate = [&](const std::string_view &expression) {
+    return ConditionEvaluator{ expression, scope, resolver }.evaluate();
+  };
+
+  const auto add_redefined = [&macros, &redefined](const std::string_view &body) {
+    const string name{ ReadIdentifier(body) };
+    if (macros.contains(name) &&
+        std::find(redefined.begin(), redefined.end(), name) == redefined.end())
+    {
+      redefined.push_back(name);
+    }
+  };
+
+  for (const auto &[name, body] : directives)
+  {
+    if (name == "if" || name == "ifdef" || name == "ifndef")
+    {
+      ConditionFrame frame{};
+      frame.enclosing = state();
+
+      // the conditions of a disabled branch don't matter
+      ConditionTruth truth = ConditionTruth::False;
+      if (frame.enclosing != ConditionTruth::False)
+      {
+        truth = name == "if"      ? evaluate(body)
+                : name == "ifdef" ? IsDefined(scope, body)
+                                  : Negate(IsDefined(scope, body));
+      }
+
+      frame.next_branch(truth);
+      frames.push_back(frame);
+      continue;
+    }
+
+    if (name == "elif" || name == "elifdef" || name == "elifndef" || name == "else")
+    {
+      if (frames.empty())
+      {
+        continue;
+      }
+
+      ConditionFrame &frame = frames.back();
+      ConditionTruth truth = ConditionTruth::True;
+      if (frame.enclosing == ConditionTruth::False || frame.taken)
+      {
+        truth = ConditionTruth::False;
+      }
+      else if (name == "elif")
+      {
+        truth = evaluate(body);
+      }
+      else if (name == "elifdef")
+      {
+        truth = IsDefined(scope, body);
+      }
+      else if (name == "elifndef")
+      {
+        truth = Negate(IsDefined(scope, body));
+      }
+
+      frame.next_branch(truth);
+      continue;
+    }
+
+    if (name == "endif")
+    {
+      if (!frames.empty())
+      {
+        frames.pop_back();
+      }
+      continue;
+    }
+
+    const ConditionTruth current = state();
+    if (current == ConditionTruth::False)
+    {
+      continue;
+    }
+
+    if (name == "define")
+    {
+      DefineMacro(scope, body, current == ConditionTruth::True);
+      add_redefined(body);
+      continue;
+    }
+
+    if (name == "undef")
+    {
+      UndefineMacro(scope, body, current == ConditionTruth::True);
+      add_redefined(body);
+      continue;
+    }
+
+    if (!DirectiveScanner::is_include(name))
+    {
+      continue;
+    }
+
+    std::string_view spec = DirectiveScanner::get_include_spec(body);
+    if (spec.empty())
+    {
+      // '#include HEADER', only an object-like macro with a spec is resolved
+      const CPreprocessor::Macro *macro = scope.find(ReadIdentifier(body));
+      if (macro != nullptr && macro->defined && !macro->function_like)
+      {
+        spec = DirectiveScanner::get_include_spec(macro->value);
+      }
+    }
+
+    if (!spec.empty())
+    {
+      output.emplace_back(spec);
+    }
+  }
+}
+
+hash_t CPreprocessor::hash_macros(const macro_table &macros) {
+  // sorted, so the hash doesn't depend on the table's order
+  std::map<std::string_view, const Macro *> sorted{};
+  for (const auto &[name, macro] : macros)
+  {
+    sorted.emplace(name, &macro);
+  }
+
+  HashDigester digester{};
+  for (const auto &[name, macro] : sorted)
+  {
+    digester.add(string(name));
+    digester += hash_t(macro->defined) | (hash_t(macro->function_like) << 1) |
+                (hash_t(macro->redefined) << 2);
+    digester.add(macro->value);
+  }
+  return digester.hash();
+}
+
+inline void DefineMacro(MacroScope &scope, const std::string_view &body, bool known) {
+  const std::string_view name = ReadIdentifier(body);
+  if (name.empty())
+  {
+    return;
+  }
+
+  if (!known)
+  {
+    scope.set_unknown(name);
+    return;
+  }
+
+  CPreprocessor::Macro macro{};
+  macro.defined = true;
+
+  // the '(' of a function-like macro follows the name without a space
+  const char *const name_end = name.data() + name.size();
+  const char *const body_end = body.data() + body.size();
+  if (name_end < body_end && *name_end == '(')
+  {
+    macro.function_like = true;
+  }
+  else
+  {
+    const StrBlob value = string_tools::trim(StrBlob{ name_end, body_end });
+    macro.value.assign(value.begin(), value.size());
+  }
+
+  scope.set(name, macro);
+}
+
+inline void UndefineMacro(MacroScope &scope, const std::string_view &body, bool known) {
+  const std::string_view name = ReadIdentifier(body);
+  if (name.empty())
+  {
+    return;
+  }
+
+  if (!known)
+  {
+    scope.set_unknown(name);
+    return;
+  }
+
+  scope.set(name, CPreprocessor::Macro{});
+}
+
+inline std::string_view ReadIdentifier(const std::string_view &body) {
+  const std::string_view rest = DirectiveScanner::skip_space(body);
+
+  size_t length = 0;
+  while (length < rest.size() && IsIdentifierChar(rest[length]))
+  {
+    ++length;
+  }
+
+  if (length == 0 || IsDigit(rest[0]))
+  {
+    return {};
+  }
+  return rest.substr(0, length);
+}
+
+inline ConditionTruth IsDefined(const MacroScope &scope, const std::string_view &body) {
+  const std::string_view name = ReadIdentifier(body);
+  const CPreprocessor::Macro *macro = name.empty() ? nullptr : scope.find(name);
+  if (macro == nullptr)
+  {
+    return ConditionTruth::Unknown;
+  }
+  return macro->defined ? ConditionTruth::True : ConditionTruth::False;
+}
+
+inline ConditionTruth Negate(ConditionTruth truth) {
+  switch (truth)
+  {
+  case ConditionTruth::False:
+    return ConditionTruth::True;
+  case ConditionTruth::True:
+    return ConditionTruth::False;
+  default:
+    return ConditionTruth::Unknown;
+  }
+}
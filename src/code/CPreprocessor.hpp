@@ -1,10 +1,13 @@
 #pragma once
+#include <functional>
 #include <string_view>
+#include <unordered_map>
 
 #include "../Range.hpp"
 #include "../StringTools.hpp"
 #include "../base.hpp"
 #include "../io/CharSource.hpp"
+#include "../misc/hash128.hpp"
 
 struct CPreprocessor
 {
@@ -59,6 +62,53 @@ struct CPreprocessor
     { "pragma", Type::Pragma },
   };
 
+  // a macro the conditionals are evaluated with
+  struct Macro
+  {
+    bool defined = false;
+    // takes arguments, it's never expanded while evaluating
+    bool function_like = false;
+    // the replacement of an object-like macro
+    string value = {};
+    // a scanned file #defines or #undefs it, so it's value isn't known in any file (the
+    // files including that one, or included after it, see it changed)
+    bool redefined = false;
+  };
+
+  // the macros known before a file is read, a name that's not in the table is unknown
+  // (a header that's not scanned might define it), and the branches depending on it
+  // are all kept
+  typedef std::unordered_map<string, Macro> macro_table;
+
+  // true if the include's spec exists, false if it's not known
+  typedef std::function<bool(const std::string_view &spec, bool angled)> include_resolver;
+
+  // names only a compiler defines, those the compiler's builtins don't define are
+  // known to be undefined (so '#ifdef _WIN32' is disabled when not targeting windows)
+  static constexpr const char *CompilerOwnedMacros[] = {
+    // platforms
+    "_WIN32", "_WIN64", "__MINGW32__", "__MINGW64__", "__CYGWIN__",
+    "__linux__", "__linux", "linux", "__unix__", "__unix", "unix",
+    "__APPLE__", "__MACH__", "__ANDROID__", "__EMSCRIPTEN__", "__wasm__",
+    "__FreeBSD__", "__NetBSD__", "__OpenBSD__", "__DragonFly__", "__sun",
+    // architectures
+    "__x86_64__", "__i386__", "__aarch64__", "__arm__", "_M_X64", "_M_IX86", "_M_ARM64",
+    // compilers & languages
+    "_MSC_VER", "_MSC_FULL_VER", "__clang__", "__GNUC__", "__INTEL_COMPILER",
+    "__cplusplus", "__OBJC__", "__CUDACC__",
+  };
+
+  // gathers the specs of the includes in `input` that aren't in a disabled conditional
+  // branch, the conditionals are evaluated with `macros` & the file's own defines
+  //
+  // '#include MACRO' is resolved when the macro is known, '__has_include' with `resolver`,
+  // the names in `macros` the file #defines or #undefs are added to `redefined`
+  static void gather_includes(const StrBlob &input, const macro_table &macros,
+                              const include_resolver &resolver, vector<string> &output,
+                              vector<string> &redefined);
+
+  static hash_t hash_macros(const macro_table &macros);
+
   using source_t = CharSource &;
 
   static void gather_all_tks(const StrBlob &input, vector<Token> &output);
@@ -0,0 +1,46 @@
+#include "DependencyGraph.hpp"
+
+DependencyGraph::file_id DependencyGraph::intern(const string &path) {
+  const auto iter = m_path_index.find(path);
+  if (iter != m_path_index.end())
+  {
+    return iter->second;
+  }
+
+  const file_id id = file_id(m_nodes.size());
+  m_paths.push_back(path);
+  m_nodes.emplace_back();
+  m_path_index.emplace(m_paths.back(), id);
+  return id;
+}
+
+DependencyGraph::file_id DependencyGraph::find(const FilePath &path) const {
+  const auto iter = m_path_index.find(std::string_view(path.c_str()));
+  if (iter == m_path_index.end())
+  {
+    return InvalidId;
+  }
+  return iter->second;
+}
+
+void DependencyGraph::set_edges(file_id id, const Blob<const file_id> &edges) {
+  Node &node = m_nodes[id];
+  node.edges_offset = uint32_t(m_edges.size());
+  node.edges_count = uint32_t(edges.size());
+
+  m_edges.insert(m_edges.end(), edges.begin(), edges.end());
+}
+
+void DependencyGraph::set_hash(file_id id, hash_t hash) {
+  m_nodes[id].hash = hash;
+  m_hash_index.insert_or_assign(hash, id);
+}
+
+DependencyGraph::file_id DependencyGraph::find_hash(hash_t hash) const {
+  const auto iter = m_hash_index.find(hash);
+  if (iter == m_hash_index.end())
+  {
+    return InvalidId;
+  }
+  return iter->second;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
+#include "FilePath.hpp"
+#include "SourceTools.hpp"
+#include "base.hpp"
+#include "misc/hash128.hpp"
+
+// the include graph of a project
+//
+// files are interned into dense 32-bit ids, the includes of every file are stored
+// contiguously in one flat edge array (CSR) & the files are indexed by their hash as the
+// hashes are set
+class DependencyGraph
+{
+public:
+  DependencyGraph() = default;
+  // the path index views into `m_paths`, a copy would view into the original's
+  DependencyGraph(const DependencyGraph &) = delete;
+  DependencyGraph &operator=(const DependencyGraph &) = delete;
+  DependencyGraph(DependencyGraph &&) noexcept = default;
+  DependencyGraph &operator=(DependencyGraph &&) noexcept = default;
+
+  typedef uint32_t file_id;
+  static constexpr file_id InvalidId = ~file_id(0);
+
+  struct Node
+  {
+    SourceFileType type = SourceFileType::None;
+    hash_t hash = 0;
+    // the node's includes are `m_edges[edges_offset, edges_offset + edges_count)`
+    uint32_t edges_offset = 0;
+    uint32_t edges_count = 0;
+  };
+
+  // returns the id of `path`, adding it (with no includes) if it's not in the graph
+  inline file_id intern(const FilePath &path) { return intern(string(path)); }
+  file_id intern(const string &path);
+  // returns `InvalidId` if `path` is not in the graph
+  file_id find(const FilePath &path) const;
+
+  // sets the includes of `id`, should be called once per node
+  void set_edges(file_id id, const Blob<const file_id> &edges);
+  void set_hash(file_id id, hash_t hash);
+  inline void set_type(file_id id, SourceFileType type) { m_nodes[id].type = type; }
+
+  inline size_t size() const { return m_nodes.size(); }
+  inline const string &get_path(file_id id) const { return m_paths[id]; }
+  inline const Node &get_node(file_id id) const { return m_nodes[id]; }
+
+  inline Blob<const file_id> get_dependencies(file_id id) const {
+    return { m_edges.data() + m_nodes[id].edges_offset, m_nodes[id].edges_count };
+  }
+
+  // returns `InvalidId` if no file has `hash`
+  file_id find_hash(hash_t hash) const;
+
+private:
+  // a deque never moves it's strings, the path index views into them
+  std::deque<string> m_paths;
+  vector<Node> m_nodes;
+  vector<file_id> m_edges;
+
+  std::unordered_map<std::string_view, file_id> m_path_index;
+  std::unordered_map<hash_t, file_id> m_hash_index;
+};
@@ -0,0 +1,511 @@
+#include "DirectiveScanner.hpp"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCANNER_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCANNER_SSE2 1
+#endif
+
+// the longest delimiter a raw string literal can have
+static constexpr size_t MaxRawDelimiterLength = 16;
+
+// the names a directive split by a line continuation is matched against, it's spliced name
+// isn't in the source so it's viewed from here
+static constexpr std::string_view KnownDirectiveNames[] = {
+  "include", "include_next", "define", "undef", "if",    "ifdef", "ifndef",  "elif",
+  "elifdef", "elifndef",     "else",   "endif", "line",  "error", "warning", "pragma",
+};
+
+template <char... Stops>
+static inline const char *FindAny(const char *p, const char *end);
+
+static inline bool IsIdentifier(char c);
+static inline bool IsHorizontalSpace(char c);
+
+// returns the position after the line continuation at `p`, or `p` if there is none
+static inline const char *SkipContinuation(const char *p, const char *end);
+// `p` is after the '/*', returns the position after the '*/'
+static inline const char *SkipBlockComment(const char *p, const char *end);
+// `p` is after the '//', returns the position of the newline ending the comment
+static inline const char *SkipLineComment(const char *p, const char *end);
+// `p` is at the opening quote, returns the position after the closing quote,
+// or the position of the newline for unterminated literals
+static inline const char *SkipLiteral(const char *p, const char *end);
+// `p` is at the opening quote, returns `nullptr` if it's not a valid raw string
+static inline const char *SkipRawString(const char *p, const char *end);
+static inline bool IsRawStringPrefix(const char *begin, const char *quote);
+// a `'` between two digits is a digit separator ('1'000'), not a character literal
+static inline bool IsDigitSeparator(const char *begin, const char *p, const char *end);
+
+// `p` is in a line, returns the position of the newline ending it's logical line
+static inline const char *SkipLine(const char *begin, const char *p, const char *end);
+
+// skips the spaces, continuations & block comments between the parts of a directive
+static inline const char *SkipDirectiveSpace(const char *p, const char *end);
+
+// `name_end` is at a continuation in the name starting at `name`, moves it after the spliced
+// name & returns the known name it spells (the part before the continuation if none)
+static inline std::string_view ReadSplicedName(const char *name,
+                                               const char *&name_end,
+                                               const char *end);
+
+// calls `callback` with every directive in `source`
+template <typename Callback>
+static inline void ScanDirectives(const StrBlob &source, Callback &&callback);
+
+void DirectiveScanner::scan_directives(const StrBlob &source, vector<Directive> &out) {
+  ScanDirectives(source, [&out](const Directive &directive) { out.push_back(directive); });
+}
+
+void DirectiveScanner::scan_includes(const StrBlob &source, vector<std::string_view> &out) {
+  ScanDirectives(source, [&out](const Directive &directive) {
+    if (!is_include(directive.name))
+    {
+      return;
+    }
+
+    const std::string_view spec = get_include_spec(directive.body);
+    if (!spec.empty())
+    {
+      out.push_back(spec);
+    }
+  });
+}
+
+std::string_view DirectiveScanner::get_include_spec(const std::string_view &body, bool *angled) {
+  const char *const end = body.data() + body.size();
+  const char *const p = SkipDirectiveSpace(body.data(), end);
+  if (p >= end || (*p != '"' && *p != '<'))
+  {
+    return {};
+  }
+
+  const char *const spec = p + 1;
+  const char *const spec_end = *p == '"' ? FindAny<'"'>(spec, end) : FindAny<'>'>(spec, end);
+
+  // unterminated spec
+  if (spec_end >= end)
+  {
+    return {};
+  }
+
+  if (angled)
+  {
+    *angled = *p == '<';
+  }
+  return { spec, size_t(spec_end - spec) };
+}
+
+std::string_view DirectiveScanner::skip_space(const std::string_view &body) {
+  const char *const end = body.data() + body.size();
+  const char *const p = SkipDirectiveSpace(body.data(), end);
+  return { p, size_t(end - p) };
+}
+
+bool DirectiveScanner::is_include(const std::string_view &name) {
+  return name == "include" || name == "include_next";
+}
+
+template <typename Callback>
+inline void ScanDirectives(const StrBlob &source, Callback &&callback) {
+  const char *const begin = source.data;
+  const char *const end = source.data + source.length;
+  const char *p = begin;
+
+  // at the top of the loop, only whitespace & comments are before `p` on the current line
+  while (p < end)
+  {
+    if (IsHorizontalSpace(*p) || *p == '\n')
+    {
+      ++p;
+      continue;
+    }
+
+    if (*p == '/' && p + 1 < end && p[1] == '*')
+    {
+      p = SkipBlockComment(p + 2, end);
+      continue;
+    }
+
+    if (*p == '\\' && SkipContinuation(p, end) != p)
+    {
+      p = SkipContinuation(p, end);
+      continue;
+    }
+
+    if (*p != '#')
+    {
+      p = SkipLine(begin, p, end);
+      continue;
+    }
+
+    const char *const name = SkipDirectiveSpace(p + 1, end);
+    const char *name_end = name;
+    while (name_end < end && IsIdentifier(*name_end))
+    {
+      ++name_end;
+    }
+
+    // a continuation inside the name ('#inc\<newline>lude'), rare
+    std::string_view name_view{ name, size_t(name_end - name) };
+    if (name_end < end && *name_end == '\\' && SkipContinuation(name_end, end) != name_end)
+    {
+      name_view = ReadSplicedName(name, name_end, end);
+    }
+
+    p = SkipLine(begin, name_end, end);
+    callback(DirectiveScanner::Directive{ name_view, { name_end, size_t(p - name_end) } });
+  }
+}
+
+inline const char *SkipLine(const char *begin, const char *p, const char *end) {
+  while (p < end)
+  {
+    p = FindAny<'\n', '"', '\'', '/', '\\'>(p, end);
+    if (p >= end)
+    {
+      break;
+    }
+
+    switch (*p)
+    {
+    case '\n':
+      return p;
+    case '"':
+      if (IsRawStringPrefix(begin, p))
+      {
+        const char *const raw_end = SkipRawString(p, end);
+        if (raw_end != nullptr)
+        {
+          p = raw_end;
+          break;
+        }
+      }
+      p = SkipLiteral(p, end);
+      break;
+    case '\'':
+      if (IsDigitSeparator(begin, p, end))
+      {
+        ++p;
+        break;
+      }
+      p = SkipLiteral(p, end);
+      break;
+    case '/':
+      if (p + 1 < end && p[1] == '/')
+      {
+        return SkipLineComment(p + 2, end);
+      }
+      else if (p + 1 < end && p[1] == '*')
+      {
+        p = SkipBlockComment(p + 2, end);
+      }
+      else
+      {
+        ++p;
+      }
+      break;
+    case '\\':
+      // a continuation joins the next line to this one, anything else is a stray backslash
+      p = SkipContinuation(p, end) != p ? SkipContinuation(p, end) : p + 1;
+      break;
+    }
+  }
+
+  return end;
+}
+
+#if SCANNER_AVX2
+template <typename... Ts>
+static inline __m256i Or256(__m256i first, Ts... rest) {
+  if constexpr (sizeof...(rest) == 0)
+  {
+    return first;
+  }
+  else
+  {
+    return _mm256_or_si256(first, Or256(rest...));
+  }
+}
+#endif
+
+#if SCANNER_SSE2
+template <typename... Ts>
+static inline __m128i Or128(__m128i first, Ts... rest) {
+  if constexpr (sizeof...(rest) == 0)
+  {
+    return first;
+  }
+  else
+  {
+    return _mm_or_si128(first, Or128(rest...));
+  }
+}
+#endif
+
+template <char... Stops>
+inline const char *FindAny(const char *p, const char *end) {
+#if SCANNER_AVX2
+  while (end - p >= 32)
+  {
+    const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    const uint32_t mask = uint32_t(
+        _mm256_movemask_epi8(Or256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(Stops))...)));
+
+    if (mask != 0)
+    {
+      return p + std::countr_zero(mask);
+    }
+    p += 32;
+  }
+#endif
+
+#if SCANNER_SSE2
+  while (end - p >= 16)
+  {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const uint32_t mask =
+        uint32_t(_mm_movemask_epi8(Or128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(Stops))...)));
+
+    if (mask != 0)
+    {
+      return p + std::countr_zero(mask);
+    }
+    p += 16;
+  }
+#endif
+
+  while (p < end && ((*p != Stops) && ...))
+  {
+    ++p;
+  }
+  return p;
+}
+
+inline std::string_view ReadSplicedName(const char *name,
+                                        const char *&name_end,
+                                        const char *end) {
+  const std::string_view unspliced{ name, size_t(name_end - name) };
+
+  char spliced[32] = {};
+  size_t length = 0;
+  const char *p = name;
+  while (p < end)
+  {
+    if (*p == '\\' && SkipContinuation(p, end) != p)
+    {
+      p = SkipContinuation(p, end);
+      continue;
+    }
+
+    if (!IsIdentifier(*p))
+    {
+      break;
+    }
+
+    // longer than any known name
+    if (length == sizeof(spliced))
+    {
+      return unspliced;
+    }
+
+    spliced[length++] = *p++;
+  }
+
+  for (const std::string_view &known : KnownDirectiveNames)
+  {
+    if (known == std::string_view{ spliced, length })
+    {
+      name_end = p;
+      return known;
+    }
+  }
+
+  return unspliced;
+}
+
+inline bool IsIdentifier(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline bool IsHorizontalSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+inline const char *SkipContinuation(const char *p, const char *end) {
+  if (p + 1 < end && p[1] == '\n')
+  {
+    return p + 2;
+  }
+  if (p + 2 < end && p[1] == '\r' && p[2] == '\n')
+  {
+    return p + 3;
+  }
+  return p;
+}
+
+inline const char *SkipBlockComment(const char *p, const char *end) {
+  while (p < end)
+  {
+    p = FindAny<'*'>(p, end);
+    if (p + 1 < end && p[1] == '/')
+    {
+      return p + 2;
+    }
+    ++p;
+  }
+  return end;
+}
+
+inline const char *SkipLineComment(const char *p, const char *end) {
+  while (p < end)
+  {
+    p = FindAny<'\n'>(p, end);
+    if (p >= end)
+    {
+      break;
+    }
+
+    // a continued comment goes on to the next line
+    const char *last = p - 1;
+    if (*last == '\r')
+    {
+      --last;
+    }
+    if (*last != '\\')
+    {
+      return p;
+    }
+    ++p;
+  }
+  return end;
+}
+
+inline const char *SkipLiteral(const char *p, const char *end) {
+  const char quote = *p++;
+
+  while (p < end)
+  {
+    p = quote == '"' ? FindAny<'"', '\\', '\n'>(p, end) : FindAny<'\'', '\\', '\n'>(p, end);
+    if (p >= end || *p == '\n')
+    {
+      break;
+    }
+
+    if (*p == quote)
+    {
+      return p + 1;
+    }
+
+    // escaped character or continuation
+    p = SkipContinuation(p, end) != p ? SkipContinuation(p, end) : p + 2;
+  }
+
+  return p < end ? p : end;
+}
+
+inline const char *SkipRawString(const char *p, const char *end) {
+  const char *const delimiter = p + 1;
+  const char *paren = delimiter;
+
+  while (paren < end && *paren != '(')
+  {
+    if (paren - delimiter >= ptrdiff_t(MaxRawDelimiterLength) || IsHorizontalSpace(*paren) ||
+        *paren == '\n' || *paren == '\\' || *paren == ')' || *paren == '"')
+    {
+      return nullptr;
+    }
+    ++paren;
+  }
+
+  if (paren >= end)
+  {
+    return nullptr;
+  }
+
+  const size_t delimiter_length = size_t(paren - delimiter);
+  p = paren + 1;
+
+  while (p < end)
+  {
+    p = FindAny<')'>(p, end);
+    if (size_t(end - p) < delimiter_length + 2)
+    {
+      break;
+    }
+
+    if (std::memcmp(p + 1, delimiter, delimiter_length) == 0 && p[delimiter_length + 1] == '"')
+    {
+      return p + delimiter_length + 2;
+    }
+    ++p;
+  }
+
+  return end;
+}
+
+inline bool IsRawStringPrefix(const char *begin, const char *quote) {
+  if (quote == begin || quote[-1] != 'R')
+  {
+    return false;
+  }
+
+  // R, LR, uR, UR or u8R
+  const char *prefix = quote - 1;
+  if (prefix > begin && (prefix[-1] == 'L' || prefix[-1] == 'u' || prefix[-1] == 'U'))
+  {
+    --prefix;
+  }
+  else if (prefix - begin >= 2 && prefix[-1] == '8' && prefix[-2] == 'u')
+  {
+    prefix -= 2;
+  }
+
+  return prefix == begin || !IsIdentifier(prefix[-1]);
+}
+
+inline bool IsDigitSeparator(const char *begin, const char *p, const char *end) {
+  if (p == begin || p + 1 >= end || !IsIdentifier(p[-1]) || !IsIdentifier(p[1]))
+  {
+    return false;
+  }
+
+  // u8'x' is a character literal
+  if (p - begin >= 2 && p[-1] == '8' && p[-2] == 'u')
+  {
+    return false;
+  }
+
+  const char c = p[-1];
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+inline const char *SkipDirectiveSpace(const char *p, const char *end) {
+  while (p < end)
+  {
+    if (IsHorizontalSpace(*p))
+    {
+      ++p;
+    }
+    else if (*p == '\\' && SkipContinuation(p, end) != p)
+    {
+      p = SkipContinuation(p, end);
+    }
+    else if (*p == '/' && p + 1 < end && p[1] == '*')
+    {
+      p = SkipBlockComment(p + 2, end);
+    }
+    else
+    {
+      break;
+    }
+  }
+  return p;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <string_view>
+
+#include "base.hpp"
+
+// finds the preprocessor directives of C/C++ sources, without tokenizing or copying them
+//
+// the scanner only stops at the bytes that can change it's state (newlines, quotes,
+// comment starts & backslashes), which are found 16/32 bytes at a time with SSE2/AVX2,
+// comments, string literals & line continuations are skipped in place
+class DirectiveScanner
+{
+public:
+  struct Directive
+  {
+    // 'include', 'define', 'if'... (empty for a null directive)
+    std::string_view name;
+    // the rest of the logical line, as it's in the source (with any comments &
+    // line continuations)
+    std::string_view body;
+  };
+
+  // appends every directive in `source`, the views point into `source`
+  static void scan_directives(const StrBlob &source, vector<Directive> &out);
+
+  // appends the spec (the text between the quotes or angle brackets) of every
+  // '#include' (& '#include_next') in `source`, the views point into `source`
+  //
+  // macro includes ('#include HEADER') have no spec and are skipped
+  static void scan_includes(const StrBlob &source, vector<std::string_view> &out);
+
+  // the spec of an include's body, `angled` is set for '<...>' specs,
+  // empty if the body isn't a quoted or angled spec (a macro include)
+  static std::string_view get_include_spec(const std::string_view &body, bool *angled = nullptr);
+
+  // skips the spaces, comments & line continuations at the start of a directive's body
+  static std::string_view skip_space(const std::string_view &body);
+
+  static bool is_include(const std::string_view &name);
+};
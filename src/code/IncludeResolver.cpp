@@ -0,0 +1,132 @@
+#include "IncludeResolver.hpp"
+
+#include <filesystem>
+#include <optional>
+
+void IncludeResolver::set_include_directories(const vector<FilePath> &directories) {
+  std::lock_guard guard{ m_mutex };
+
+  m_directories = directories;
+  m_directory_lookups.clear();
+}
+
+FilePath IncludeResolver::resolve(const string &spec, const FilePath &file) {
+  const FilePath file_dir = file.parent();
+  const string local_key = string(file_dir) + '\n' + spec;
+
+  std::optional<bool> local_hit{};
+  {
+    std::lock_guard guard{ m_mutex };
+    const auto iter = m_local_lookups.find(local_key);
+    if (iter != m_local_lookups.end())
+    {
+      local_hit = iter->second;
+    }
+  }
+
+  // is the include local to the file?
+  if (!local_hit.has_value())
+  {
+    local_hit = _exists(FilePath(spec, file_dir));
+
+    std::lock_guard guard{ m_mutex };
+    m_local_lookups.insert_or_assign(local_key, *local_hit);
+  }
+
+  if (*local_hit)
+  {
+    return FilePath(spec, file_dir);
+  }
+
+  const int index = _find_in_include_directories(spec);
+  if (index < 0)
+  {
+    return {};
+  }
+
+  return FilePath(spec, m_directories[index]);
+}
+
+int IncludeResolver::_find_in_include_directories(const string &spec) {
+  {
+    std::lock_guard guard{ m_mutex };
+    const auto iter = m_directory_lookups.find(spec);
+    if (iter != m_directory_lookups.end())
+    {
+      return iter->second;
+    }
+  }
+
+  int index = -1;
+  for (size_t i = 0; i < m_directories.size(); i++)
+  {
+    if (_exists(FilePath(spec, m_directories[i])))
+    {
+      index = int(i);
+      break;
+    }
+  }
+
+  std::lock_guard guard{ m_mutex };
+  m_directory_lookups.insert_or_assign(spec, index);
+  return index;
+}
+
+bool IncludeResolver::_exists(const FilePath &path) {
+  if (path.empty())
+  {
+    return false;
+  }
+
+  const snapshot &files = _get_snapshot(path.parent());
+  return files.contains(_key(path.filename()));
+}
+
+const IncludeResolver::snapshot &IncludeResolver::_get_snapshot(const FilePath &directory) {
+  const string key{ directory };
+
+  {
+    std::lock_guard guard{ m_mutex };
+    const auto iter = m_snapshots.find(key);
+    if (iter != m_snapshots.end())
+    {
+      return *iter->second;
+    }
+  }
+
+  // listed without the lock, if two threads list the same directory, the first one is kept
+  auto files = std::make_unique<const snapshot>(_list(directory));
+
+  std::lock_guard guard{ m_mutex };
+  const auto [iter, _] = m_snapshots.try_emplace(key, std::move(files));
+  return *iter->second;
+}
+
+IncludeResolver::snapshot IncludeResolver::_list(const FilePath &directory) {
+  snapshot files{};
+
+  // a missing directory has no files
+  std::error_code error{};
+  for (std::filesystem::directory_iterator iter{ directory.c_str(), error }, end{};
+       !error && iter != end;
+       iter.increment(error))
+  {
+    // follows symlinks, like `FilePath::is_file()`
+    std::error_code type_error{};
+    if (iter->is_regular_file(type_error))
+    {
+      files.insert(_key(iter->path().filename().string()));
+    }
+  }
+
+  return files;
+}
+
+string IncludeResolver::_key(string name) {
+#ifdef _WIN32
+  // the lookups are case insensitive on windows
+  return string_tools::to_lower(name);
+#else
+  return name;
+#endif
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "FilePath.hpp"
+#include "base.hpp"
+
+// finds the files includes refer to, without a stat per candidate
+//
+// a directory is listed once (the first time an include is looked for in it) and every
+// lookup is remembered, misses included, the include directories' lookups are shared by
+// all the including files, safe to use from multiple threads
+class IncludeResolver
+{
+public:
+  // searched (in order) after the including file's directory
+  void set_include_directories(const vector<FilePath> &directories);
+
+  // the file `spec` refers to when included from `file`, empty if it's not found
+  FilePath resolve(const string &spec, const FilePath &file);
+
+  // call once the lookups are done
+  inline size_t get_listed_directory_count() const { return m_snapshots.size(); }
+
+private:
+  // the regular files of a directory
+  typedef std::unordered_set<string> snapshot;
+
+  // -1 if `spec` is in none of the include directories
+  int _find_in_include_directories(const string &spec);
+  bool _exists(const FilePath &path);
+  const snapshot &_get_snapshot(const FilePath &directory);
+
+  static snapshot _list(const FilePath &directory);
+  // the name a file is stored with in a snapshot
+  static string _key(string name);
+
+private:
+  vector<FilePath> m_directories;
+
+  std::mutex m_mutex;
+  // directory (key), it's snapshot (value), the snapshots are never moved
+  std::unordered_map<string, std::unique_ptr<const snapshot>> m_snapshots;
+  // '<including dir>\n<spec>' (key), is the spec in the including dir (value)
+  std::unordered_map<string, bool> m_local_lookups;
+  // spec (key), the index of the include directory it's in or -1 (value)
+  std::unordered_map<string, int> m_directory_lookups;
+};
@@ -1,12 +1,38 @@
 #include "SourceProcessor.hpp"
 
+#include <chrono>
 #include <set>
 
-#include "FileTools.hpp"
+#include "utility/MappedFile.hpp"
 
-static inline std::string LoadFileSource(const FilePath &path);
+// signatures of files modified this close (ns) to the scan aren't trusted, the file might
+// get written again without it's write time changing
+static constexpr int64_t RacyWriteWindowNs = 2'000'000'000;
 
 void SourceProcessor::process() {
+  m_scan_time_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+
+  m_include_resolver.set_include_directories(included_directories);
+  _stat_old_scans();
+  _scan_all();
+
+  // rare (the project changes a predefined macro), every file is scanned again as any
+  // might be included after the redefinition
+  while (_mark_redefined_macros())
+  {
+    m_scans.clear();
+    m_old_scan_records.clear();
+    _scan_all();
+  }
+
+  Logger::verbose("source processor: listed %llu directories to resolve the includes",
+                  (unsigned long long)m_include_resolver.get_listed_directory_count());
+
+  // the graph is built in the input order on this thread, so the hashes don't depend on
+  // the order the files were scanned in
   while (!m_input_stack.empty())
   {
     const InputFilePath input = m_input_stack.top();
@@ -17,20 +43,27 @@ void SourceProcessor::process() {
 
 void SourceProcessor::add_file(const InputFilePath &input) {
   m_inputs.push_back(input);
-  m_input_stack.push(input);
 
-  if (m_input_stack.top().source_type == SourceFileType::None)
+  if (m_inputs.back().source_type == SourceFileType::None)
   {
-    m_input_stack.top().source_type = SourceTools::get_default_file_type(m_input_stack.top().path);
+    m_inputs.back().source_type = SourceTools::get_default_file_type(m_inputs.back().path);
   }
+
+  m_input_stack.push(m_inputs.back());
 }
 
 hash_t SourceProcessor::get_file_hash(const FilePath &filepath) const {
-  return m_info_map.at(filepath).hash;
+  const file_id id = m_graph.find(filepath);
+  if (id == DependencyGraph::InvalidId)
+  {
+    throw std::out_of_range("no file in the dependency graph with the given path");
+  }
+
+  return m_graph.get_node(id).hash;
 }
 
 bool SourceProcessor::has_file_hash(const FilePath &filepath) const {
-  return m_info_map.find(filepath) != m_info_map.end();
+  return m_graph.find(filepath) != DependencyGraph::InvalidId;
 }
 
 SourceProcessor::file_change_list SourceProcessor::gen_file_change_table(bool inputs_only) const {
@@ -46,32 +79,32 @@ SourceProcessor::file_change_list SourceProcessor::gen_file_change_table(bool in
   }
   else
   {
-    for (const auto &kv : m_info_map)
+    for (file_id id = 0; id < m_graph.size(); id++)
     {
-      file_paths.insert(kv.first);
+      file_paths.insert(m_graph.get_path(id));
     }
   }
 
   file_change_list list{};
   for (const FilePath &src_file : file_paths)
   {
-    const DependencyInfo &value = m_info_map.at(src_file);
+    const hash_t hash = get_file_hash(src_file);
 
     const auto iter_pos = this->m_file_records.find(src_file);
 
     // no record of this file
     if (iter_pos == m_file_records.end())
     {
-      list.emplace_back(src_file, value.hash);
+      list.emplace_back(src_file, hash);
       continue;
     }
 
     // record has an invalid hash
-    if (iter_pos->second.hash != value.hash)
+    if (iter_pos->second.hash != hash)
     {
       Logger::verbose("hash mismatch %s, old: %llx, new: %llx\n",
-                      iter_pos->second.output_path.c_str(), iter_pos->second.hash, value.hash);
-      list.emplace_back(src_file, value.hash);
+                      iter_pos->second.output_path.c_str(), iter_pos->second.hash, hash);
+      list.emplace_back(src_file, hash);
     }
   }
 
@@ -80,9 +113,9 @@ SourceProcessor::file_change_list SourceProcessor::gen_file_change_table(bool in
 
 SourceProcessor::dependency_map SourceProcessor::gen_dependency_map() const {
   dependency_map map;
-  for (const auto &[key, value] : m_info_map)
+  for (const auto &[path, scan] : m_scan_records)
   {
-    map[key] = value.sub_dependencies;
+    map[path] = scan.includes;
   }
   return map;
 }
@@ -93,14 +126,116 @@ void SourceProcessor::set_file_records(const file_record_table &records) {
 }
 
 bool SourceProcessor::has_hash(hash_t hash) const {
-  for (const auto &[key, value] : m_info_map)
+  return m_graph.find_hash(hash) != DependencyGraph::InvalidId;
+}
+
+void SourceProcessor::_stat_old_scans() {
+  m_old_signatures.clear();
+  if (!m_batch_io || m_old_scan_records.empty())
+  {
+    return;
+  }
+
+  vector<FilePath> paths{};
+  paths.reserve(m_old_scan_records.size());
+  for (const auto &[path, _] : m_old_scan_records)
+  {
+    paths.push_back(path);
+  }
+
+  vector<FileSignature> signatures{};
+  m_batch_io->stat(paths, signatures);
+
+  m_old_signatures.reserve(paths.size());
+  for (size_t i = 0; i < paths.size(); i++)
   {
-    if (value.hash == hash)
+    m_old_signatures.emplace(string(paths[i]), signatures[i]);
+  }
+}
+
+void SourceProcessor::_scan_all() {
+  for (const InputFilePath &input : m_inputs)
+  {
+    _queue_scan(input.path, input.source_type);
+  }
+
+  if (m_job_pool)
+  {
+    m_job_pool->wait();
+  }
+}
+
+bool SourceProcessor::_mark_redefined_macros() {
+  bool marked = false;
+  for (const auto &[path, file_scan] : m_scans)
+  {
+    for (const string &name : file_scan.scan.redefined_macros)
     {
-      return true;
+      const auto iter = m_macros.find(name);
+      if (iter == m_macros.end() || iter->second.redefined)
+      {
+        continue;
+      }
+
+      Logger::verbose("source processor: '%s' redefines the known macro '%s', it's unknown "
+                      "to every file",
+                      path.c_str(),
+                      name.c_str());
+      iter->second.redefined = true;
+      marked = true;
     }
   }
-  return false;
+
+  return marked;
+}
+
+void SourceProcessor::_queue_scan(const FilePath &path, SourceFileType type) {
+  FileScan *file_scan = nullptr;
+  {
+    std::lock_guard guard{ m_scans_mutex };
+    const auto [iter, inserted] = m_scans.try_emplace(string(path));
+    if (!inserted)
+    {
+      return;
+    }
+    file_scan = &iter->second;
+  }
+
+  if (!m_job_pool)
+  {
+    _scan_input(*file_scan, path, type);
+    return;
+  }
+
+  m_job_pool->submit([this, file_scan, path_str = string(path), type]() {
+    _scan_input(*file_scan, FilePath(path_str), type);
+  });
+}
+
+void SourceProcessor::_scan_input(FileScan &file_scan, const FilePath &path,
+                                  SourceFileType type) {
+  file_scan.scan = _scan_file(path, type);
+
+  for (const dependency_name &name : file_scan.scan.includes)
+  {
+    const FilePath dependency_path = _find_dependency(name, path);
+
+    if (dependency_path.empty())
+    {
+      file_scan.absent_dependencies.push_back(name);
+      continue;
+    }
+
+    file_scan.dependencies.emplace_back(dependency_path);
+
+    SourceFileType dependency_type = SourceTools::get_default_file_type(dependency_path);
+    if (SourceTools::is_compatable_types(dependency_type, type))
+    {
+      dependency_type = type;
+    }
+
+    _queue_scan(dependency_path, dependency_type);
+  }
 }
 
 bool SourceProcessor::_is_processing_path(const FilePath &filepath) const {
@@ -130,47 +265,59 @@ void SourceProcessor::_pop_processing_path(const FilePath &filepath) {
   m_loading_stack.pop();
 }
 
-void SourceProcessor::_process_input(const InputFilePath &input) {
-  DependencyInfo &dep_info =
-      m_info_map.insert_or_assign(input.path, DependencyInfo()).first->second;
-  dep_info.type = input.source_type;
+SourceProcessor::file_id SourceProcessor::_process_input(const InputFilePath &input) {
+  const file_id id = m_graph.intern(input.path);
+  m_graph.set_type(id, input.source_type);
+
+  if (m_processed.size() <= id)
+  {
+    m_processed.resize(id + 1, false);
+  }
+  m_processed[id] = true;
 
   _push_processing_path(input.path);
 
-  const Buffer _raw_input_buf = FileTools::read_all(input.path, FileTools::FileKind::Text);
+  // every reachable file is scanned by `_scan_all()`
+  const FileScan &file_scan = m_scans.at(string(input.path));
+  m_scan_records.insert_or_assign(input.path, file_scan.scan);
 
-  SourceTools::get_dependencies(_raw_input_buf.to_blob<const string_char>(), dep_info.type,
-                                dep_info.sub_dependencies);
+  if (has_flags(eFlag_WarnAbsentDependencies))
+  {
+    for (const dependency_name &name : file_scan.absent_dependencies)
+    {
+      Logger::warning("dependency named \"%s\" couldn't be found for file at \"%s\"",
+                      name.c_str(), input.path.c_str());
+    }
+  }
 
-  HashDigester hash_digest;
+  vector<file_id> dependencies{};
+  dependencies.reserve(file_scan.dependencies.size());
 
-  for (size_t i = 0; i < dep_info.sub_dependencies.size(); i++)
+  for (const string &dependency_path : file_scan.dependencies)
   {
-    FilePath dependency_path =
-        _find_dependency(dep_info.sub_dependencies[i], input.path, dep_info.type);
+    dependencies.push_back(m_graph.intern(dependency_path));
+  }
 
-    if (!dependency_path.exists())
-    {
-      if (has_flags(eFlag_WarnAbsentDependencies))
-      {
-        Logger::warning("dependency named \"%s\" couldn't be found for file at \"%s\"",
-                        dep_info.sub_dependencies[i].c_str(), input.path.c_str());
-      }
-      continue;
-    }
+  m_graph.set_edges(id, { dependencies.data(), dependencies.size() });
+
+  HashDigester hash_digest;
+
+  for (size_t i = 0; i < dependencies.size(); i++)
+  {
+    const file_id dependency = dependencies[i];
 
     // the path is already processed or being processed (from a recursive caller)
     // we do this to eliminate inf recursion
-    if (has_file_hash(dependency_path))
+    if (dependency < m_processed.size() && m_processed[dependency])
     {
-      Logger::verbose("found hash for \"%s\" = %llu", dependency_path.c_str(),
-                      get_file_hash(dependency_path));
-      hash_digest += get_file_hash(dependency_path);
+      Logger::verbose("found hash for \"%s\" = %llu", file_scan.dependencies[i].c_str(),
+                      m_graph.get_node(dependency).hash);
+      hash_digest += m_graph.get_node(dependency).hash;
       continue;
     }
 
     InputFilePath sub_input;
-    sub_input.path = dependency_path;
+    sub_input.path = FilePath(file_scan.dependencies[i]);
     sub_input.source_type = SourceTools::get_default_file_type(sub_input.path);
 
     // sanity checks (might be bad)
@@ -179,14 +326,12 @@ void SourceProcessor::_process_input(const InputFilePath &input) {
       sub_input.source_type = input.source_type;
     }
 
-    // process sub dependency
-    _process_input(sub_input);
-    // add it's hash
-    hash_digest += get_file_hash(dependency_path);
+    // process sub dependency & add it's hash
+    hash_digest += m_graph.get_node(_process_input(sub_input)).hash;
   }
 
-  hash_digest += std::string(input.path);
-  hash_digest += LoadFileSource(input.path);
+  hash_digest += std::string(BuildCache::get_stored_path(m_root_directory, input.path.c_str()));
+  hash_digest += file_scan.scan.content_hash;
 
   const hash_t final_file_hash = hash_digest.value;
 
@@ -197,55 +342,61 @@ void SourceProcessor::_process_input(const InputFilePath &input) {
         final_file_hash);
   }
 
-  dep_info.hash = final_file_hash;
+  m_graph.set_hash(id, final_file_hash);
 
   _pop_processing_path(input.path);
+  return id;
 }
 
-void SourceProcessor::_rebuild_file_record_src2out_map() {
-  m_file_records_src2out_map = {};
+SourceProcessor::scan_record SourceProcessor::_scan_file(const FilePath &path,
+                                                        SourceFileType type) const {
+  const auto signature_iter = m_old_signatures.find(string(path));
+  const FileSignature signature = signature_iter != m_old_signatures.end()
+                                      ? signature_iter->second
+                                      : FileSignature::Get(path);
 
-  // key is the output file, fetch the source file for the map
-  for (const auto &[key, record] : m_file_records)
+  const auto old_iter = m_old_scan_records.find(path);
+  if (signature.is_valid() && old_iter != m_old_scan_records.end() &&
+      old_iter->second.signature == signature)
   {
-    m_file_records_src2out_map.emplace(key, record.output_path);
+    return old_iter->second;
   }
-}
 
-FilePath SourceProcessor::_find_dependency(const dependency_name &name, const FilePath &file,
-                                           SourceFileType type) const {
+  scan_record record{};
 
-  // is the dependency path local to the file?
+  // mapped once, for both the lexing & the hashing
+  const MappedFile source{ path };
+  const StrBlob source_blob = source.get_content();
 
-  FilePath local_path = FilePath(name, file.parent());
+  const auto resolver = [this, &path, type](const std::string_view &spec, bool) {
+    return !_find_dependency(string(spec), path).empty();
+  };
 
-  if (_dependency_exists(local_path, type))
-  {
-    return local_path;
-  }
+  SourceTools::get_dependencies(
+      source_blob, type, m_macros, resolver, record.includes, record.redefined_macros);
+  record.content_hash = HashTools::hash(source_blob);
 
-  for (const auto &dir : this->included_directories)
+  // a racy signature is stored invalid, so the next build scans the file again
+  if (m_scan_time_ns - signature.write_time_ns >= RacyWriteWindowNs)
   {
-    FilePath dir_path = FilePath(name, dir);
-    if (_dependency_exists(dir_path, type))
-    {
-      return dir_path;
-    }
+    record.signature = signature;
   }
 
-  return {};
+  return record;
 }
 
-bool SourceProcessor::_dependency_exists(const FilePath &path, SourceFileType type) {
-  // std::cout << "dep: " << path << '\n';
-  switch (type)
+void SourceProcessor::_rebuild_file_record_src2out_map() {
+  m_file_records_src2out_map = {};
+
+  // key is the output file, fetch the source file for the map
+  for (const auto &[key, record] : m_file_records)
   {
-  case SourceFileType::C:
-  case SourceFileType::CPP:
-    return path.is_file();
-  default:
-    return path.is_file();
+    m_file_records_src2out_map.emplace(key, record.output_path);
   }
 }
 
-inline std::string LoadFileSource(const FilePath &path) { return FileTools::read_str(path); }
+FilePath SourceProcessor::_find_dependency(const dependency_name &name,
+                                           const FilePath &file) const {
+  // local to the file first, then the included directories
+  return m_include_resolver.resolve(name, file);
+}
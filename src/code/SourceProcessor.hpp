@@ -1,21 +1,19 @@
 #pragma once
+#include <mutex>
+#include <unordered_map>
+
 #include "BuildCache.hpp"
+#include "DependencyGraph.hpp"
+#include "IncludeResolver.hpp"
 #include "SourceTools.hpp"
+#include "utility/BatchIO.hpp"
+#include "utility/JobPool.hpp"
 
 class SourceProcessor
 {
 public:
   typedef string dependency_name;
-  struct DependencyInfo
-  {
-    SourceFileType type;
-    hash_t hash = 0;
-
-    FilePath intermediate_output;
-
-    vector<dependency_name> sub_dependencies;
-    vector<FilePath> included_directories;
-  };
+  typedef DependencyGraph::file_id file_id;
 
   struct InputFilePath
   {
@@ -24,9 +22,10 @@ public:
   };
 
   typedef std::map<string, vector<dependency_name>> dependency_map;
-  typedef std::map<FilePath, DependencyInfo> dependency_info_map;
   typedef std::map<FilePath, hash_t> rainbow_table;
   typedef BuildCache::file_record_table file_record_table;
+  typedef BuildCache::ScanRecord scan_record;
+  typedef BuildCache::scan_record_table scan_record_table;
   typedef vector<pair<FilePath, hash_t>> file_change_list;
 
   enum Flags : uint8_t {
@@ -37,8 +36,7 @@ public:
   void process();
 
   void add_file(const InputFilePath &input);
-  inline dependency_info_map &get_dependency_info_map() { return m_info_map; }
-  inline const dependency_info_map &get_dependency_info_map() const { return m_info_map; }
+  inline const DependencyGraph &get_graph() const { return m_graph; }
 
   hash_t get_file_hash(const FilePath &filepath) const;
   bool has_file_hash(const FilePath &filepath) const;
@@ -62,29 +60,86 @@ public:
 
   void set_file_records(const file_record_table &records);
 
+  // the scans from the last build, a file with an unchanged signature isn't read again
+  inline void set_scan_records(scan_record_table records) { m_old_scan_records = std::move(records); }
+  // the scans of the files processed by this processor
+  inline const scan_record_table &get_scan_records() const { return m_scan_records; }
+
+  // the macros the conditionals are evaluated with, the scan records must be from a
+  // build with the same macros
+  inline void set_macros(CPreprocessor::macro_table macros) { m_macros = std::move(macros); }
+  // the macros after processing, the ones the project redefines are marked so
+  inline const CPreprocessor::macro_table &get_macros() const { return m_macros; }
+
+  // the files under `root` (ending with a separator) are hashed by their path relative to it,
+  // so their hashes don't change when the project is moved
+  inline void set_root_directory(string root) { m_root_directory = std::move(root); }
+
+  // the files are scanned on `pool` (null scans on the calling thread)
+  inline void set_job_pool(JobPool *pool) { m_job_pool = pool; }
+  // the files scanned by the last build are stat-ed in one batch on `io` (null stats each
+  // file when it's scanned)
+  inline void set_batch_io(BatchIO *io) { m_batch_io = io; }
+
   bool has_hash(hash_t hash) const;
 
   vector<FilePath> included_directories;
 
 private:
+  // a file's scan & it's resolved includes, gathered in parallel before the graph is built
+  struct FileScan
+  {
+    scan_record scan;
+    vector<string> dependencies;
+    vector<dependency_name> absent_dependencies;
+  };
+
+  // stats the files of the old scan records at once
+  void _stat_old_scans();
+  // scans every input & every file they (directly or not) include
+  void _scan_all();
+  // marks the known macros the scanned files redefine, true if any wasn't marked yet (the
+  // scans evaluated it as known & are redone)
+  bool _mark_redefined_macros();
+  // scans `path` if no other job claimed it yet
+  void _queue_scan(const FilePath &path, SourceFileType type);
+  void _scan_input(FileScan &file_scan, const FilePath &path, SourceFileType type);
+
   bool _is_processing_path(const FilePath &filepath) const;
   void _push_processing_path(const FilePath &filepath);
   void _pop_processing_path(const FilePath &filepath);
-  void _process_input(const InputFilePath &input);
+  // processes `input` & it's includes, returns it's id in the graph
+  file_id _process_input(const InputFilePath &input);
+  scan_record _scan_file(const FilePath &path, SourceFileType type) const;
 
   void _rebuild_file_record_src2out_map();
 
-  FilePath _find_dependency(const dependency_name &name, const FilePath &file,
-                            SourceFileType type) const;
-
-  static bool _dependency_exists(const FilePath &path, SourceFileType type);
+  FilePath _find_dependency(const dependency_name &name, const FilePath &file) const;
 
 private:
   Flags m_flags;
   vector<InputFilePath> m_inputs;
   vector_stack<InputFilePath> m_input_stack;
   vector_stack<FilePath> m_loading_stack;
-  dependency_info_map m_info_map;
+  DependencyGraph m_graph;
+  // the graph nodes already processed (or being processed), indexed by id
+  vector<bool> m_processed;
   file_record_table m_file_records;
   std::map<FilePath, FilePath> m_file_records_src2out_map;
+  scan_record_table m_old_scan_records;
+  scan_record_table m_scan_records;
+  CPreprocessor::macro_table m_macros;
+  string m_root_directory;
+  // caches the lookups, so it's used by the (const) scans
+  mutable IncludeResolver m_include_resolver;
+  JobPool *m_job_pool = nullptr;
+  BatchIO *m_batch_io = nullptr;
+  // path (key), the file's signature from before the scan (value), read only while scanning
+  std::unordered_map<string, FileSignature> m_old_signatures;
+  // guards the claiming of `m_scans` entries, an entry's value is only written by the job
+  // that claimed it
+  std::mutex m_scans_mutex;
+  std::unordered_map<string, FileScan> m_scans;
+  // files written after this point (ns) might still be written to in the same tick
+  int64_t m_scan_time_ns = 0;
 };
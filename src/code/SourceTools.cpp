@@ -4,23 +4,16 @@
 #include "HashTools.hpp"
 #include "code/CPreprocessor.hpp"
 
-void SourceTools::get_dependencies(const StrBlob &file, SourceFileType type, vector<string> &out) {
+void SourceTools::get_dependencies(const StrBlob &file, SourceFileType type,
+                                   const CPreprocessor::macro_table &macros,
+                                   const CPreprocessor::include_resolver &resolver,
+                                   vector<string> &out, vector<string> &redefined) {
 
   switch (type)
   {
   case SourceFileType::C:
   case SourceFileType::CPP: {
-    vector<CPreprocessor::Token> tokens{};
-
-    CPreprocessor::gather_all_tks(file, tokens);
-
-    for (const auto &token : tokens)
-    {
-      if (token.type == CPreprocessor::Type::Include)
-      {
-        out.push_back(CPreprocessor::get_include_path(std::string_view{ token.value }));
-      }
-    }
+    CPreprocessor::gather_includes(file, macros, resolver, out, redefined);
 
     return;
   }
@@ -1,6 +1,7 @@
 #pragma once
 #include "FilePath.hpp"
 #include "base.hpp"
+#include "code/CPreprocessor.hpp"
 
 enum class SourceFileType {
   None = 0,
@@ -36,7 +37,13 @@ public:
 
   };
 
-  static void get_dependencies(const StrBlob &file, SourceFileType type, vector<string> &out);
+  // the includes of `file` that aren't in a disabled conditional branch (evaluated with
+  // `macros`), `resolver` answers the '__has_include' checks, the macros of `macros` the
+  // file redefines are added to `redefined`
+  static void get_dependencies(const StrBlob &file, SourceFileType type,
+                               const CPreprocessor::macro_table &macros,
+                               const CPreprocessor::include_resolver &resolver,
+                               vector<string> &out, vector<string> &redefined);
   static FilePath get_intermediate_filepath(const FilePath &filepath, const FilePath &dst_dir);
 
   static inline bool is_compatable_types(SourceFileType type, SourceFileType partner);
@@ -1,7 +1,5 @@
 #include "BuildCommand.hpp"
 
-#include <utility/ThreadBatcher.hpp>
-
 #include "ProjectService.hpp"
 #include "code/SourceProcessor.hpp"
 
@@ -0,0 +1,218 @@
+#include "CacheCommand.hpp"
+
+#include <cstdlib>
+
+#include "BuildCache.hpp"
+#include "FieldFile.hpp"
+#include "Logger.hpp"
+#include "ObjectStore.hpp"
+#include "ProjectService.hpp"
+
+static constexpr char MaxSizePrefix[] = "--max-size=";
+
+namespace commands
+{
+  Error CacheCommand::execute(ArgumentSource &reader) {
+    if (reader.is_empty())
+    {
+      Logger::error("cache: expecting a sub command ('stats', 'gc', 'dump', 'export' or 'import')");
+      return Error::Failure;
+    }
+
+    const string sub_command = reader.read().get_value();
+
+    if (sub_command == "stats")
+    {
+      return _stats();
+    }
+
+    if (sub_command == "gc")
+    {
+      return _gc(reader);
+    }
+
+    if (sub_command == "dump")
+    {
+      return _dump(reader);
+    }
+
+    if (sub_command == "export")
+    {
+      return _export(reader);
+    }
+
+    if (sub_command == "import")
+    {
+      return _import(reader);
+    }
+
+    Logger::error(
+        "cache: unknown sub command '%s' (expecting 'stats', 'gc', 'dump', 'export' or 'import')",
+        sub_command.c_str());
+    return Error::Failure;
+  }
+
+  Error CacheCommand::get_help(ArgumentSource &reader, string &out) {
+    out.append("usage: cache stats | cache gc [--max-size=<MiB>] | cache dump <cache> [<source>]\n")
+        .append("       cache export <file> [-m=<build mode>] | cache import <file> [-m=<build mode>]\n");
+
+    out.append("stats:\n")
+        .append("  prints the object store's directory, objects count & size\n");
+
+    out.append("gc [--max-size=<MiB>]:\n")
+        .append("  evicts the least recently used objects until the store fits in it's limit\n")
+        .append("  the limit defaults to the 'object_store_max_size_mb' setting\n");
+
+    out.append("dump <cache> [<source>]:\n")
+        .append("  prints a build cache (a configuration's '.build' file) as text\n")
+        .append("  only the record of <source> (as it's keyed in the cache) if given\n")
+        .append("  the paths in the project are relative to it's directory\n");
+
+    out.append("export <file> [-m=<build mode>]:\n")
+        .append("  packs the build cache & objects of the configuration into <file>\n")
+        .append("  the configuration must be built (& up to date) first\n");
+
+    out.append("import <file> [-m=<build mode>]:\n")
+        .append("  replaces the build cache & objects of the configuration with <file>'s\n")
+        .append("  rejected if <file> isn't made for the same project, configuration & toolchain\n");
+
+    return Error();
+  }
+
+  Error CacheCommand::_stats() {
+    const ObjectStore::Stats stats = ObjectStore::GetStats();
+
+    Logger::notify("object store: %s%s",
+                   ObjectStore::GetDirectory().c_str(),
+                   ObjectStore::IsEnabled() ? "" : " (disabled)");
+    Logger::notify("objects: %llu", stats.objects_count);
+    Logger::notify("size: %.2f MiB / %.2f MiB",
+                   double(stats.total_size) / (1024.0 * 1024.0),
+                   double(stats.max_size) / (1024.0 * 1024.0));
+    return Error::Ok;
+  }
+
+  Error CacheCommand::_gc(ArgumentSource &reader) {
+    uint64_t max_size = ObjectStore::GetMaxSize();
+
+    const auto max_size_check = [](const Argument &arg) {
+      return arg.get_value().starts_with(MaxSizePrefix);
+    };
+
+    const Argument *max_size_arg = reader.extract_matching(max_size_check);
+    if (max_size_arg != nullptr)
+    {
+      const char *value = max_size_arg->get_value().c_str() + std::size(MaxSizePrefix) - 1;
+      char *end = nullptr;
+      const long long size_mb = strtoll(value, &end, 10);
+
+      if (end == value || *end != '\0' || size_mb < 0)
+      {
+        Logger::error("cache: invalid size '%s', expecting a count of MiB", value);
+        return Error::Failure;
+      }
+
+      max_size = uint64_t(size_mb) * 1024 * 1024;
+    }
+
+    const ObjectStore::Stats old_stats = ObjectStore::GetStats();
+    const size_t evicted_count = ObjectStore::Collect(max_size, true);
+    const ObjectStore::Stats stats = ObjectStore::GetStats();
+
+    Logger::notify("evicted %llu object[s], %.2f MiB freed",
+                   evicted_count,
+                   double(old_stats.total_size - stats.total_size) / (1024.0 * 1024.0));
+    return Error::Ok;
+  }
+
+  Error CacheCommand::_dump(ArgumentSource &reader) {
+    if (reader.is_empty())
+    {
+      Logger::error("cache: expecting the build cache to dump");
+      return Error::Failure;
+    }
+
+    const FilePath cache_path = FilePath(reader.read().get_value());
+
+    BuildCacheFile cache_file{};
+    const Error open_error = cache_file.open(cache_path);
+    if (open_error != Error::Ok)
+    {
+      Logger::error("cache: '%s' is not a build cache of this version (%s)",
+                    cache_path.c_str(),
+                    GetErrorName(open_error));
+      return open_error;
+    }
+
+    // a single record is looked up in place
+    if (!reader.is_empty())
+    {
+      const string source = reader.read().get_value();
+
+      const BuildCacheFile::FileRecordEntry *entry = cache_file.find_file_record(source);
+      if (entry == nullptr)
+      {
+        Logger::error("cache: no record for '%s'", source.c_str());
+        return Error::NoData;
+      }
+
+      // the paths are printed as stored
+      const BuildCache::FileRecord record = BuildCache::load_file_record(cache_file, *entry, {});
+
+      FieldVar::Dict dict{};
+      dict.emplace(source, BuildCache::write_file_record(record));
+      Logger::write_raw("%s\n", FieldFile::write(dict).c_str());
+      return Error::Ok;
+    }
+
+    ErrorReport report{};
+    const BuildCache cache = BuildCache::load(cache_file, {}, report);
+    if (report)
+    {
+      Logger::error(report);
+      return report.code;
+    }
+
+    Logger::write_raw("%s\n", FieldFile::write(cache.write()).c_str());
+    return Error::Ok;
+  }
+
+  Error CacheCommand::_export(ArgumentSource &reader) {
+    if (reader.is_empty())
+    {
+      Logger::error("cache: expecting the file to export to");
+      return Error::Failure;
+    }
+
+    const FilePath bundle_path = FilePath(reader.read().get_value());
+
+    ProjectService::SetArguments(reader);
+    const Error setup_error = ProjectService::ExecuteStepsTo(BuildStep::ProjectSetup).first;
+    if (setup_error != Error::Ok)
+    {
+      return setup_error;
+    }
+
+    return ProjectService::ExportCache(bundle_path);
+  }
+
+  Error CacheCommand::_import(ArgumentSource &reader) {
+    if (reader.is_empty())
+    {
+      Logger::error("cache: expecting the file to import");
+      return Error::Failure;
+    }
+
+    const FilePath bundle_path = FilePath(reader.read().get_value());
+
+    ProjectService::SetArguments(reader);
+    const Error setup_error = ProjectService::ExecuteStepsTo(BuildStep::ProjectSetup).first;
+    if (setup_error != Error::Ok)
+    {
+      return setup_error;
+    }
+
+    return ProjectService::ImportCache(bundle_path);
+  }
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Command.hpp"
+
+namespace commands
+{
+
+  class CacheCommand : public Command
+  {
+  public:
+    inline CacheCommand() : Command("cache", "manages the object store & the build caches") {}
+
+    Error execute(ArgumentSource &reader) override;
+    Error get_help(ArgumentSource &reader, string &out) override;
+    inline CommandInfo get_info() const override {
+      return { "cache",
+               "shows the object store's stats, evicts it's least recently used objects, "
+               "prints a build cache or exports/imports a configuration's cache" };
+    }
+
+  private:
+    Error _stats();
+    Error _gc(ArgumentSource &reader);
+    Error _dump(ArgumentSource &reader);
+    Error _export(ArgumentSource &reader);
+    Error _import(ArgumentSource &reader);
+  };
+
+}
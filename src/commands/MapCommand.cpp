@@ -1,7 +1,5 @@
 #include "MapCommand.hpp"
 
-#include <utility/ThreadBatcher.hpp>
-
 #include "ProjectService.hpp"
 #include "code/SourceProcessor.hpp"
 
@@ -10,7 +10,7 @@ Error commands::RunCommand::execute(ArgumentSource &reader) {
   Logger::verbose("do a run-build...");
 
   std::vector<Argument> build_args = {};
-  std::vector<std::string> run_args = {};
+  ArgumentList run_args = {};
 
   Logger::verbose("forwarding build args...");
   while (!reader.is_empty())
@@ -32,7 +32,8 @@ Error commands::RunCommand::execute(ArgumentSource &reader) {
     while (!reader.is_empty())
     {
       run_args.push_back(reader.read().get_value());
-      Logger::verbose("+ forwarded to run: \"%s\"", run_args.back().c_str());
+      Logger::verbose("+ forwarded to run: \"%s\"",
+                      run_args.c_str(run_args.size() - 1));
     }
   }
 
@@ -53,8 +54,7 @@ Error commands::RunCommand::execute(ArgumentSource &reader) {
   system_cmd.append(path);
   system_cmd.push_back('"');
 
-  const string args_joined =
-      build_tools::JoinArguments(run_args.data(), run_args.size());
+  const string args_joined = build_tools::JoinArguments(run_args);
 
   if (!args_joined.empty())
   {
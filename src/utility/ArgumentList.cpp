@@ -0,0 +1,68 @@
+#include "ArgumentList.hpp"
+
+std::vector<char *> ArgumentList::argv() const {
+  std::vector<char *> result{};
+  result.reserve(m_offsets.size() + 1);
+
+  // the spawning apis take `char *const[]` but never write to it
+  char *const data = const_cast<char *>(m_buffer.data());
+
+  for (uint32_t offset : m_offsets)
+  {
+    result.push_back(data + offset);
+  }
+
+  result.push_back(nullptr);
+  return result;
+}
+
+std::string ArgumentList::join() const {
+  std::string result{};
+  result.reserve(m_buffer.size() + m_offsets.size() * 2);
+
+  for (size_t i = 0; i < size(); i++)
+  {
+    if (i > 0)
+    {
+      result.push_back(' ');
+    }
+
+    AppendQuoted(result, (*this)[i]);
+  }
+
+  return result;
+}
+
+void ArgumentList::AppendQuoted(std::string &output, const std::string_view arg) {
+  const bool needs_quoting =
+      arg.empty() || arg.find_first_of(" \t\n\v\"'") != std::string_view::npos;
+
+  if (!needs_quoting)
+  {
+    output.append(arg);
+    return;
+  }
+
+  // backslashes are only escaped before a quote, so windows paths survive as they are
+  output.push_back('"');
+  size_t backslashes = 0;
+  for (char chr : arg)
+  {
+    if (chr == '\\')
+    {
+      backslashes++;
+      output.push_back(chr);
+      continue;
+    }
+
+    if (chr == '"')
+    {
+      output.append(backslashes + 1, '\\');
+    }
+
+    backslashes = 0;
+    output.push_back(chr);
+  }
+  output.append(backslashes, '\\');
+  output.push_back('"');
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// a process's argument list, the arguments are stored back to back (each null terminated)
+// in one buffer, so the list can be handed to a process as an argv without re-tokenizing
+class ArgumentList
+{
+public:
+  typedef std::string_view value_type;
+
+  class const_iterator
+  {
+  public:
+    inline const_iterator(const ArgumentList &list, size_t index)
+        : m_list{ &list }, m_index{ index } {}
+
+    inline std::string_view operator*() const { return (*m_list)[m_index]; }
+    inline const_iterator &operator++() {
+      m_index++;
+      return *this;
+    }
+    inline bool operator==(const const_iterator &other) const {
+      return m_index == other.m_index;
+    }
+    inline bool operator!=(const const_iterator &other) const {
+      return m_index != other.m_index;
+    }
+
+  private:
+    const ArgumentList *m_list;
+    size_t m_index;
+  };
+
+  ArgumentList() = default;
+  inline ArgumentList(std::initializer_list<std::string_view> args) {
+    for (std::string_view arg : args)
+    {
+      push_back(arg);
+    }
+  }
+
+  inline void push_back(std::string_view arg) {
+    m_offsets.push_back(uint32_t(m_buffer.size()));
+    m_buffer.append(arg);
+    m_buffer.push_back('\0');
+  }
+
+  // appends `str` to the last argument
+  inline void append_back(std::string_view str) {
+    m_buffer.pop_back();
+    m_buffer.append(str);
+    m_buffer.push_back('\0');
+  }
+
+  inline void extend_back(const ArgumentList &other) { extend_back(other, 0, other.size()); }
+
+  // appends the arguments [first, last) of `other`, in one copy
+  inline void extend_back(const ArgumentList &other, size_t first, size_t last) {
+    if (first >= last)
+    {
+      return;
+    }
+
+    const size_t begin = other.m_offsets[first];
+    const size_t end = last < other.size() ? other.m_offsets[last] : other.m_buffer.size();
+    const uint32_t base = uint32_t(m_buffer.size());
+
+    for (size_t i = first; i < last; i++)
+    {
+      m_offsets.push_back(base + other.m_offsets[i] - uint32_t(begin));
+    }
+    m_buffer.append(other.m_buffer, begin, end - begin);
+  }
+
+  inline void reserve(size_t args_count, size_t chars_count) {
+    m_offsets.reserve(args_count);
+    m_buffer.reserve(chars_count);
+  }
+
+  inline void clear() {
+    m_offsets.clear();
+    m_buffer.clear();
+  }
+
+  inline size_t size() const { return m_offsets.size(); }
+  inline bool empty() const { return m_offsets.empty(); }
+
+  // the total size of all arguments (with their null terminators)
+  inline size_t get_chars_count() const { return m_buffer.size(); }
+
+  inline const char *c_str(size_t index) const { return m_buffer.data() + m_offsets[index]; }
+
+  inline std::string_view operator[](size_t index) const {
+    const size_t end = index + 1 < m_offsets.size() ? m_offsets[index + 1] : m_buffer.size();
+    // excluding the null terminator
+    return { m_buffer.data() + m_offsets[index], end - m_offsets[index] - 1 };
+  }
+
+  inline std::string_view front() const { return (*this)[0]; }
+  inline std::string_view back() const { return (*this)[size() - 1]; }
+
+  inline const_iterator begin() const { return { *this, 0 }; }
+  inline const_iterator end() const { return { *this, size() }; }
+
+  // null terminated array of pointers to the arguments (as `posix_spawn()` takes them),
+  // valid until the list is modified or destroyed
+  std::vector<char *> argv() const;
+
+  // joins the arguments into a single command line, quoting the arguments that need it
+  std::string join() const;
+
+  // appends `arg` to `output`, quoted and escaped if it has spaces, quotes or is empty
+  static void AppendQuoted(std::string &output, std::string_view arg);
+
+private:
+  std::string m_buffer;
+  std::vector<uint32_t> m_offsets;
+};
@@ -0,0 +1,22 @@
+#include "ArgumentTemplate.hpp"
+
+void ArgumentTemplate::push_slot(const Slot slot) { m_slots.push_back({ m_args.size(), slot }); }
+
+void ArgumentTemplate::instantiate(ArgumentList &output,
+                                   const std::string_view input,
+                                   const std::string_view output_path) const {
+  output.clear();
+  output.reserve(m_args.size() + m_slots.size(),
+                 m_args.get_chars_count() + input.size() + output_path.size() + m_slots.size());
+
+  size_t copied = 0;
+  for (const SlotInfo &info : m_slots)
+  {
+    output.extend_back(m_args, copied, info.position);
+    copied = info.position;
+
+    output.push_back(info.slot == Slot::Input ? input : output_path);
+  }
+
+  output.extend_back(m_args, copied, m_args.size());
+}
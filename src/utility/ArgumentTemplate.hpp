@@ -0,0 +1,40 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+#include "ArgumentList.hpp"
+
+// a prebuilt argument list with slots for the per-instance arguments (input & output paths)
+//
+// the fixed arguments are formatted once, instantiating only copies them and fills the slots
+class ArgumentTemplate
+{
+public:
+  enum class Slot : uint8_t {
+    Input,
+    Output,
+  };
+
+  ArgumentTemplate() = default;
+
+  inline void push_back(std::string_view arg) { m_args.push_back(arg); }
+  inline void extend_back(const ArgumentList &args) { m_args.extend_back(args); }
+  void push_slot(Slot slot);
+
+  // writes the fixed arguments & the slot values to `output` (replacing it's contents)
+  void instantiate(ArgumentList &output, std::string_view input, std::string_view output_path) const;
+
+  inline const ArgumentList &get_fixed_args() const { return m_args; }
+  inline size_t get_slots_count() const { return m_slots.size(); }
+
+private:
+  struct SlotInfo
+  {
+    // the slot comes before the fixed argument at this index
+    size_t position;
+    Slot slot;
+  };
+
+  ArgumentList m_args;
+  std::vector<SlotInfo> m_slots;
+};
@@ -0,0 +1,127 @@
+#include "AtomicFile.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <Windows.h>
+#endif
+
+// writes & flushes `content` to the disk, before it's renamed over anything
+static bool WriteSynced(const FilePath &path, const StrBlob &content);
+
+FilePath AtomicFile::GetTemporaryPath(const FilePath &path) {
+#ifdef __linux__
+  const unsigned long process_id = (unsigned long)getpid();
+#else
+  const unsigned long process_id = (unsigned long)GetCurrentProcessId();
+#endif
+
+  char suffix[32] = {};
+  snprintf(suffix, sizeof(suffix), ".%lu.tmp", process_id);
+  return FilePath(string(path.c_str()) + suffix);
+}
+
+bool AtomicFile::Write(const FilePath &path, const StrBlob &content) {
+  const FilePath temporary_path = GetTemporaryPath(path);
+
+  if (!WriteSynced(temporary_path, content))
+  {
+    temporary_path.remove();
+    return false;
+  }
+
+  return Replace(temporary_path, path);
+}
+
+bool AtomicFile::Replace(const FilePath &temporary_path, const FilePath &path) {
+  std::error_code err_code{};
+  std::filesystem::rename(temporary_path.to_std_path(), path.to_std_path(), err_code);
+
+  if (err_code)
+  {
+    temporary_path.remove();
+    return false;
+  }
+
+  return true;
+}
+
+bool AtomicFile::SyncDirectory(const FilePath &directory) {
+#ifdef __linux__
+  const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  const bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+#else
+  // the renames are flushed with the files on windows
+  (void)directory;
+  return true;
+#endif
+}
+
+inline bool WriteSynced(const FilePath &path, const StrBlob &content) {
+#ifdef __linux__
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  size_t written = 0;
+  while (written < content.size())
+  {
+    const ssize_t result = write(fd, content.data + written, content.size() - written);
+    if (result < 0 && errno == EINTR)
+    {
+      continue;
+    }
+
+    if (result <= 0)
+    {
+      close(fd);
+      return false;
+    }
+
+    written += size_t(result);
+  }
+
+  const bool synced = fsync(fd) == 0;
+  return close(fd) == 0 && synced;
+#else
+  const HANDLE file = CreateFileA(
+      path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  size_t written = 0;
+  while (written < content.size())
+  {
+    const DWORD chunk = DWORD(std::min<size_t>(content.size() - written, 1 << 30));
+    DWORD chunk_written = 0;
+    if (!WriteFile(file, content.data + written, chunk, &chunk_written, nullptr) ||
+        chunk_written == 0)
+    {
+      CloseHandle(file);
+      return false;
+    }
+
+    written += chunk_written;
+  }
+
+  const bool synced = FlushFileBuffers(file) != FALSE;
+  return CloseHandle(file) != FALSE && synced;
+#endif
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "FilePath.hpp"
+#include "base.hpp"
+
+// files replaced as a whole, written to a temporary file next to them then renamed over them,
+// so a reader (without any lock) sees the old content or the new one but never a part of it
+class AtomicFile
+{
+public:
+  AtomicFile() = delete;
+
+  // a name next to `path`, unique to this process
+  static FilePath GetTemporaryPath(const FilePath &path);
+
+  // the content is on the disk before it's renamed over `path`, see `SyncDirectory` for the
+  // rename itself
+  static bool Write(const FilePath &path, const StrBlob &content);
+
+  // renames `temporary_path` over `path`, `temporary_path` is removed if it can't be
+  static bool Replace(const FilePath &temporary_path, const FilePath &path);
+
+  // flushes the renames into `directory` to the disk
+  static bool SyncDirectory(const FilePath &directory);
+};
@@ -0,0 +1,483 @@
+#include "BatchIO.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "Logger.hpp"
+#include "MappedFile.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BATCH_IO_URING 1
+#endif
+
+#if BATCH_IO_URING
+static inline int64_t ToNs(const statx_timestamp &timestamp);
+
+// a minimal io_uring, set up with the raw syscalls (no liburing)
+struct BatchIO::Ring
+{
+  // null if the kernel has no io_uring or it lacks one of the used operations
+  static std::unique_ptr<Ring> Create(uint32_t entries);
+
+  inline ~Ring();
+
+  // runs `count` requests, `prepare(index, sqe)` fills a request & `complete(index, result)`
+  // gets it's result (a negative errno on failure), false if the ring failed, the requests
+  // submitted before the failure are still completed (they write to the caller's memory)
+  template <typename Prepare, typename Complete>
+  bool run(size_t count, Prepare &&prepare, Complete &&complete);
+
+  int fd = -1;
+  uint32_t entries = 0;
+
+  void *sq_memory = nullptr;
+  size_t sq_memory_size = 0;
+  void *cq_memory = nullptr;
+  size_t cq_memory_size = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqes_size = 0;
+
+  unsigned *sq_head = nullptr;
+  unsigned *sq_tail = nullptr;
+  unsigned *sq_mask = nullptr;
+  unsigned *sq_array = nullptr;
+
+  unsigned *cq_head = nullptr;
+  unsigned *cq_tail = nullptr;
+  unsigned *cq_mask = nullptr;
+  io_uring_cqe *cqes = nullptr;
+};
+
+std::unique_ptr<BatchIO::Ring> BatchIO::Ring::Create(uint32_t entries) {
+  io_uring_params params = {};
+  const int fd = int(syscall(__NR_io_uring_setup, entries, &params));
+  if (fd < 0)
+  {
+    Logger::verbose("batch io: no io_uring (%s), using the job pool", strerror(errno));
+    return nullptr;
+  }
+
+  auto ring = std::make_unique<Ring>();
+  ring->fd = fd;
+  ring->entries = params.sq_entries;
+
+  // the operations need linux 5.6
+  constexpr size_t ProbeOpsCount = 256;
+  std::unique_ptr<uint8_t[]> probe_memory{
+    new uint8_t[sizeof(io_uring_probe) + ProbeOpsCount * sizeof(io_uring_probe_op)]{}
+  };
+  io_uring_probe *const probe = reinterpret_cast<io_uring_probe *>(probe_memory.get());
+
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, ProbeOpsCount) < 0)
+  {
+    Logger::verbose("batch io: can't probe the io_uring (%s), using the job pool",
+                    strerror(errno));
+    return nullptr;
+  }
+
+  for (const uint8_t op : { IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE })
+  {
+    if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+    {
+      Logger::verbose("batch io: the io_uring lacks operation %d, using the job pool", int(op));
+      return nullptr;
+    }
+  }
+
+  ring->sq_memory_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_memory_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+  const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap)
+  {
+    ring->sq_memory_size = ring->cq_memory_size =
+        std::max(ring->sq_memory_size, ring->cq_memory_size);
+  }
+
+  ring->sq_memory = mmap(nullptr, ring->sq_memory_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring->sq_memory == MAP_FAILED)
+  {
+    ring->sq_memory = nullptr;
+    return nullptr;
+  }
+
+  ring->cq_memory = single_mmap ? ring->sq_memory
+                                : mmap(nullptr, ring->cq_memory_size, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  if (ring->cq_memory == MAP_FAILED)
+  {
+    ring->cq_memory = nullptr;
+    return nullptr;
+  }
+
+  ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  void *const sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    return nullptr;
+  }
+  ring->sqes = static_cast<io_uring_sqe *>(sqes);
+
+  uint8_t *const sq = static_cast<uint8_t *>(ring->sq_memory);
+  ring->sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  ring->sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  ring->sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  ring->sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+  uint8_t *const cq = static_cast<uint8_t *>(ring->cq_memory);
+  ring->cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  ring->cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  ring->cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  ring->cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+  return ring;
+}
+
+inline BatchIO::Ring::~Ring() {
+  if (sqes != nullptr)
+  {
+    munmap(sqes, sqes_size);
+  }
+  if (cq_memory != nullptr && cq_memory != sq_memory)
+  {
+    munmap(cq_memory, cq_memory_size);
+  }
+  if (sq_memory != nullptr)
+  {
+    munmap(sq_memory, sq_memory_size);
+  }
+  if (fd >= 0)
+  {
+    ::close(fd);
+  }
+}
+
+template <typename Prepare, typename Complete>
+inline bool BatchIO::Ring::run(size_t count, Prepare &&prepare, Complete &&complete) {
+  size_t queued = 0;
+  size_t completed = 0;
+  // queued, but not taken by the kernel yet
+  unsigned unsubmitted = 0;
+  // nothing is queued after a failure, but the submitted requests are still waited for
+  bool failed = false;
+
+  while (failed ? completed < queued - unsubmitted : completed < count)
+  {
+    // the completion queue is at least as big as the submission queue, so keeping the
+    // in flight requests under `entries` never overflows it
+    unsigned tail = *sq_tail;
+    while (!failed && queued < count && queued - completed < entries)
+    {
+      const unsigned index = tail & *sq_mask;
+
+      io_uring_sqe &sqe = sqes[index];
+      std::memset(&sqe, 0, sizeof(sqe));
+      prepare(queued, sqe);
+      sqe.user_data = queued;
+
+      sq_array[index] = index;
+      tail++;
+      queued++;
+      unsubmitted++;
+    }
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+    // submits the queued requests & waits for one to complete at least
+    const long entered = syscall(__NR_io_uring_enter, fd, failed ? 0 : unsubmitted, 1,
+                                 IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (entered >= 0)
+    {
+      unsubmitted -= failed ? 0 : unsigned(entered);
+    }
+    else if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+    {
+      if (!failed)
+      {
+        Logger::warning("batch io: the io_uring failed (%s)", strerror(errno));
+        failed = true;
+      }
+      else
+      {
+        // the ring can't wait, the completions are posted to it's queue regardless
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+
+    unsigned head = *cq_head;
+    const unsigned cq_end = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != cq_end; head++)
+    {
+      const io_uring_cqe &cqe = cqes[head & *cq_mask];
+      complete(size_t(cqe.user_data), cqe.res);
+      completed++;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  return !failed;
+}
+#else
+struct BatchIO::Ring
+{};
+#endif
+
+template <typename Func>
+inline void BatchIO::_run(size_t count, Func &&function) {
+  if (m_pool)
+  {
+    m_pool->run(count, function);
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    function(i);
+  }
+}
+
+BatchIO::BatchIO(JobPool *pool) : m_pool{ pool } {
+#if BATCH_IO_URING
+  m_ring = Ring::Create(QueueDepth);
+#endif
+}
+
+BatchIO::~BatchIO() = default;
+
+bool BatchIO::has_ring() const noexcept { return m_ring != nullptr; }
+
+void BatchIO::stat(const vector<FilePath> &paths, vector<FileSignature> &out) {
+  out.assign(paths.size(), FileSignature{});
+
+#if BATCH_IO_URING
+  if (m_ring)
+  {
+    vector<struct statx> stats(paths.size());
+
+    const bool success = m_ring->run(
+        paths.size(),
+        [&paths, &stats](size_t index, io_uring_sqe &sqe) {
+          sqe.opcode = IORING_OP_STATX;
+          sqe.fd = AT_FDCWD;
+          sqe.addr = uint64_t(paths[index].c_str());
+          sqe.len = STATX_BASIC_STATS;
+          sqe.off = uint64_t(&stats[index]);
+        },
+        [&stats, &out](size_t index, int result) {
+          if (result < 0)
+          {
+            return;
+          }
+
+          // the same as `FileSignature::Get`
+          const struct statx &file_stats = stats[index];
+          out[index].size = int64_t(file_stats.stx_size);
+          out[index].write_time_ns = ToNs(file_stats.stx_mtime);
+          out[index].change_time_ns = ToNs(file_stats.stx_ctime);
+          out[index].inode = file_stats.stx_ino;
+        });
+
+    if (success)
+    {
+      return;
+    }
+    m_ring = nullptr;
+  }
+#endif
+
+  _run(paths.size(),
+       [&paths, &out](size_t index) { out[index] = FileSignature::Get(paths[index]); });
+}
+
+void BatchIO::read(const vector<FilePath> &paths, const read_callback &callback,
+                   size_t max_size) {
+  if (!m_ring)
+  {
+    _read_mapped(paths, 0, paths.size(), callback, max_size);
+    return;
+  }
+
+  // a window at a time, which bounds the memory the contents take
+  for (size_t begin = 0; begin < paths.size(); begin += QueueDepth)
+  {
+    const size_t end = std::min(paths.size(), begin + QueueDepth);
+
+    // a failing window drops the ring, the rest are mapped
+    if (m_ring)
+    {
+      _read_window(paths, begin, end, callback, max_size);
+    }
+    else
+    {
+      _read_mapped(paths, begin, end, callback, max_size);
+    }
+  }
+}
+
+void BatchIO::_read_mapped(const vector<FilePath> &paths, size_t begin, size_t end,
+                           const read_callback &callback, size_t max_size) {
+  _run(end - begin, [&paths, &callback, begin, max_size](size_t index) {
+    const MappedFile file{ paths[begin + index] };
+    callback(begin + index, StrBlob{ file.data(), std::min(file.size(), max_size) },
+             file.is_open());
+  });
+}
+
+void BatchIO::_read_window(const vector<FilePath> &paths, size_t begin, size_t end,
+                           const read_callback &callback, size_t max_size) {
+#if BATCH_IO_URING
+  struct FileRead
+  {
+    int fd = -1;
+    struct statx stats = {};
+    bool stat_success = false;
+    // how much is read, the whole file or the first `max_size` bytes of it
+    size_t length = 0;
+    // the content when it's read through the ring
+    string content = {};
+    bool read_success = false;
+  };
+
+  const size_t count = end - begin;
+  vector<FileRead> reads(count);
+
+  // stat & open round, two requests per file
+  bool success = m_ring->run(
+      count * 2,
+      [&paths, &reads, begin](size_t index, io_uring_sqe &sqe) {
+        FileRead &read = reads[index / 2];
+        const char *const path = paths[begin + index / 2].c_str();
+
+        sqe.fd = AT_FDCWD;
+        sqe.addr = uint64_t(path);
+        if (index % 2 == 0)
+        {
+          sqe.opcode = IORING_OP_STATX;
+          sqe.len = STATX_BASIC_STATS;
+          sqe.off = uint64_t(&read.stats);
+        }
+        else
+        {
+          sqe.opcode = IORING_OP_OPENAT;
+          sqe.open_flags = O_RDONLY | O_CLOEXEC;
+        }
+      },
+      [&reads](size_t index, int result) {
+        FileRead &read = reads[index / 2];
+        if (index % 2 == 0)
+        {
+          read.stat_success = result >= 0;
+        }
+        else
+        {
+          read.fd = result >= 0 ? result : -1;
+        }
+      });
+
+  // read round, the regular files small enough for it, with one extra byte to catch the
+  // files that grew since the stat (unless only their start is read)
+  vector<size_t> batched{};
+  for (size_t i = 0; success && i < count; i++)
+  {
+    FileRead &read = reads[i];
+    if (!(read.fd >= 0 && read.stat_success && S_ISREG(read.stats.stx_mode)))
+    {
+      continue;
+    }
+
+    read.length = std::min(size_t(read.stats.stx_size), max_size);
+    if (read.length <= MaxBatchedReadSize)
+    {
+      read.content.resize(read.length < max_size ? read.length + 1 : read.length);
+      batched.push_back(i);
+    }
+  }
+
+  const auto prepare_read = [&reads, &batched](size_t index, io_uring_sqe &sqe) {
+    FileRead &read = reads[batched[index]];
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = read.fd;
+    sqe.addr = uint64_t(read.content.data());
+    sqe.len = uint32_t(read.content.size());
+    sqe.off = 0;
+  };
+  const auto complete_read = [&reads, &batched](size_t index, int result) {
+    FileRead &read = reads[batched[index]];
+    read.read_success = result == int(read.length);
+    if (read.read_success)
+    {
+      read.content.resize(size_t(result));
+    }
+  };
+
+  success = success && m_ring->run(batched.size(), prepare_read, complete_read);
+
+  // close round, the files are closed directly if the ring failed
+  vector<size_t> opened{};
+  for (size_t i = 0; i < count; i++)
+  {
+    if (reads[i].fd >= 0)
+    {
+      opened.push_back(i);
+    }
+  }
+
+  const auto prepare_close = [&reads, &opened](size_t index, io_uring_sqe &sqe) {
+    sqe.opcode = IORING_OP_CLOSE;
+    sqe.fd = reads[opened[index]].fd;
+  };
+  const auto complete_close = [&reads, &opened](size_t index, int result) {
+    if (result >= 0)
+    {
+      reads[opened[index]].fd = -1;
+    }
+  };
+
+  const bool closed = success && m_ring->run(opened.size(), prepare_close, complete_close);
+
+  // the files left open by a failed round (the closed ones might be reused already)
+  if (!closed)
+  {
+    for (const size_t i : opened)
+    {
+      if (reads[i].fd >= 0)
+      {
+        ::close(reads[i].fd);
+      }
+    }
+
+    // every request of the failed round is completed, nothing in flight uses the ring
+    m_ring = nullptr;
+  }
+
+  // the big files, the ones that changed while read & special files are mapped (or read)
+  _run(count, [&paths, &reads, &callback, begin, max_size](size_t index) {
+    const FileRead &read = reads[index];
+    if (read.read_success)
+    {
+      callback(begin + index, StrBlob{ read.content.data(), read.content.size() }, true);
+      return;
+    }
+
+    const MappedFile file{ paths[begin + index] };
+    callback(begin + index, StrBlob{ file.data(), std::min(file.size(), max_size) },
+             file.is_open());
+  });
+#endif
+}
+
+#if BATCH_IO_URING
+inline int64_t ToNs(const statx_timestamp &timestamp) {
+  return int64_t(timestamp.tv_sec) * 1000000000 + timestamp.tv_nsec;
+}
+#endif
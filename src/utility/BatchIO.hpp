@@ -0,0 +1,62 @@
+#pragma once
+#include <functional>
+#include <memory>
+
+#include "FilePath.hpp"
+#include "base.hpp"
+#include "utility/FileStats.hpp"
+#include "utility/JobPool.hpp"
+
+// runs batches of file system requests (stats & whole file reads) with few syscalls
+//
+// on linux the requests go through an io_uring, a ring's worth of them is submitted and
+// reaped with one `io_uring_enter`, reads are batched as an open, read & close round each,
+// when the kernel has no io_uring (or it's disabled) the requests are spread over the job
+// pool instead, a batch is used from one thread at a time
+class BatchIO
+{
+public:
+  // the most requests in flight at once
+  static constexpr uint32_t QueueDepth = 256;
+  // bigger files are mapped instead of read through the ring
+  static constexpr size_t MaxBatchedReadSize = 256 * 1024;
+
+  // called with the path's index & it's content (empty if it can't be read), on the calling
+  // thread or the job pool's workers (possibly at the same time), the content is only valid
+  // during the call
+  typedef std::function<void(size_t index, const StrBlob &content, bool success)> read_callback;
+
+  // `pool` runs the read callbacks (& the requests without an io_uring), can be null
+  explicit BatchIO(JobPool *pool = nullptr);
+  ~BatchIO();
+
+  BatchIO(const BatchIO &) = delete;
+  BatchIO &operator=(const BatchIO &) = delete;
+
+  // `out[i]` is the signature of `paths[i]`, invalid for the paths that can't be stat-ed
+  void stat(const vector<FilePath> &paths, vector<FileSignature> &out);
+
+  // reads every path & calls `callback` with it's content, only the first `max_size` bytes
+  // are read of the bigger files (headers), so a success with less content is a smaller file
+  void read(const vector<FilePath> &paths, const read_callback &callback,
+            size_t max_size = SIZE_MAX);
+
+  // false if the requests are spread over the job pool
+  bool has_ring() const noexcept;
+
+private:
+  void _read_window(const vector<FilePath> &paths, size_t begin, size_t end,
+                    const read_callback &callback, size_t max_size);
+  // reads the paths in [begin, end) by mapping them, without the ring
+  void _read_mapped(const vector<FilePath> &paths, size_t begin, size_t end,
+                    const read_callback &callback, size_t max_size);
+
+  // runs `function(index)` for every index, on the job pool when there is one
+  template <typename Func>
+  void _run(size_t count, Func &&function);
+
+private:
+  struct Ring;
+  std::unique_ptr<Ring> m_ring;
+  JobPool *m_pool = nullptr;
+};
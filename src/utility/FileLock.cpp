@@ -0,0 +1,136 @@
+#include "FileLock.hpp"
+
+#include <cerrno>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#else
+#include <Windows.h>
+#endif
+
+bool FileLock::open(const FilePath &path) {
+  close();
+
+#ifdef __linux__
+  m_file = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (m_file < 0)
+  {
+    m_file = InvalidFile;
+    return false;
+  }
+#else
+  m_file = CreateFileA(path.c_str(),
+                       GENERIC_READ | GENERIC_WRITE,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       nullptr,
+                       OPEN_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL,
+                       nullptr);
+  if (m_file == INVALID_HANDLE_VALUE)
+  {
+    m_file = InvalidFile;
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+void FileLock::close() noexcept {
+  if (!is_open())
+  {
+    return;
+  }
+
+  unlock();
+#ifdef __linux__
+  ::close(m_file);
+#else
+  CloseHandle(m_file);
+#endif
+  m_file = InvalidFile;
+}
+
+bool FileLock::lock(Mode mode) { return _lock(mode, true); }
+
+bool FileLock::try_lock(Mode mode) { return _lock(mode, false); }
+
+void FileLock::unlock() noexcept {
+  if (!m_locked)
+  {
+    return;
+  }
+
+#ifdef __linux__
+  if (m_flocked)
+  {
+    flock(m_file, LOCK_UN);
+  }
+  else
+  {
+    struct flock lock_info = {};
+    lock_info.l_type = F_UNLCK;
+    lock_info.l_whence = SEEK_SET;
+    fcntl(m_file, F_OFD_SETLK, &lock_info);
+  }
+#else
+  OVERLAPPED overlapped = {};
+  UnlockFileEx(m_file, 0, MAXDWORD, MAXDWORD, &overlapped);
+#endif
+  m_locked = false;
+}
+
+bool FileLock::_lock(Mode mode, bool wait) {
+  if (!is_open())
+  {
+    return false;
+  }
+
+#ifdef __linux__
+  struct flock lock_info = {};
+  lock_info.l_type = mode == Mode::Shared ? F_RDLCK : F_WRLCK;
+  lock_info.l_whence = SEEK_SET;
+
+  int result = 0;
+  do
+  {
+    result = fcntl(m_file, wait ? F_OFD_SETLKW : F_OFD_SETLK, &lock_info);
+  } while (result != 0 && errno == EINTR);
+
+  // no open file description locks (older than 3.15 kernels)
+  m_flocked = result != 0 && errno == EINVAL;
+  if (m_flocked)
+  {
+    const int operation = (mode == Mode::Shared ? LOCK_SH : LOCK_EX) | (wait ? 0 : LOCK_NB);
+    do
+    {
+      result = flock(m_file, operation);
+    } while (result != 0 && errno == EINTR);
+  }
+
+  if (result != 0)
+  {
+    return false;
+  }
+#else
+  // converting a held lock, windows locks don't
+  unlock();
+
+  DWORD flags = mode == Mode::Exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0;
+  if (!wait)
+  {
+    flags |= LOCKFILE_FAIL_IMMEDIATELY;
+  }
+
+  OVERLAPPED overlapped = {};
+  if (!LockFileEx(m_file, flags, 0, MAXDWORD, MAXDWORD, &overlapped))
+  {
+    return false;
+  }
+#endif
+
+  m_locked = true;
+  return true;
+}
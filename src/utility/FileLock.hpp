@@ -0,0 +1,56 @@
+#pragma once
+#include "FilePath.hpp"
+#include "base.hpp"
+
+// an advisory lock on a file, shared by the processes that agree to take it
+//
+// on linux the lock is an open file description lock (`F_OFD_SETLK`, owned by the opened file
+// not the process, so threads & forks don't share it by accident), falling back to `flock`
+// on the kernels without them, on windows it's `LockFileEx`, the lock is released when the
+// file is closed (or the process dies), the lock file itself is never removed
+class FileLock
+{
+public:
+  enum class Mode : uint8_t {
+    // any count of shared holders, excludes the exclusive ones
+    Shared,
+    Exclusive,
+  };
+
+  inline FileLock() = default;
+  inline ~FileLock() noexcept { close(); }
+
+  FileLock(const FileLock &) = delete;
+  FileLock &operator=(const FileLock &) = delete;
+
+  // opens (creating if needed) the lock file at `path`
+  bool open(const FilePath &path);
+  // unlocks & closes the file
+  void close() noexcept;
+
+  // blocks until the lock is held, a held lock is converted to `mode`
+  bool lock(Mode mode);
+  // returns false if another holder excludes `mode`
+  bool try_lock(Mode mode);
+  void unlock() noexcept;
+
+  inline bool is_open() const noexcept { return m_file != InvalidFile; }
+  inline bool is_locked() const noexcept { return m_locked; }
+
+private:
+  bool _lock(Mode mode, bool wait);
+
+private:
+#ifdef __linux__
+  typedef int file_handle;
+  static constexpr file_handle InvalidFile = -1;
+#else
+  typedef void *file_handle;
+  static constexpr file_handle InvalidFile = nullptr;
+#endif
+
+  file_handle m_file = InvalidFile;
+  bool m_locked = false;
+  // locked with `flock`, the kernel has no open file description locks
+  bool m_flocked = false;
+};
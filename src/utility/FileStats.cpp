@@ -5,11 +5,12 @@
 typedef timespec FILETIME;
 #else
 #include <Windows.h>
-typedef DWORLD mode_t;
+typedef DWORD mode_t;
 #endif
 
 typedef std::chrono::microseconds microseconds;
 
+static inline int64_t ToNs(const FILETIME &file_time);
 static inline microseconds ToMs(const FILETIME &file_time);
 static inline FileFlags OsAttrs2FileFlags(mode_t flags);
 
@@ -51,14 +52,49 @@ FileStats::FileStats(const FilePath &path) {
 #endif
 }
 
-inline microseconds ToMs(const FILETIME &file_time) {
+FileSignature FileSignature::Get(const FilePath &path) {
+  FileSignature signature{};
 #ifdef __linux__
-  return microseconds(file_time.tv_sec + (file_time.tv_nsec / 1000000));
+  struct stat file_stats = { 0 };
+  if (stat(path.c_str(), &file_stats))
+  {
+    return signature;
+  }
+
+  signature.size = file_stats.st_size;
+  signature.write_time_ns = ToNs(file_stats.st_mtim);
+  signature.change_time_ns = ToNs(file_stats.st_ctim);
+  signature.inode = file_stats.st_ino;
 #else
-  constexpr auto HighDateBits = sizeof(file_time.dwHighDateTime) * 8;
-  return microseconds(file_time.dwLowDateTime |
-                      (int64_t(file_time.dwHighDateTime) << HighDateBits));
+  WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+  if (!GetFileAttributesExA(
+          path.c_str(), GET_FILEEX_INFO_LEVELS::GetFileExInfoStandard, &attributes))
+  {
+    return signature;
+  }
+
+  signature.size = int64_t(attributes.nFileSizeLow |
+                           (uint64_t(attributes.nFileSizeHigh) << 32));
+  signature.write_time_ns = ToNs(attributes.ftLastWriteTime);
+  signature.change_time_ns = ToNs(attributes.ftCreationTime);
 #endif
+  return signature;
+}
+
+inline int64_t ToNs(const FILETIME &file_time) {
+#ifdef __linux__
+  return int64_t(file_time.tv_sec) * 1000000000 + file_time.tv_nsec;
+#else
+  // 100ns ticks since 1601-01-01
+  constexpr int64_t UnixEpochTicks = 116444736000000000LL;
+  const int64_t ticks =
+      int64_t(file_time.dwLowDateTime | (uint64_t(file_time.dwHighDateTime) << 32));
+  return (ticks - UnixEpochTicks) * 100;
+#endif
+}
+
+inline microseconds ToMs(const FILETIME &file_time) {
+  return microseconds(ToNs(file_time) / 1000);
 }
 
 inline FileFlags OsAttrs2FileFlags(mode_t flags) {
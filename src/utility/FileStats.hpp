@@ -25,3 +25,25 @@ struct FileStats
 
   FileFlags flags;
 };
+
+// a cheap (stat only) identity of a file's content, if the signature of a file didn't
+// change then it's content is assumed to be unchanged
+struct FileSignature
+{
+  int64_t size = 0;
+  int64_t write_time_ns = 0;
+  // the inode's change time, catches writes that restore the old write time
+  int64_t change_time_ns = 0;
+  uint64_t inode = 0;
+
+  // returns an invalid (zeroed) signature if the file can't be stat-ed
+  static FileSignature Get(const FilePath &path);
+
+  inline bool is_valid() const { return write_time_ns != 0; }
+
+  inline bool operator==(const FileSignature &other) const {
+    return size == other.size && write_time_ns == other.write_time_ns &&
+           change_time_ns == other.change_time_ns && inode == other.inode;
+  }
+  inline bool operator!=(const FileSignature &other) const { return !(*this == other); }
+};
@@ -0,0 +1,174 @@
+#include "JobPool.hpp"
+
+#include <exception>
+
+// the pool and the worker index of the calling thread, if it's a pool worker
+static thread_local const JobPool *t_worker_pool = nullptr;
+static thread_local size_t t_worker_index = npos;
+
+JobPool::JobPool(uint32_t workers_count) {
+  if (workers_count == 0)
+  {
+    workers_count = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  m_workers_count = workers_count;
+  m_workers.reset(new Worker[m_workers_count]);
+
+  for (uint32_t i = 0; i < m_workers_count; i++)
+  {
+    m_workers[i].thread = std::thread{ &JobPool::_worker_main, this, i };
+  }
+
+  Logger::verbose("JobPool: started %u workers", m_workers_count);
+}
+
+JobPool::~JobPool() {
+  wait();
+
+  {
+    std::scoped_lock<std::mutex> lock{ m_wake_mutex };
+    m_stopping = true;
+  }
+  m_wake_cv.notify_all();
+
+  for (uint32_t i = 0; i < m_workers_count; i++)
+  {
+    m_workers[i].thread.join();
+  }
+}
+
+void JobPool::submit(Job &&job) {
+  m_unfinished_count++;
+
+  if (t_worker_pool == this)
+  {
+    Worker &worker = m_workers[t_worker_index];
+    std::scoped_lock<std::mutex> lock{ worker.mutex };
+    worker.jobs.emplace_back(std::move(job));
+  }
+  else
+  {
+    std::scoped_lock<std::mutex> lock{ m_shared_mutex };
+    m_shared_jobs.emplace_back(std::move(job));
+  }
+
+  {
+    std::scoped_lock<std::mutex> lock{ m_wake_mutex };
+    m_queued_count++;
+  }
+  m_wake_cv.notify_one();
+}
+
+void JobPool::wait() {
+  _help_until([this]() { return m_unfinished_count.load() == 0; });
+}
+
+bool JobPool::is_worker_thread() const { return t_worker_pool == this; }
+
+size_t JobPool::_current_worker_index() const {
+  return is_worker_thread() ? t_worker_index : npos;
+}
+
+void JobPool::_worker_main(const uint32_t index) {
+  t_worker_pool = this;
+  t_worker_index = index;
+
+  while (true)
+  {
+    Job job;
+    if (_try_acquire(index, job))
+    {
+      _execute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock{ m_wake_mutex };
+    m_wake_cv.wait(lock, [this]() { return m_stopping || m_queued_count.load() > 0; });
+
+    if (m_stopping && m_queued_count.load() <= 0)
+    {
+      return;
+    }
+  }
+}
+
+bool JobPool::_try_acquire(const size_t index, Job &job) {
+  // own deque, newest first
+  if (index != npos)
+  {
+    Worker &worker = m_workers[index];
+    std::scoped_lock<std::mutex> lock{ worker.mutex };
+
+    if (!worker.jobs.empty())
+    {
+      job = std::move(worker.jobs.back());
+      worker.jobs.pop_back();
+      m_queued_count--;
+      return true;
+    }
+  }
+
+  // shared queue, in submission order
+  {
+    std::scoped_lock<std::mutex> lock{ m_shared_mutex };
+
+    if (!m_shared_jobs.empty())
+    {
+      job = std::move(m_shared_jobs.front());
+      m_shared_jobs.pop_front();
+      m_queued_count--;
+      return true;
+    }
+  }
+
+  return _try_steal(index, job);
+}
+
+bool JobPool::_try_steal(const size_t thief_index, Job &job) {
+  // start after the thief, so not every thief hammers the first worker
+  const size_t start = thief_index == npos ? 0 : thief_index + 1;
+
+  for (size_t i = 0; i < m_workers_count; i++)
+  {
+    const size_t victim_index = (start + i) % m_workers_count;
+    if (victim_index == thief_index)
+    {
+      continue;
+    }
+
+    Worker &victim = m_workers[victim_index];
+    std::scoped_lock<std::mutex> lock{ victim.mutex };
+
+    if (!victim.jobs.empty())
+    {
+      job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      m_queued_count--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void JobPool::_execute(Job &job) {
+  try
+  {
+    job();
+  }
+  catch (const std::exception &e)
+  {
+    Logger::error("JobPool: a job raised an exception: %s", e.what());
+  }
+
+  if (m_unfinished_count.fetch_sub(1) == 1)
+  {
+    _notify_done();
+  }
+}
+
+void JobPool::_notify_done() {
+  std::scoped_lock<std::mutex> lock{ m_wake_mutex };
+  m_wake_cv.notify_all();
+}
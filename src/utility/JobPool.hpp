@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Logger.hpp"
+#include "base.hpp"
+
+// a persistent pool of worker threads with a work-stealing scheduler
+//
+// jobs submitted from outside the pool go to a shared FIFO (so the submission order is the
+// dispatch order), jobs submitted from inside a worker go to that worker's own deque.
+// an idle worker takes from it's own deque first (newest first), then from the shared queue,
+// then steals from the other workers (oldest first)
+class JobPool
+{
+public:
+  typedef std::function<void()> Job;
+  typedef uint64_t job_count_t;
+
+  // `workers_count` of zero means one worker per hardware thread
+  explicit JobPool(uint32_t workers_count = 0);
+  ~JobPool();
+
+  // queues a job, returns immediately
+  void submit(Job &&job);
+
+  // runs `function(index)` for every index in [0, jobs_count) and blocks until all are done,
+  // the calling thread helps executing jobs while waiting
+  template <typename Func>
+  void run(job_count_t jobs_count, Func &&function);
+
+  // blocks until every job submitted so far has finished, helping while waiting
+  void wait();
+
+  inline uint32_t get_workers_count() const { return m_workers_count; }
+
+  // is the calling thread one of this pool's workers
+  bool is_worker_thread() const;
+
+private:
+  struct Worker
+  {
+    std::thread thread;
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void _worker_main(uint32_t index);
+
+  // tries to take a job for the worker at `index` (`npos` for a non-worker thread)
+  bool _try_acquire(size_t index, Job &job);
+  bool _try_steal(size_t thief_index, Job &job);
+
+  void _execute(Job &job);
+
+  // helps executing jobs until `done()` returns true
+  template <typename Pred>
+  void _help_until(Pred &&done);
+
+  void _notify_done();
+
+  // worker index of the calling thread, `npos` if it's not one of this pool's workers
+  size_t _current_worker_index() const;
+
+  // decrements a jobs counter when leaving the scope, even if the job has thrown
+  struct _CounterReleaser
+  {
+    inline ~_CounterReleaser() {
+      if (counter.fetch_sub(1) == 1)
+      {
+        pool._notify_done();
+      }
+    }
+
+    JobPool &pool;
+    std::atomic<job_count_t> &counter;
+  };
+
+private:
+  uint32_t m_workers_count;
+  std::unique_ptr<Worker[]> m_workers;
+
+  std::mutex m_shared_mutex;
+  std::deque<Job> m_shared_jobs;
+
+  // guards the sleeping of idle threads, `m_queued_count` is only raised while holding it
+  std::mutex m_wake_mutex;
+  std::condition_variable m_wake_cv;
+
+  std::atomic<int64_t> m_queued_count = 0;
+  std::atomic<job_count_t> m_unfinished_count = 0;
+  std::atomic_bool m_stopping = false;
+};
+
+template <typename Func>
+inline void JobPool::run(const job_count_t jobs_count, Func &&function) {
+  if (jobs_count == 0)
+  {
+    return;
+  }
+
+  std::atomic<job_count_t> jobs_left = jobs_count;
+
+  for (job_count_t index = 0; index < jobs_count; index++)
+  {
+    submit([this, index, &function, &jobs_left]() {
+      _CounterReleaser releaser{ *this, jobs_left };
+      function(size_t(index));
+    });
+  }
+
+  _help_until([&jobs_left]() { return jobs_left.load() == 0; });
+}
+
+template <typename Pred>
+inline void JobPool::_help_until(Pred &&done) {
+  // a worker waiting on nested jobs keeps it's own deque (where those jobs are) reachable
+  const size_t self_index = _current_worker_index();
+
+  while (!done())
+  {
+    Job job;
+    if (_try_acquire(self_index, job))
+    {
+      _execute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock{ m_wake_mutex };
+    m_wake_cv.wait(lock, [this, &done]() { return done() || m_queued_count.load() > 0; });
+  }
+}
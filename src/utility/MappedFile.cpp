@@ -0,0 +1,219 @@
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <Windows.h>
+#endif
+
+// the first read's size when the file's size isn't known (pipes & special files)
+static constexpr size_t UnknownSizeReadChunk = 64 * 1024;
+
+#ifdef __linux__
+// reads from `fd` until the end, `size_hint` is the expected size (zero if unknown)
+static inline bool ReadAll(int fd, size_t size_hint, string &output);
+#else
+static inline bool ReadAll(HANDLE file, size_t size_hint, string &output);
+#endif
+
+MappedFile::MappedFile(MappedFile &&move) noexcept
+    : m_open{ move.m_open },
+      m_view{ move.m_view },
+      m_size{ move.m_size },
+      m_buffer{ std::move(move.m_buffer) } {
+  move.m_open = false;
+  move.m_view = nullptr;
+  move.m_size = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&move) noexcept {
+  if (this == &move)
+  {
+    return *this;
+  }
+
+  close();
+
+  m_open = std::exchange(move.m_open, false);
+  m_view = std::exchange(move.m_view, nullptr);
+  m_size = std::exchange(move.m_size, 0);
+  m_buffer = std::move(move.m_buffer);
+  return *this;
+}
+
+bool MappedFile::open(const char *path) {
+  close();
+
+#ifdef __linux__
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat file_stats = { 0 };
+  if (fstat(fd, &file_stats))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  const bool is_regular = S_ISREG(file_stats.st_mode);
+  const size_t file_size = is_regular ? size_t(file_stats.st_size) : 0;
+
+  if (is_regular && file_size >= MinMapSize)
+  {
+    void *const view = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view != MAP_FAILED)
+    {
+      madvise(view, file_size, MADV_SEQUENTIAL);
+      ::close(fd);
+
+      m_view = static_cast<const char *>(view);
+      m_size = file_size;
+      m_open = true;
+      return true;
+    }
+  }
+
+  m_open = ReadAll(fd, file_size, m_buffer);
+  ::close(fd);
+#else
+  const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  LARGE_INTEGER file_size = {};
+  const bool is_regular = GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &file_size);
+
+  if (is_regular && size_t(file_size.QuadPart) >= MinMapSize)
+  {
+    const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *const view =
+        mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+    // the view keeps the mapping alive
+    if (mapping != nullptr)
+    {
+      CloseHandle(mapping);
+    }
+
+    if (view != nullptr)
+    {
+      CloseHandle(file);
+
+      m_view = static_cast<const char *>(view);
+      m_size = size_t(file_size.QuadPart);
+      m_open = true;
+      return true;
+    }
+  }
+
+  m_open = ReadAll(file, is_regular ? size_t(file_size.QuadPart) : 0, m_buffer);
+  CloseHandle(file);
+#endif
+
+  if (!m_open)
+  {
+    m_buffer = {};
+    return false;
+  }
+
+  m_size = m_buffer.size();
+  return true;
+}
+
+void MappedFile::close() noexcept {
+  if (m_view != nullptr)
+  {
+#ifdef __linux__
+    munmap(const_cast<char *>(m_view), m_size);
+#else
+    UnmapViewOfFile(m_view);
+#endif
+  }
+
+  m_open = false;
+  m_view = nullptr;
+  m_size = 0;
+  m_buffer = {};
+}
+
+#ifdef __linux__
+inline bool ReadAll(int fd, size_t size_hint, string &output) {
+  // one more byte than expected, so a file that grew is read to it's end too
+  output.resize(size_hint > 0 ? size_hint + 1 : UnknownSizeReadChunk);
+  size_t length = 0;
+
+  while (true)
+  {
+    if (length == output.size())
+    {
+      output.resize(output.size() * 2);
+    }
+
+    const ssize_t read_length = read(fd, output.data() + length, output.size() - length);
+    if (read_length < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+
+    if (read_length == 0)
+    {
+      break;
+    }
+    length += size_t(read_length);
+  }
+
+  output.resize(length);
+  return true;
+}
+#else
+inline bool ReadAll(HANDLE file, size_t size_hint, string &output) {
+  output.resize(size_hint > 0 ? size_hint + 1 : UnknownSizeReadChunk);
+  size_t length = 0;
+
+  while (true)
+  {
+    if (length == output.size())
+    {
+      output.resize(output.size() * 2);
+    }
+
+    DWORD read_length = 0;
+    const DWORD request = DWORD(std::min<size_t>(output.size() - length, MAXDWORD));
+    if (!ReadFile(file, output.data() + length, request, &read_length, nullptr))
+    {
+      // a pipe's writer closed it
+      if (GetLastError() == ERROR_BROKEN_PIPE)
+      {
+        break;
+      }
+      return false;
+    }
+
+    if (read_length == 0)
+    {
+      break;
+    }
+    length += read_length;
+  }
+
+  output.resize(length);
+  return true;
+}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+#include "FilePath.hpp"
+#include "base.hpp"
+
+// a file's content, read only & never copied (or truncated)
+//
+// regular files are mapped with sequential read-ahead, small files & the ones that can't be
+// mapped (pipes, special files) are read into a buffer instead, the content is valid until
+// the file is closed
+class MappedFile
+{
+public:
+  // smaller files are read, mapping them costs more than copying them
+  static constexpr size_t MinMapSize = 64 * 1024;
+
+  inline MappedFile() = default;
+  inline explicit MappedFile(const char *path) { open(path); }
+  inline explicit MappedFile(const FilePath &path) { open(path); }
+  inline ~MappedFile() noexcept { close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&move) noexcept;
+  MappedFile &operator=(MappedFile &&move) noexcept;
+
+  // returns false (and the file stays closed) if the file can't be opened or read
+  bool open(const char *path);
+  inline bool open(const FilePath &path) { return open(path.c_str()); }
+
+  void close() noexcept;
+
+  inline bool is_open() const noexcept { return m_open; }
+  inline bool is_mapped() const noexcept { return m_view != nullptr; }
+
+  inline const char *data() const noexcept { return is_mapped() ? m_view : m_buffer.data(); }
+  inline size_t size() const noexcept { return m_size; }
+
+  inline StrBlob get_content() const noexcept { return { data(), m_size }; }
+
+private:
+  bool m_open = false;
+  // the mapping, null when the content is read into `m_buffer`
+  const char *m_view = nullptr;
+  size_t m_size = 0;
+  string m_buffer = {};
+};
@@ -17,9 +17,12 @@ struct ProcessInfo
   HANDLE thread;
 };
 #elif __unix__
+#include <fcntl.h>
+#include <signal.h>
 #include <spawn.h>
-#include <sys/wait.h>
 #include <unistd.h>
+
+#include "ProcessReactor.hpp"
 typedef int Pipe;
 struct ProcessInfo
 {
@@ -28,26 +31,38 @@ struct ProcessInfo
 };
 #endif
 
-static void DumpPipeStr(Pipe pipe, std::ostream *out);
 static const char *Process_GetErrorMessage();
 
 static void KillProcess(const ProcessInfo &info);
 
-static string join_args(const Blob<const Process::char_type *const> &args);
+#ifdef _WIN32
+static void DumpPipeStr(Pipe pipe, std::ostream *out);
+static t::microsecond_t FileTimeToUs(const FILETIME &time);
+#endif
 
-Process::Process(int argc, const char_type *const *argv)
-    : Process(join_args({ argv, static_cast<size_t>(argc) })) {}
+static ArgumentList SplitArguments(const std::string &cmd);
 
-Process::Process(const char_type *cmd) : Process(std::string{ cmd }) {}
+Process::Process(ArgumentList args) : m_args{ std::move(args) } {
+  m_name = _BuildPrintableCMD(m_args);
+}
 
-Process::Process(const std::string &cmd) : m_cmd{ cmd } {
-  m_name = _BuildPrintableCMD(m_cmd.c_str());
+Process::Process(int argc, const char_type *const *argv) {
+  for (int i = 0; i < argc; i++)
+  {
+    m_args.push_back(argv[i]);
+  }
+  m_name = _BuildPrintableCMD(m_args);
 }
 
-int Process::start(std::ostream *const out) {
+Process::Process(const char_type *cmd) : Process(std::string{ cmd }) {}
+
+Process::Process(const std::string &cmd) : Process(SplitArguments(cmd)) {}
+
+int Process::start(std::ostream *const out, ProcessUsage *const usage) {
   int exit_code = -1;
 
 #ifdef _WIN32
+  const t::microsecond_t start_time = t::Now_ms();
   Pipe output_r = {};
   Pipe output_w = {};
 
@@ -71,7 +86,8 @@ int Process::start(std::ostream *const out) {
 
   PROCESS_INFORMATION win_process_info = {};
 
-  std::string cmd_copy = m_cmd;
+  // windows takes a single command line
+  std::string cmd_copy = m_args.join();
   const bool create_proc_result =
       CreateProcessA(nullptr, cmd_copy.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr,
                      &startup_info, &win_process_info);
@@ -80,14 +96,14 @@ int Process::start(std::ostream *const out) {
   {
     Logger::error("creating process named '%s' error: %s", m_name.c_str(),
                   Process_GetErrorMessage());
-    Logger::verbose("PROC-CMD:: %s", m_cmd.c_str());
+    Logger::verbose("PROC-CMD:: %s", cmd_copy.c_str());
 
     return -1;
   }
 
   ProcessInfo process_info = { win_process_info.hProcess, win_process_info.hThread };
 
-  const DWORD wait_ms_timeout = this->m_wait_time_ms;
+  const DWORD wait_ms_timeout = this->m_wait_time_ms == 0 ? INFINITE : this->m_wait_time_ms;
   const DWORD object_waiting_res = WaitForSingleObject(process_info.thread, wait_ms_timeout);
 
   if (object_waiting_res == WAIT_FAILED)
@@ -116,6 +132,22 @@ int Process::start(std::ostream *const out) {
     break;
   }
 
+  if (usage)
+  {
+    FILETIME creation_time = {};
+    FILETIME exit_time = {};
+    FILETIME kernel_time = {};
+    FILETIME user_time = {};
+
+    if (GetProcessTimes(process_info.process, &creation_time, &exit_time, &kernel_time,
+                        &user_time))
+    {
+      usage->user_time = FileTimeToUs(user_time);
+      usage->system_time = FileTimeToUs(kernel_time);
+    }
+    usage->wall_time = t::Now_ms() - start_time;
+  }
+
   // make sure the process is killed?
   KillProcess(process_info);
   CloseHandle(output_w);
@@ -127,11 +159,29 @@ int Process::start(std::ostream *const out) {
 
   CloseHandle(output_r);
 #else
-  Pipe child_pipes[2] = {};
+  // the output is drained while the process runs, a process writing more than the pipe's
+  // capacity would block forever if it was only read after the process exits
+  ProcessReactor reactor{ 1 };
+  reactor.submit(*this, out, usage, [&exit_code](int code) { exit_code = code; });
+  reactor.run();
+#endif
 
-  if (out)
+  return exit_code;
+}
+
+#ifndef _WIN32
+errno_t Process::spawn(pid_t &pid, int *const output_fd) const {
+  if (m_args.empty())
+  {
+    Logger::error("No argument to start process '%s'", m_name.c_str());
+    return EFAULT;
+  }
+
+  Pipe child_pipes[2] = { -1, -1 };
+
+  if (output_fd)
   {
-    if (pipe(child_pipes) == -1)
+    if (pipe2(child_pipes, O_CLOEXEC) == -1)
     {
       errno_t err = errno;
       Logger::error("Failed to create pipe for process '%s', ERRNO=%s", m_name.c_str(),
@@ -141,45 +191,46 @@ int Process::start(std::ostream *const out) {
     }
   }
 
-  std::vector<std::string> args = Argument::BreakArgumentList(m_cmd);
+  std::vector<char *> arg_ptrs = m_args.argv();
 
-  if (args.empty())
-  {
-    Logger::error("No argument to start process, command=%s", m_cmd.c_str());
-    return EFAULT;
-  }
+  posix_spawn_file_actions_t sfc = {};
+  posix_spawn_file_actions_init(&sfc);
 
-  std::vector<char *> arg_ptrs = {};
-  for (size_t i = 0; i < args.size(); i++)
+  if (output_fd)
   {
-    arg_ptrs.emplace_back(args[i].data());
+    posix_spawn_file_actions_adddup2(&sfc, child_pipes[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&sfc, child_pipes[1], STDERR_FILENO);
   }
-  arg_ptrs.push_back(nullptr);
-
-  posix_spawn_file_actions_t sfc = { 0 };
-  posix_spawn_file_actions_init(&sfc);
 
-  posix_spawn_file_actions_addclose(&sfc, child_pipes[0]);
-  posix_spawn_file_actions_adddup2(&sfc, child_pipes[1], STDOUT_FILENO);
-  posix_spawn_file_actions_adddup2(&sfc, child_pipes[1], STDERR_FILENO);
-  posix_spawn_file_actions_addclose(&sfc, child_pipes[1]);
+  // executables given by path are spawned as they are, only bare names are searched for
+  const std::string_view executable = m_args.front();
+  std::string exc_abs_path{};
 
-  pid_t child_pid = 0;
-  std::string exc_abs_path = FilePath::FindExecutableInPATHEnv(args[0]).c_str();
-
-  if (exc_abs_path.empty())
+  if (executable.find('/') != std::string_view::npos)
   {
-    exc_abs_path = args[0];
-    Logger::verbose("No absolute path for '%s'", args[0].c_str());
+    exc_abs_path = executable;
   }
-  else if (has_flags(Flag_CWDOverride))
+  else
+  {
+    exc_abs_path = FilePath::FindExecutableInPATHEnv(m_args.c_str(0)).c_str();
+
+    if (exc_abs_path.empty())
+    {
+      exc_abs_path = executable;
+      Logger::verbose("No absolute path for '%s'", m_args.c_str(0));
+    }
+    else
+    {
+      arg_ptrs[0] = exc_abs_path.data();
+    }
+  }
+
+  if (has_flags(Flag_CWDOverride) && exc_abs_path.find('/') != std::string::npos)
   {
     std::string parent_dir = FilePath(exc_abs_path).parent().c_str();
     posix_spawn_file_actions_addchdir_np(&sfc, parent_dir.c_str());
   }
 
-  arg_ptrs[0] = exc_abs_path.data();
-
   Logger::verbose("spawning '%s'", exc_abs_path.c_str());
 
   char **env_variables = nullptr;
@@ -190,52 +241,63 @@ int Process::start(std::ostream *const out) {
   }
 
   const errno_t spawn_err =
-      posix_spawnp(&child_pid, exc_abs_path.c_str(), &sfc, nullptr, arg_ptrs.data(), env_variables);
+      posix_spawnp(&pid, exc_abs_path.c_str(), &sfc, nullptr, arg_ptrs.data(), env_variables);
+
+  posix_spawn_file_actions_destroy(&sfc);
+
+  if (output_fd)
+  {
+    close(child_pipes[1]);
+  }
 
   if (spawn_err != 0)
   {
     Logger::error("Failed to spawn process named '%s', error: %s", m_name.c_str(),
                   strerrorname_np(spawn_err));
 
-    return -1;
+    if (output_fd)
+    {
+      close(child_pipes[0]);
+    }
+    return spawn_err;
   }
 
-  close(child_pipes[1]);
-  waitpid(child_pid, &exit_code, 0);
-
-  if (child_pipes[0] && out)
+  if (output_fd)
   {
-    DumpPipeStr(child_pipes[0], out);
+    *output_fd = child_pipes[0];
   }
 
-  close(child_pipes[0]);
-#endif
-
-  return exit_code;
+  return EOK;
 }
+#endif
 
-Process::ProcessName Process::_BuildPrintableCMD(const char *string) {
+Process::ProcessName Process::_BuildPrintableCMD(const ArgumentList &args) {
   ProcessName output = {};
   constexpr size_t max_copy_length = PrintableCMDLength - 3;
 
-  for (size_t i = 0; i < max_copy_length; i++)
+  for (size_t i = 0; i < args.size(); i++)
   {
-    if (string[i] == 0)
+    if (i > 0)
     {
-      return output;
+      output.append(' ');
     }
 
-    output.append(string[i]);
-
-    if (i == max_copy_length - 1)
+    for (char chr : args[i])
     {
-      output.append('.', 3);
+      if (output.length() >= max_copy_length)
+      {
+        output.append('.', 3);
+        return output;
+      }
+
+      output.append(chr);
     }
   }
 
   return output;
 }
 
+#ifdef _WIN32
 void DumpPipeStr(Pipe pipe, std::ostream *out) {
   if (out == nullptr)
   {
@@ -247,13 +309,8 @@ void DumpPipeStr(Pipe pipe, std::ostream *out) {
   constexpr size_t buffer_size = 0x1000;
   char buffer[buffer_size + 1] = {};
 
-#ifdef _WIN32
   DWORD read_sz = 0;
   while (::ReadFile(pipe, buffer, buffer_size, &read_sz, nullptr))
-#else
-  ssize_t read_sz = 0;
-  while ((read_sz = read(pipe, buffer, buffer_size)))
-#endif
   {
     if (read_sz <= 0)
     {
@@ -266,6 +323,7 @@ void DumpPipeStr(Pipe pipe, std::ostream *out) {
     (*out) << buffer;
   }
 }
+#endif
 
 const char *Process_GetErrorMessage() {
 #ifdef _WIN32
@@ -284,25 +342,19 @@ void KillProcess(const ProcessInfo &info) {
 #endif
 }
 
-string join_args(const Blob<const Process::char_type *const> &args) {
-  std::ostringstream oss;
+#ifdef _WIN32
+t::microsecond_t FileTimeToUs(const FILETIME &time) {
+  // FILETIME counts in 100ns intervals
+  const uint64_t ticks = (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+  return t::microsecond_t(ticks / 10);
+}
+#endif
 
-  for (const Process::char_type *arg : args)
+ArgumentList SplitArguments(const std::string &cmd) {
+  ArgumentList args{};
+  for (const std::string &arg : Argument::BreakArgumentList(cmd))
   {
-    bool need_enclosure =
-        string_tools::all_of(arg, [](Process::char_type value) { return !isgraph(value); });
-
-    if (need_enclosure)
-    {
-      oss << '"' << arg << '"';
-    }
-    else
-    {
-      oss << arg;
-    }
-
-    oss << ' ';
+    args.push_back(arg);
   }
-
-  return oss.str();
+  return args;
 }
@@ -4,7 +4,22 @@
 #include <array>
 #include <string>
 
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+#include "misc/Error.hpp"
 #include "misc/StaticString.hpp"
+#include "misc/Time.hpp"
+#include "utility/ArgumentList.hpp"
+
+// resources consumed by a finished process, in microseconds
+struct ProcessUsage
+{
+  t::microsecond_t wall_time = 0;
+  t::microsecond_t user_time = 0;
+  t::microsecond_t system_time = 0;
+};
 
 class Process
 {
@@ -19,30 +34,46 @@ public:
   static constexpr ProcessFlags Flag_CWDOverride = 0x0001;
   static constexpr ProcessFlags Flag_InheritEnv = 0x0002;
 
+  // the arguments are passed as they are to the process, no quoting/splitting is involved
+  explicit Process(ArgumentList args);
   Process(int argc, const char_type *const *argv);
+
+  // `cmd` is split into arguments once (respecting quotes)
   Process(const char_type *cmd);
   Process(const std::string &cmd);
 
-  int start(std::ostream *out = nullptr);
+  // `usage` (if not null) receives the wall/cpu times of the process once it exits
+  int start(std::ostream *out = nullptr, ProcessUsage *usage = nullptr);
+
+#ifndef _WIN32
+  // starts the process without waiting for it, if `output_fd` isn't null, it receives the
+  // read end of a pipe connected to the process's stdout & stderr
+  errno_t spawn(pid_t &pid, int *output_fd) const;
+#endif
 
   inline const ProcessName &get_name() const { return m_name; }
+  inline const ArgumentList &get_args() const { return m_args; }
 
   inline ProcessFlags get_flags() const { return m_flags; }
   inline ProcessFlags has_flags(ProcessFlags mask) const { return m_flags & mask; }
 
   inline void set_name(const ProcessName &name) { m_name = name; }
 
+  // zero waits forever
+  inline unsigned long get_wait_time_ms() const { return m_wait_time_ms; }
+  inline void set_wait_time_ms(unsigned long wait_time_ms) { m_wait_time_ms = wait_time_ms; }
+
   inline void set_flags(ProcessFlags flags) { m_flags = flags; }
 
   inline void add_flags(ProcessFlags flags) { m_flags |= flags; }
   inline void remove_flags(ProcessFlags flags) { m_flags &= ~flags; }
 
 private:
-  static ProcessName _BuildPrintableCMD(const char *string);
+  static ProcessName _BuildPrintableCMD(const ArgumentList &args);
 
 private:
-  std::string m_cmd;
+  ArgumentList m_args;
   ProcessName m_name = {};
   ProcessFlags m_flags = Flag_None;
-  unsigned long m_wait_time_ms = 1000 * 60;  // 1 minutes
+  unsigned long m_wait_time_ms = 0;
 };
@@ -0,0 +1,407 @@
+#include "ProcessReactor.hpp"
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "Logger.hpp"
+
+// how often children without a pidfd are checked for their exit
+static constexpr int ExitPollIntervalMs = 10;
+static constexpr int MaxEventsCount = 64;
+
+static int OpenPidFd(pid_t pid);
+
+static inline uint64_t EventData(size_t slot, bool is_pidfd) {
+  return (uint64_t(slot) << 1) | uint64_t(is_pidfd);
+}
+
+static inline t::microsecond_t TimevalToUs(const timeval &time) {
+  return t::microsecond_t(time.tv_sec) * 1'000'000 + time.tv_usec;
+}
+
+ProcessReactor::ProcessReactor(uint32_t max_running, size_t pipe_buffer_size)
+    : m_max_running{ max_running }, m_pipe_buffer_size{ pipe_buffer_size } {
+  if (m_max_running == 0)
+  {
+    m_max_running = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  m_slots.reset(new std::unique_ptr<Child>[m_max_running]);
+
+  m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (m_epoll_fd == -1)
+  {
+    Logger::error("ProcessReactor: failed to create an epoll instance, ERRNO=%s",
+                  strerrorname_np(errno));
+  }
+}
+
+ProcessReactor::~ProcessReactor() {
+  // only reachable with running children if `run()` was interrupted (thrown through)
+  for (size_t i = 0; i < m_max_running; i++)
+  {
+    Child *child = m_slots[i].get();
+    if (child == nullptr)
+    {
+      continue;
+    }
+
+    kill(child->pid, SIGKILL);
+    waitpid(child->pid, nullptr, 0);
+
+    _close_output(*child);
+    if (child->pidfd != -1)
+    {
+      close(child->pidfd);
+    }
+  }
+
+  if (m_epoll_fd != -1)
+  {
+    close(m_epoll_fd);
+  }
+}
+
+void ProcessReactor::submit(Process process,
+                            std::ostream *out,
+                            ProcessUsage *usage,
+                            ExitCallback &&on_exit,
+                            SpawnCallback &&on_spawn) {
+  m_pending.push_back(
+      Child{ std::move(process), out, usage, std::move(on_exit), std::move(on_spawn) });
+}
+
+void ProcessReactor::run() {
+  if (m_epoll_fd == -1)
+  {
+    while (!m_pending.empty())
+    {
+      Child child = std::move(m_pending.front());
+      m_pending.pop_front();
+      child.on_exit(EBADF);
+    }
+    return;
+  }
+
+  _fill_slots();
+
+  epoll_event events[MaxEventsCount] = {};
+
+  while (m_running_count > 0)
+  {
+    int timeout = _get_wait_timeout();
+    if (m_polled_count > 0 && (timeout < 0 || timeout > ExitPollIntervalMs))
+    {
+      timeout = ExitPollIntervalMs;
+    }
+
+    const int events_count = epoll_wait(m_epoll_fd, events, MaxEventsCount, timeout);
+
+    if (events_count == -1 && errno != EINTR)
+    {
+      Logger::error("ProcessReactor: waiting for events failed, ERRNO=%s",
+                    strerrorname_np(errno));
+      break;
+    }
+
+    for (int i = 0; i < events_count; i++)
+    {
+      const size_t slot = size_t(events[i].data.u64 >> 1);
+      const bool is_pidfd = events[i].data.u64 & 1;
+
+      // finished by an earlier event of this batch
+      if (!m_slots[slot])
+      {
+        continue;
+      }
+
+      if (is_pidfd)
+      {
+        _try_reap(slot);
+      }
+      else
+      {
+        _drain_output(*m_slots[slot]);
+      }
+    }
+
+    for (size_t slot = 0; m_polled_count > 0 && slot < m_max_running; slot++)
+    {
+      if (m_slots[slot] && m_slots[slot]->pidfd == -1)
+      {
+        _try_reap(slot);
+      }
+    }
+
+    _kill_timed_out();
+    _fill_slots();
+  }
+
+  // the event loop broke, don't leave the children behind
+  for (size_t slot = 0; slot < m_max_running; slot++)
+  {
+    if (m_slots[slot])
+    {
+      kill(m_slots[slot]->pid, SIGKILL);
+      waitpid(m_slots[slot]->pid, nullptr, 0);
+      _finish(slot, ECHILD);
+    }
+  }
+
+  while (!m_pending.empty())
+  {
+    Child child = std::move(m_pending.front());
+    m_pending.pop_front();
+    child.on_exit(ECHILD);
+  }
+}
+
+void ProcessReactor::_fill_slots() {
+  for (size_t slot = 0; slot < m_max_running && !m_pending.empty(); slot++)
+  {
+    if (m_slots[slot])
+    {
+      continue;
+    }
+
+    // a failed spawn leaves the slot free for the next pending child
+    while (!m_pending.empty() && !_spawn(slot))
+    {
+    }
+  }
+}
+
+bool ProcessReactor::_spawn(const size_t slot) {
+  auto child = std::make_unique<Child>(std::move(m_pending.front()));
+  m_pending.pop_front();
+
+  int output_fd = -1;
+  if (child->on_spawn)
+  {
+    child->on_spawn();
+  }
+  child->start_time = t::Now_ms();
+
+  const errno_t spawn_err = child->process.spawn(child->pid, child->out ? &output_fd : nullptr);
+  if (spawn_err != EOK)
+  {
+    child->on_exit(spawn_err);
+    return false;
+  }
+
+  if (child->process.get_wait_time_ms() > 0)
+  {
+    child->deadline =
+        child->start_time + t::microsecond_t(child->process.get_wait_time_ms()) * 1000;
+  }
+
+  if (output_fd != -1)
+  {
+    child->output_fd = output_fd;
+    fcntl(output_fd, F_SETFL, fcntl(output_fd, F_GETFL) | O_NONBLOCK);
+
+    // a bigger pipe means less wake ups for chatty children
+    if (m_pipe_buffer_size > 0 && fcntl(output_fd, F_SETPIPE_SZ, int(m_pipe_buffer_size)) == -1)
+    {
+      Logger::verbose("ProcessReactor: could not resize the pipe of '%s' to %llu bytes: %s",
+                      child->process.get_name().c_str(),
+                      m_pipe_buffer_size,
+                      strerrorname_np(errno));
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = EventData(slot, false);
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, output_fd, &event);
+  }
+
+  child->pidfd = OpenPidFd(child->pid);
+  if (child->pidfd != -1)
+  {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = EventData(slot, true);
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, child->pidfd, &event);
+  }
+  else
+  {
+    m_polled_count++;
+  }
+
+  m_slots[slot] = std::move(child);
+  m_running_count++;
+  return true;
+}
+
+void ProcessReactor::_drain_output(Child &child) {
+  if (child.output_fd == -1)
+  {
+    return;
+  }
+
+  char buffer[0x4000];
+
+  while (true)
+  {
+    const ssize_t read_sz = read(child.output_fd, buffer, sizeof(buffer));
+
+    if (read_sz > 0)
+    {
+      child.output.append(buffer, size_t(read_sz));
+      continue;
+    }
+
+    if (read_sz == -1 && errno == EINTR)
+    {
+      continue;
+    }
+
+    // EAGAIN: nothing more for now
+    if (read_sz == -1 && errno == EAGAIN)
+    {
+      return;
+    }
+
+    // end of file (every writer closed it's end) or an error
+    _close_output(child);
+    return;
+  }
+}
+
+void ProcessReactor::_close_output(Child &child) {
+  if (child.output_fd == -1)
+  {
+    return;
+  }
+
+  epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, child.output_fd, nullptr);
+  close(child.output_fd);
+  child.output_fd = -1;
+}
+
+bool ProcessReactor::_try_reap(const size_t slot) {
+  Child &child = *m_slots[slot];
+
+  int status = 0;
+  rusage child_usage = {};
+
+  const pid_t result = wait4(child.pid, &status, WNOHANG, &child_usage);
+  if (result == 0 || (result == -1 && errno == EINTR))
+  {
+    return false;
+  }
+
+  if (result == -1)
+  {
+    Logger::error("ProcessReactor: waiting for '%s' failed, ERRNO=%s",
+                  child.process.get_name().c_str(),
+                  strerrorname_np(errno));
+    _finish(slot, ECHILD);
+    return true;
+  }
+
+  if (child.usage)
+  {
+    child.usage->wall_time = t::Now_ms() - child.start_time;
+    child.usage->user_time = TimevalToUs(child_usage.ru_utime);
+    child.usage->system_time = TimevalToUs(child_usage.ru_stime);
+  }
+
+  // whatever the child wrote before exiting is still in the pipe
+  _drain_output(child);
+
+  _finish(slot, child.timed_out ? ETIMEDOUT : status);
+  return true;
+}
+
+void ProcessReactor::_finish(const size_t slot, const int exit_code) {
+  std::unique_ptr<Child> child = std::move(m_slots[slot]);
+
+  _close_output(*child);
+
+  if (child->pidfd != -1)
+  {
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, child->pidfd, nullptr);
+    close(child->pidfd);
+  }
+  else
+  {
+    m_polled_count--;
+  }
+
+  m_running_count--;
+
+  if (child->out && !child->output.empty())
+  {
+    (*child->out) << child->output;
+  }
+
+  child->on_exit(exit_code);
+}
+
+void ProcessReactor::_kill_timed_out() {
+  const t::microsecond_t now = t::Now_ms();
+
+  for (size_t slot = 0; slot < m_max_running; slot++)
+  {
+    Child *child = m_slots[slot].get();
+    if (child == nullptr || child->deadline == 0 || child->timed_out || now < child->deadline)
+    {
+      continue;
+    }
+
+    Logger::warning("process '%s' has timed out after %lums, killing it",
+                    child->process.get_name().c_str(),
+                    child->process.get_wait_time_ms());
+
+    kill(child->pid, SIGKILL);
+    child->timed_out = true;
+  }
+}
+
+int ProcessReactor::_get_wait_timeout() const {
+  const t::microsecond_t now = t::Now_ms();
+  t::microsecond_t nearest = -1;
+
+  for (size_t slot = 0; slot < m_max_running; slot++)
+  {
+    const Child *child = m_slots[slot].get();
+    if (child == nullptr || child->deadline == 0 || child->timed_out)
+    {
+      continue;
+    }
+
+    const t::microsecond_t left = std::max<t::microsecond_t>(child->deadline - now, 0);
+    if (nearest == -1 || left < nearest)
+    {
+      nearest = left;
+    }
+  }
+
+  if (nearest == -1)
+  {
+    return -1;
+  }
+
+  // rounding up, waking up a bit late is fine, waking up early spins
+  return int(std::min<t::microsecond_t>((nearest + 999) / 1000, INT32_MAX));
+}
+
+int OpenPidFd(const pid_t pid) {
+#ifdef SYS_pidfd_open
+  return int(syscall(SYS_pidfd_open, pid, 0));
+#else
+  (void)pid;
+  return -1;
+#endif
+}
+#endif
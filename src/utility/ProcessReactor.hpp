@@ -0,0 +1,97 @@
+#pragma once
+#ifdef __linux__
+#include <deque>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "Process.hpp"
+#include "misc/Time.hpp"
+
+// supervises child processes from a single event loop (epoll over pidfds & output pipes)
+//
+// the output of every running child is drained as it's written, so a child can never
+// block on a full pipe, and no thread has to sit in `waitpid()` for each child
+class ProcessReactor
+{
+public:
+  // receives the exit status (as returned by `wait4()`), or an errno for processes that
+  // failed to spawn or timed out
+  typedef std::function<void(int exit_code)> ExitCallback;
+  // called right before the process is spawned
+  typedef std::function<void()> SpawnCallback;
+
+  static constexpr size_t DefaultPipeBufferSize = 0x100000;
+
+  // at most `max_running` children run at the same time (zero for one per hardware thread)
+  explicit ProcessReactor(uint32_t max_running = 0,
+                          size_t pipe_buffer_size = DefaultPipeBufferSize);
+  ~ProcessReactor();
+
+  ProcessReactor(const ProcessReactor &) = delete;
+  ProcessReactor &operator=(const ProcessReactor &) = delete;
+
+  // queues `process`, it's spawned by `run()` once a running slot is free
+  //
+  // `out` (if not null) receives the process's output once it exits,
+  // `on_exit` & `on_spawn` (if any) are called from the thread calling `run()`
+  void submit(Process process,
+              std::ostream *out,
+              ProcessUsage *usage,
+              ExitCallback &&on_exit,
+              SpawnCallback &&on_spawn = {});
+
+  // runs the event loop until every submitted process has exited
+  void run();
+
+  inline uint32_t get_max_running() const { return m_max_running; }
+
+private:
+  struct Child
+  {
+    Process process;
+    std::ostream *out = nullptr;
+    ProcessUsage *usage = nullptr;
+    ExitCallback on_exit;
+    SpawnCallback on_spawn;
+
+    pid_t pid = -1;
+    int pidfd = -1;
+    int output_fd = -1;
+
+    t::microsecond_t start_time = 0;
+    // zero for no deadline
+    t::microsecond_t deadline = 0;
+    bool timed_out = false;
+
+    std::string output;
+  };
+
+  // spawns pending children while there are free slots
+  void _fill_slots();
+  bool _spawn(size_t slot);
+
+  void _drain_output(Child &child);
+  void _close_output(Child &child);
+
+  // reaps the child if it has exited, returns true if it did
+  bool _try_reap(size_t slot);
+  void _finish(size_t slot, int exit_code);
+
+  void _kill_timed_out();
+  // epoll timeout until the nearest deadline, -1 for none
+  int _get_wait_timeout() const;
+
+private:
+  uint32_t m_max_running;
+  size_t m_pipe_buffer_size;
+  int m_epoll_fd = -1;
+
+  std::deque<Child> m_pending;
+  std::unique_ptr<std::unique_ptr<Child>[]> m_slots;
+  uint32_t m_running_count = 0;
+  // children without a pidfd (old kernels) are polled for their exit
+  uint32_t m_polled_count = 0;
+};
+#endif
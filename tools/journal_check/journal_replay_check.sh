@@ -0,0 +1,89 @@
+#!/usr/bin/env bash
+# interrupts a rebuild of a generated project after a few objects compiled, then checks that the
+# next build replays the build journal (user-022) instead of compiling everything again
+#
+# usage: journal_replay_check.sh <bgnu binary> [work directory]
+set -u
+
+if [ $# -lt 1 ]; then
+  echo "usage: $0 <bgnu binary> [work directory]" >&2
+  exit 2
+fi
+
+BGNU="$(realpath "$1")"
+WORK="${2:-$(mktemp -d)}"
+SOURCES_COUNT=8
+INTERRUPT_AFTER=3
+
+fail() {
+  echo "FAIL: $*"
+  [ -f "$WORK/build.log" ] && tail -n 20 "$WORK/build.log" | sed 's/^/  | /'
+  exit 1
+}
+
+# the objects written since the rebuild started
+count_objects() {
+  find "$WORK/out/cache" -name '*.o' -newer "$WORK/rebuild.mark" 2>/dev/null | wc -l
+}
+
+mkdir -p "$WORK/src"
+cd "$WORK" || fail "can't enter '$WORK'"
+rm -rf out .bgnu settings.bgnu
+
+# sequential & without the object store, every object of the rebuild comes from the compiler
+cat > settings.bgnu <<'EOF'
+build_multithreaded = false
+object_store = false
+color_output = false
+EOF
+
+"$BGNU" new > build.log 2>&1 || fail "can't create the project"
+
+# slow enough to compile for the interrupt to land in the middle of the build
+for i in $(seq 0 $((SOURCES_COUNT - 1))); do
+  cat > "src/s$i.cpp" <<EOF
+#include <map>
+#include <regex>
+#include <string>
+int s$i(const std::string &text) {
+  const std::regex word{ "[a-z]+" };
+  std::map<std::string, int> counts{};
+  for (std::sregex_iterator it{ text.begin(), text.end(), word }, end{}; it != end; ++it)
+    counts[it->str()] += $i;
+  return (int)counts.size();
+}
+EOF
+done
+cat > src/main.cpp <<'EOF'
+int main() { return 0; }
+EOF
+
+# a first, complete build writes the configuration's cache
+"$BGNU" build > build.log 2>&1 || fail "the first build failed"
+[ -f out/cache/debug/.journal ] && fail "a complete build left it's journal behind"
+
+# the rebuild removes the configuration's cache, the journal has to be recreated in it
+touch rebuild.mark
+setsid "$BGNU" build -r > build.log 2>&1 &
+BUILD_PID=$!
+while [ "$(count_objects)" -lt "$INTERRUPT_AFTER" ]; do
+  kill -0 "$BUILD_PID" 2>/dev/null || fail "the rebuild ended before it could be interrupted"
+  sleep 0.1
+done
+kill -KILL -- "-$BUILD_PID"
+wait "$BUILD_PID" 2>/dev/null
+
+grep -q "can't open the build journal" build.log && fail "the rebuild couldn't open it's journal"
+[ -s out/cache/debug/.journal ] || fail "the interrupted rebuild left no journal"
+INTERRUPTED_OBJECTS=$(count_objects)
+
+"$BGNU" build > build.log 2>&1 || fail "the build after the interrupt failed"
+RECOVERED=$(sed -n 's/.*recovered \([0-9]*\) object\[s\] of an interrupted build.*/\1/p' build.log)
+[ -n "$RECOVERED" ] || fail "the journal wasn't replayed"
+# the last object may be written by it's compiler without being journaled yet
+[ "$RECOVERED" -ge $((INTERRUPT_AFTER - 1)) ] ||
+  fail "recovered $RECOVERED object[s], $INTERRUPTED_OBJECTS were compiled before the interrupt"
+[ -f out/cache/debug/.journal ] && fail "the completed build left it's journal behind"
+
+echo "recovered $RECOVERED of $INTERRUPTED_OBJECTS object[s] compiled before the interrupt"
+exit 0
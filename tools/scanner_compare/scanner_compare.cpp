@@ -0,0 +1,191 @@
+// compares the includes `DirectiveScanner` finds with the ones of the old, token based scanner
+// (`CPreprocessor::gather_all_tks`) over a corpus of files or directories
+//
+// the differences a file expects are marked in it's comments:
+//   //! new: <spec>   an include only the new scanner finds
+//   //! old: <spec>   an include only the old scanner finds (empty for a macro include)
+// any other difference fails the comparison, a file without marks expects none
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string_view>
+
+#include "code/CPreprocessor.hpp"
+#include "code/DirectiveScanner.hpp"
+
+namespace fs = std::filesystem;
+
+static constexpr std::string_view NewMark = "//! new:";
+static constexpr std::string_view OldMark = "//! old:";
+
+struct Comparison
+{
+  size_t files_count = 0;
+  size_t includes_count = 0;
+  size_t failed_count = 0;
+};
+
+static vector<string> ScanOld(const string &content);
+static vector<string> ScanNew(const string &content);
+static void ReadMarks(const string &content, vector<string> &only_new, vector<string> &only_old);
+static string ReadMark(const string &line, std::string_view mark);
+// the specs of `left` that aren't in `right` (as multisets), sorted
+static vector<string> Subtract(vector<string> left, vector<string> right);
+static bool CompareFile(const fs::path &path, Comparison &comparison);
+static void PrintSpecs(const char *title, const vector<string> &specs);
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s <file or directory>...\n", argv[0]);
+    return 2;
+  }
+
+  Comparison comparison{};
+  for (int i = 1; i < argc; i++)
+  {
+    const fs::path root{ argv[i] };
+    if (!fs::is_directory(root))
+    {
+      CompareFile(root, comparison);
+      continue;
+    }
+
+    // sorted, the report is the same on every run
+    vector<fs::path> paths{};
+    for (const auto &entry : fs::recursive_directory_iterator(root))
+    {
+      if (entry.is_regular_file())
+      {
+        paths.push_back(entry.path());
+      }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const fs::path &path : paths)
+    {
+      CompareFile(path, comparison);
+    }
+  }
+
+  printf("%zu file[s], %zu include[s], %zu file[s] with unexpected differences\n",
+         comparison.files_count,
+         comparison.includes_count,
+         comparison.failed_count);
+  return comparison.failed_count == 0 && comparison.files_count != 0 ? 0 : 1;
+}
+
+inline vector<string> ScanOld(const string &content) {
+  vector<CPreprocessor::Token> tokens{};
+  CPreprocessor::gather_all_tks({ content.data(), content.size() }, tokens);
+
+  vector<string> specs{};
+  for (const auto &token : tokens)
+  {
+    if (token.type == CPreprocessor::Type::Include)
+    {
+      specs.push_back(CPreprocessor::get_include_path(std::string_view{ token.value }));
+    }
+  }
+
+  return specs;
+}
+
+inline vector<string> ScanNew(const string &content) {
+  vector<std::string_view> includes{};
+  DirectiveScanner::scan_includes({ content.data(), content.size() }, includes);
+  return { includes.begin(), includes.end() };
+}
+
+inline void ReadMarks(const string &content, vector<string> &only_new, vector<string> &only_old) {
+  std::istringstream stream{ content };
+  string line{};
+  while (std::getline(stream, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.pop_back();
+    }
+
+    if (line.starts_with(NewMark))
+    {
+      only_new.push_back(ReadMark(line, NewMark));
+    }
+    else if (line.starts_with(OldMark))
+    {
+      only_old.push_back(ReadMark(line, OldMark));
+    }
+  }
+}
+
+inline string ReadMark(const string &line, std::string_view mark) {
+  const size_t start = line.find_first_not_of(" \t", mark.size());
+  const size_t last = line.find_last_not_of(" \t");
+  if (start == line.npos || last < start)
+  {
+    return {};
+  }
+
+  return line.substr(start, last - start + 1);
+}
+
+inline vector<string> Subtract(vector<string> left, vector<string> right) {
+  std::sort(left.begin(), left.end());
+  std::sort(right.begin(), right.end());
+
+  vector<string> result{};
+  std::set_difference(
+      left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(result));
+  return result;
+}
+
+inline bool CompareFile(const fs::path &path, Comparison &comparison) {
+  std::ifstream in{ path, std::ios::binary };
+  if (!in)
+  {
+    fprintf(stderr, "can't read '%s'\n", path.string().c_str());
+    comparison.failed_count++;
+    return false;
+  }
+
+  const string content{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+
+  const vector<string> old_specs = ScanOld(content);
+  const vector<string> new_specs = ScanNew(content);
+
+  vector<string> expected_only_new{};
+  vector<string> expected_only_old{};
+  ReadMarks(content, expected_only_new, expected_only_old);
+  std::sort(expected_only_new.begin(), expected_only_new.end());
+  std::sort(expected_only_old.begin(), expected_only_old.end());
+
+  const vector<string> only_new = Subtract(new_specs, old_specs);
+  const vector<string> only_old = Subtract(old_specs, new_specs);
+
+  comparison.files_count++;
+  comparison.includes_count += new_specs.size();
+
+  if (only_new == expected_only_new && only_old == expected_only_old)
+  {
+    return true;
+  }
+
+  comparison.failed_count++;
+  printf("%s:\n", path.string().c_str());
+  PrintSpecs("found only by the new scanner", only_new);
+  PrintSpecs("expected only from the new scanner", expected_only_new);
+  PrintSpecs("found only by the old scanner", only_old);
+  PrintSpecs("expected only from the old scanner", expected_only_old);
+  return false;
+}
+
+inline void PrintSpecs(const char *title, const vector<string> &specs) {
+  printf("  %s (%zu):\n", title, specs.size());
+  for (const string &spec : specs)
+  {
+    printf("    '%s'\n", spec.c_str());
+  }
+}